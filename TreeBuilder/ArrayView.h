@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+
+namespace tree_builder
+{
+    /**
+     * A non-owning view over a contiguous array.
+     * It is cheap to copy and never allocates; it stays valid only as long
+     * as the array it refers to is neither reallocated nor destroyed.
+     *
+     * @tparam E The element type, possibly const-qualified.
+     */
+    template<typename E>
+    class array_view
+    {
+    public:
+        using value_type = E;
+        using iterator = E*;
+        using reverse_iterator = std::reverse_iterator<E*>;
+
+        // Constructors
+        constexpr array_view() noexcept = default;
+        constexpr array_view(E* data, std::size_t size) noexcept :
+            data_(data), size_(size) {}
+
+    public:
+        constexpr iterator begin() const noexcept { return data_; }
+        constexpr iterator end() const noexcept { return data_ + size_; }
+
+        reverse_iterator rbegin() const noexcept
+        {
+            return reverse_iterator(end());
+        }
+
+        reverse_iterator rend() const noexcept
+        {
+            return reverse_iterator(begin());
+        }
+
+        /**
+         * Gets the number of elements in the view.
+         *
+         * @return The element count.
+         */
+        constexpr std::size_t size() const noexcept { return size_; }
+
+        /**
+         * Checks whether the view has no elements.
+         *
+         * @return True if the view is empty.
+         */
+        constexpr bool empty() const noexcept { return size_ == 0; }
+
+        /**
+         * Gets a pointer to the first element.
+         *
+         * @return The underlying array.
+         */
+        constexpr E* data() const noexcept { return data_; }
+
+        /**
+         * Accesses an element without bounds checking.
+         *
+         * @param index The position of the element.
+         * @return Reference to the element.
+         */
+        constexpr E& operator[](std::size_t index) const noexcept
+        {
+            return data_[index];
+        }
+
+        constexpr E& front() const noexcept { return data_[0]; }
+        constexpr E& back() const noexcept { return data_[size_ - 1]; }
+
+    private:
+        /** First element of the viewed array. */
+        E* data_ = nullptr;
+
+        /** Number of elements in the viewed array. */
+        std::size_t size_ = 0;
+    };
+};
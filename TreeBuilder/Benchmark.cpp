@@ -0,0 +1,416 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ConcurrentTree.h"
+#include "Tree.h"
+
+using namespace tree_builder;
+
+namespace
+{
+    /**
+     * Shapes of the trees the benchmark is run on.
+     *
+     * - chain: Every node is the only child of the previous one.
+     * - star: Every node is a child of the root.
+     * - k_ary: A complete tree in which every node has k_arity children.
+     * - random: Every node hangs below a uniformly chosen earlier node.
+     */
+    enum class e_tree_shape : uint8_t {
+        chain,
+        star,
+        k_ary,
+        random
+    };
+
+    /** Number of children per node in the k_ary shape. */
+    constexpr std::size_t k_arity = 4;
+
+    /** Seed of the generator behind the random shape and the node values. */
+    constexpr std::uint32_t k_seed = 20240517;
+
+    /** Number of consecutive recipe nodes a thread appends in one turn. */
+    constexpr std::size_t k_parallel_chunk = 256;
+
+    const char* shape_name(e_tree_shape shape)
+    {
+        switch (shape)
+        {
+        case e_tree_shape::chain: return "chain";
+        case e_tree_shape::star: return "star";
+        case e_tree_shape::k_ary: return "k_ary";
+        default: return "random";
+        }
+    }
+
+    const char* allocation_name(e_node_allocation allocation)
+    {
+        return allocation == e_node_allocation::arena ? "arena" : "heap";
+    }
+
+    const char* path_name(e_type_of_path_on_tree type)
+    {
+        switch (type)
+        {
+        case e_type_of_path_on_tree::pre_order: return "pre_order";
+        case e_type_of_path_on_tree::in_order: return "in_order";
+        case e_type_of_path_on_tree::post_order: return "post_order";
+        default: return "level_order";
+        }
+    }
+
+    const char* translation_name(e_type_of_tree_translation type)
+    {
+        switch (type)
+        {
+        case e_type_of_tree_translation::mirror: return "mirror";
+        case e_type_of_tree_translation::sort_ascending:
+            return "sort_ascending";
+        default: return "sort_descending";
+        }
+    }
+
+    /**
+     * A tree described by flat arrays: node i holds values[i] and hangs
+     * below node parents[i], which always comes first. Generated once per
+     * shape so that only tree operations are timed.
+     */
+    struct tree_recipe
+    {
+        std::vector<int> values;
+        std::vector<std::size_t> parents;
+    };
+
+    /**
+     * Generates the recipe of a tree. The generator is used through its raw
+     * output only, so the recipe is the same on every standard library.
+     *
+     * @param shape The shape of the tree.
+     * @param count The number of nodes, at least 1.
+     * @return The recipe.
+     */
+    tree_recipe make_recipe(e_tree_shape shape, std::size_t count)
+    {
+        std::mt19937 rng(k_seed);
+        tree_recipe recipe;
+        recipe.values.resize(count);
+        recipe.parents.resize(count, 0);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            recipe.values[i] = static_cast<int>(rng() % 1000000);
+            if (i == 0) continue;
+            switch (shape)
+            {
+            case e_tree_shape::chain: recipe.parents[i] = i - 1; break;
+            case e_tree_shape::star: recipe.parents[i] = 0; break;
+            case e_tree_shape::k_ary:
+                recipe.parents[i] = (i - 1) / k_arity;
+                break;
+            case e_tree_shape::random: recipe.parents[i] = rng() % i; break;
+            }
+        }
+        return recipe;
+    }
+
+    /**
+     * Builds a tree from a recipe with add_root and add_child.
+     *
+     * @param target An empty tree.
+     * @param recipe The tree to build.
+     */
+    void build(tree<int>& target, const tree_recipe& recipe)
+    {
+        std::vector<tree_node<int>*> nodes(recipe.values.size());
+        nodes[0] = target.add_root(recipe.values[0]);
+        for (std::size_t i = 1; i < nodes.size(); ++i)
+            nodes[i] = nodes[recipe.parents[i]]->add_child(recipe.values[i]);
+    }
+
+    /**
+     * Builds a concurrent tree from a recipe on the calling thread.
+     *
+     * @param target An empty concurrent tree.
+     * @param recipe The tree to build.
+     */
+    void build(concurrent_tree<int>& target, const tree_recipe& recipe)
+    {
+        std::vector<concurrent_node<int>*> nodes(recipe.values.size());
+        nodes[0] = target.add_root(recipe.values[0]);
+        for (std::size_t i = 1; i < nodes.size(); ++i)
+            nodes[i] = nodes[recipe.parents[i]]->add_child(recipe.values[i]);
+    }
+
+    /**
+     * Builds a concurrent tree from a recipe on several threads. The nodes
+     * are dealt out in chunks of k_parallel_chunk, round robin, and a
+     * thread waits for the parent of a node to be published before
+     * appending it, so every shape can be built; a chain still grows one
+     * node at a time.
+     *
+     * @param target An empty concurrent tree.
+     * @param recipe The tree to build.
+     * @param threads The number of threads, at least 1.
+     */
+    void build(concurrent_tree<int>& target, const tree_recipe& recipe,
+        std::size_t threads)
+    {
+        std::vector<std::atomic<concurrent_node<int>*>> nodes(
+            recipe.values.size());
+        nodes[0].store(target.add_root(recipe.values[0]),
+            std::memory_order_release);
+
+        auto work = [&](std::size_t thread) {
+            const std::size_t stride = threads * k_parallel_chunk;
+            for (std::size_t start = thread * k_parallel_chunk;
+                start < nodes.size(); start += stride)
+            {
+                const std::size_t stop =
+                    (std::min)(start + k_parallel_chunk, nodes.size());
+                for (std::size_t i = (std::max)(start, std::size_t{ 1 });
+                    i < stop; ++i)
+                {
+                    auto& parent = nodes[recipe.parents[i]];
+                    concurrent_node<int>* node;
+                    while (!(node = parent.load(std::memory_order_acquire)))
+                        std::this_thread::yield();
+                    nodes[i].store(node->add_child(recipe.values[i]),
+                        std::memory_order_release);
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (std::size_t t = 1; t < threads; ++t)
+            workers.emplace_back(work, t);
+        work(0);
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    /**
+     * Times a callable.
+     *
+     * @param work The code to time.
+     * @return The elapsed time in nanoseconds.
+     */
+    template<typename Work>
+    std::int64_t time_ns(Work&& work)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        work();
+        const auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            stop - start).count();
+    }
+
+    /** The samples of one operation on one shape and allocation policy. */
+    struct measurement
+    {
+        std::string operation;
+        e_tree_shape shape;
+        e_node_allocation allocation;
+        std::vector<std::int64_t> samples;
+    };
+
+    /**
+     * Finds the sample list of an operation, creating it on first use.
+     */
+    measurement& find(std::vector<measurement>& results,
+        const std::string& operation, e_tree_shape shape,
+        e_node_allocation allocation)
+    {
+        for (auto& result : results)
+        {
+            if (result.operation == operation && result.shape == shape &&
+                result.allocation == allocation)
+                return result;
+        }
+        results.push_back({ operation, shape, allocation, {} });
+        return results.back();
+    }
+
+    /**
+     * Runs one repetition of every operation on a shape.
+     *
+     * @param results Receives one sample per operation.
+     * @param recipe The tree to operate on.
+     * @param shape The shape the recipe was made from.
+     * @param allocation The allocation policy of the trees.
+     * @param threads The number of threads growing the concurrent tree.
+     */
+    void run_repetition(std::vector<measurement>& results,
+        const tree_recipe& recipe, e_tree_shape shape,
+        e_node_allocation allocation, std::size_t threads)
+    {
+        static volatile std::size_t sink = 0;
+        auto record = [&](const std::string& operation, std::int64_t ns) {
+            find(results, operation, shape, allocation).samples.push_back(ns);
+        };
+
+        tree<int> subject(allocation);
+        record("add_child", time_ns([&] { build(subject, recipe); }));
+
+        for (const auto type : { e_type_of_path_on_tree::pre_order,
+            e_type_of_path_on_tree::in_order,
+            e_type_of_path_on_tree::post_order,
+            e_type_of_path_on_tree::level_order })
+        {
+            record(std::string("path.") + path_name(type), time_ns([&] {
+                sink = sink + subject.path<tree_node<int>>(type).size();
+            }));
+        }
+
+        // Every translation starts from a freshly built tree, so that a sort
+        // never benefits from the order left behind by the previous one.
+        for (const auto type : { e_type_of_tree_translation::mirror,
+            e_type_of_tree_translation::sort_ascending,
+            e_type_of_tree_translation::sort_descending })
+        {
+            tree<int> translated(allocation);
+            build(translated, recipe);
+            record(std::string("translate.") + translation_name(type),
+                time_ns([&] { translated.translate(type); }));
+        }
+
+        record("clear", time_ns([&] { subject.clear(); }));
+
+        // The concurrent tree is timed on one thread, which shows the cost
+        // of its atomic appends, followed by sealing it into a regular tree.
+        concurrent_tree<int> growing;
+        record("concurrent.add_child", time_ns([&] {
+            build(growing, recipe);
+        }));
+        tree<int> sealed(allocation);
+        record("concurrent.seal", time_ns([&] { growing.seal(sealed); }));
+
+        // The same tree grown by several threads at once, whose nodes end
+        // up spread over the blocks of every thread before being sealed.
+        concurrent_tree<int> shared;
+        record("concurrent.add_child.parallel", time_ns([&] {
+            build(shared, recipe, threads);
+        }));
+        tree<int> shared_sealed(allocation);
+        record("concurrent.seal.parallel", time_ns([&] {
+            shared.seal(shared_sealed);
+        }));
+    }
+
+    /**
+     * Writes the results as a JSON document.
+     *
+     * @param out The stream to write to.
+     * @param results The samples of every operation.
+     * @param nodes The number of nodes per tree.
+     * @param repetitions The number of samples per operation.
+     * @param threads The number of threads of the parallel operations.
+     */
+    void write_json(std::FILE* out, std::vector<measurement>& results,
+        std::size_t nodes, std::size_t repetitions, std::size_t threads)
+    {
+        std::fprintf(out, "{\n");
+        std::fprintf(out, "  \"benchmark\": \"tree_builder\",\n");
+        std::fprintf(out, "  \"nodes\": %zu,\n", nodes);
+        std::fprintf(out, "  \"repetitions\": %zu,\n", repetitions);
+        std::fprintf(out, "  \"threads\": %zu,\n", threads);
+        std::fprintf(out, "  \"seed\": %u,\n", k_seed);
+        std::fprintf(out, "  \"k_ary_arity\": %zu,\n", k_arity);
+        std::fprintf(out, "  \"unit\": \"ns\",\n");
+        std::fprintf(out, "  \"results\": [\n");
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            auto& samples = results[i].samples;
+            std::sort(samples.begin(), samples.end());
+            std::int64_t total = 0;
+            for (const auto sample : samples) total += sample;
+
+            std::fprintf(out, "    { \"shape\": \"%s\", \"allocation\": \"%s\","
+                " \"operation\": \"%s\", \"min\": %lld, \"median\": %lld,"
+                " \"mean\": %lld, \"max\": %lld }%s\n",
+                shape_name(results[i].shape),
+                allocation_name(results[i].allocation),
+                results[i].operation.c_str(),
+                static_cast<long long>(samples.front()),
+                static_cast<long long>(samples[samples.size() / 2]),
+                static_cast<long long>(total /
+                    static_cast<std::int64_t>(samples.size())),
+                static_cast<long long>(samples.back()),
+                i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+
+    void print_usage(const char* program)
+    {
+        std::fprintf(stderr, "usage: %s [--nodes N] [--repetitions R]"
+            " [--threads T] [--output FILE]\n", program);
+    }
+}
+
+/**
+ * Times the core tree operations on several tree shapes and prints the
+ * results as JSON, to standard output or to the file given with --output.
+ * Every run with the same arguments operates on the same trees.
+ */
+int main(int argc, char** argv)
+{
+    std::size_t nodes = 100000;
+    std::size_t repetitions = 5;
+    std::size_t threads = (std::max)(2u, std::thread::hardware_concurrency());
+    const char* output = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--nodes") == 0 && has_value)
+            nodes = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--repetitions") == 0 && has_value)
+            repetitions = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+            threads = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--output") == 0 && has_value)
+            output = argv[++i];
+        else
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (nodes == 0 || repetitions == 0 || threads == 0)
+    {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<measurement> results;
+    for (const auto shape : { e_tree_shape::chain, e_tree_shape::star,
+        e_tree_shape::k_ary, e_tree_shape::random })
+    {
+        const tree_recipe recipe = make_recipe(shape, nodes);
+        for (const auto allocation : { e_node_allocation::heap,
+            e_node_allocation::arena })
+        {
+            for (std::size_t r = 0; r < repetitions; ++r)
+                run_repetition(results, recipe, shape, allocation,
+                    threads);
+        }
+    }
+
+    std::FILE* out = output ? std::fopen(output, "w") : stdout;
+    if (!out)
+    {
+        std::fprintf(stderr, "cannot open %s\n", output);
+        return 1;
+    }
+    write_json(out, results, nodes, repetitions, threads);
+    if (output) std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace tree_builder
+{
+    /** Number of playable (dark) squares of a checkers board. */
+    constexpr std::uint32_t k_board_squares = 32;
+
+    /** Number of rows and columns of a checkers board. */
+    constexpr std::uint32_t k_board_width = 8;
+
+    /**
+     * A checkers position packed into a fixed-size record, meant to be
+     * stored directly in tree nodes and to cross the C ABI unchanged.
+     * Only the 32 dark squares, those whose row plus column is odd, can hold
+     * a piece; square s is row s / 4 and the s % 4-th dark square of that
+     * row, counting columns from the left. Each bitboard has bit s set when
+     * square s holds a matching piece.
+     *
+     * The cell characters used by the Python front end map as follows:
+     * '.' empty, 'P' player man, 'D' player king, 'C' computer man and
+     * 'K' computer king.
+     */
+    struct board_record
+    {
+        /** Squares holding a player piece, man or king. */
+        std::uint32_t player;
+
+        /** Squares holding a computer piece, man or king. */
+        std::uint32_t computer;
+
+        /** Squares holding a king of either side. */
+        std::uint32_t kings;
+
+        /** Side to move: 0 for the player, 1 for the computer. */
+        std::uint32_t side_to_move;
+    };
+
+    static_assert(sizeof(board_record) == 16,
+        "board_record must keep the layout the C ABI exposes");
+
+    /**
+     * Compares two records field by field, player pieces first. Gives trees
+     * of boards a strict weak order for the sorting translations.
+     */
+    constexpr bool operator<(const board_record& a, const board_record& b)
+        noexcept
+    {
+        if (a.player != b.player) return a.player < b.player;
+        if (a.computer != b.computer) return a.computer < b.computer;
+        if (a.kings != b.kings) return a.kings < b.kings;
+        return a.side_to_move < b.side_to_move;
+    }
+
+    constexpr bool operator==(const board_record& a, const board_record& b)
+        noexcept
+    {
+        return a.player == b.player && a.computer == b.computer &&
+            a.kings == b.kings && a.side_to_move == b.side_to_move;
+    }
+
+    constexpr bool operator!=(const board_record& a, const board_record& b)
+        noexcept
+    {
+        return !(a == b);
+    }
+
+    /**
+     * Gets the square of a board cell.
+     *
+     * @param row The row, below k_board_width.
+     * @param column The column, below k_board_width.
+     * @return The square index, or k_board_squares for a light cell.
+     */
+    constexpr std::uint32_t square_of(std::uint32_t row, std::uint32_t column)
+        noexcept
+    {
+        return (row + column) % 2 == 1 ? row * 4 + column / 2 :
+            k_board_squares;
+    }
+
+    /**
+     * Packs a board given as 64 cell characters, row by row.
+     *
+     * @param cells The cells, using the characters listed in board_record.
+     * Unknown characters count as empty.
+     * @param side_to_move 0 for the player, 1 for the computer.
+     * @return The packed board.
+     */
+    inline board_record encode_board(const char* cells,
+        std::uint32_t side_to_move) noexcept
+    {
+        board_record board{ 0, 0, 0, side_to_move };
+        for (std::uint32_t row = 0; row < k_board_width; ++row)
+        {
+            for (std::uint32_t column = 0; column < k_board_width; ++column)
+            {
+                const std::uint32_t square = square_of(row, column);
+                if (square == k_board_squares) continue;
+                const std::uint32_t bit = std::uint32_t{ 1 } << square;
+                switch (cells[row * k_board_width + column])
+                {
+                case 'D': board.kings |= bit; [[fallthrough]];
+                case 'P': board.player |= bit; break;
+                case 'K': board.kings |= bit; [[fallthrough]];
+                case 'C': board.computer |= bit; break;
+                default: break;
+                }
+            }
+        }
+        return board;
+    }
+
+    /**
+     * Unpacks a board into 64 cell characters, row by row.
+     *
+     * @param board The packed board.
+     * @param cells Receives the cells, using the characters listed in
+     * board_record. Not null-terminated.
+     */
+    inline void decode_board(const board_record& board, char* cells) noexcept
+    {
+        for (std::uint32_t row = 0; row < k_board_width; ++row)
+        {
+            for (std::uint32_t column = 0; column < k_board_width; ++column)
+            {
+                const std::uint32_t square = square_of(row, column);
+                char cell = '.';
+                if (square != k_board_squares)
+                {
+                    const std::uint32_t bit = std::uint32_t{ 1 } << square;
+                    const bool king = (board.kings & bit) != 0;
+                    if (board.player & bit) cell = king ? 'D' : 'P';
+                    else if (board.computer & bit) cell = king ? 'K' : 'C';
+                }
+                cells[row * k_board_width + column] = cell;
+            }
+        }
+    }
+};
+
+namespace std
+{
+    /**
+     * Hashes a board for the hash-based structures, such as shared_tree.
+     */
+    template<>
+    struct hash<tree_builder::board_record>
+    {
+        std::size_t operator()(const tree_builder::board_record& board) const
+            noexcept
+        {
+            std::uint64_t value = (std::uint64_t{ board.player } << 32 |
+                board.computer) * 0x9E3779B97F4A7C15ull;
+            value ^= (std::uint64_t{ board.kings } << 1 |
+                board.side_to_move) + (value >> 29);
+            return static_cast<std::size_t>(value * 0xBF58476D1CE4E5B9ull);
+        }
+    };
+};
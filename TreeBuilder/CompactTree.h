@@ -0,0 +1,435 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+
+#include "Tree.h"
+#include "ArrayView.h"
+
+namespace tree_builder
+{
+    /**
+     * Traverses a forest stored in CSR form: the children of node i are
+     * children[child_offsets[i]] up to children[child_offsets[i + 1]]. The
+     * nodes must be numbered in pre-order, so that a pre-order path is simply
+     * 0, 1, ..., count - 1. Produces the same orders as tree::path.
+     *
+     * @param count The number of nodes.
+     * @param roots The indices of the root nodes.
+     * @param child_offsets Start of each node's children, plus an end marker.
+     * @param children Child indices, grouped per parent.
+     * @param type The type of traversal path to use.
+     * @return The node indices in traversal order.
+     */
+    inline std::vector<std::uint32_t> csr_path(std::size_t count,
+        array_view<const std::uint32_t> roots,
+        const std::uint32_t* child_offsets, const std::uint32_t* children,
+        e_type_of_path_on_tree type)
+    {
+        using index_type = std::uint32_t;
+        auto get_children = [&](index_type node) {
+            return array_view<const index_type>(children +
+                child_offsets[node],
+                child_offsets[node + 1] - child_offsets[node]);
+        };
+
+        std::vector<index_type> result;
+        result.reserve(count);
+
+        switch (type)
+        {
+            case e_type_of_path_on_tree::pre_order:
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                    result.push_back(static_cast<index_type>(i));
+                break;
+            }
+            case e_type_of_path_on_tree::in_order:
+            {
+                std::vector<std::pair<index_type, bool>> stack;
+                for (const index_type root : roots)
+                {
+                    stack.emplace_back(root, false);
+                    while (!stack.empty())
+                    {
+                        auto [node, visited] = stack.back();
+                        stack.pop_back();
+                        const auto node_children = get_children(node);
+
+                        if (visited || node_children.empty())
+                        {
+                            result.push_back(node);
+                            continue;
+                        }
+
+                        const std::size_t mid = node_children.size() / 2;
+                        for (std::size_t i = node_children.size();
+                            i-- > mid;)
+                            stack.emplace_back(node_children[i], false);
+                        stack.emplace_back(node, true);
+                        for (std::size_t i = mid; i-- > 0;)
+                            stack.emplace_back(node_children[i], false);
+                    }
+                }
+                break;
+            }
+            case e_type_of_path_on_tree::post_order:
+            {
+                std::vector<std::pair<index_type, bool>> stack;
+                for (const index_type root : roots)
+                {
+                    stack.emplace_back(root, false);
+                    while (!stack.empty())
+                    {
+                        auto [node, visited] = stack.back();
+                        stack.pop_back();
+
+                        if (visited)
+                        {
+                            result.push_back(node);
+                            continue;
+                        }
+
+                        stack.emplace_back(node, true);
+                        const auto node_children = get_children(node);
+                        for (std::size_t i = node_children.size(); i-- > 0;)
+                            stack.emplace_back(node_children[i], false);
+                    }
+                }
+                break;
+            }
+            case e_type_of_path_on_tree::level_order:
+            {
+                // The result itself serves as the queue.
+                result.assign(roots.begin(), roots.end());
+                for (std::size_t i = 0; i < result.size(); ++i)
+                {
+                    const auto node_children = get_children(result[i]);
+                    result.insert(result.end(), node_children.begin(),
+                        node_children.end());
+                }
+                break;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * A read-optimized, immutable-shape snapshot of a tree.
+     * The forest is flattened into structure-of-arrays storage laid out in
+     * pre-order: node i owns values_[i] and parents_[i], and its children
+     * are the indices children_[child_offsets_[i]] up to
+     * children_[child_offsets_[i + 1]]. Traversals walk plain index arrays
+     * instead of chasing node pointers, and a pre-order path is a linear
+     * scan.
+     *
+     * @tparam T The type of data stored in each node.
+     */
+    template<typename T>
+    class compact_tree
+    {
+    public:
+        using index_type = std::uint32_t;
+        using node_type = tree_node<T>;
+
+        /** Parent index of root nodes. */
+        static constexpr index_type npos = static_cast<index_type>(-1);
+
+        /** A contiguous, non-owning range of node indices. */
+        using index_range = array_view<const index_type>;
+
+        // Constructor and destructor
+        compact_tree() = default;
+        ~compact_tree() = default;
+
+        /**
+         * Builds a snapshot of the given tree. The source is only read and
+         * can keep being used (or be destroyed) afterwards.
+         *
+         * @param source The tree to flatten.
+         */
+        explicit compact_tree(const tree<T>& source)
+        {
+            // The lazy path follows the orientation of the source, so a
+            // mirrored tree is stored with its children in mirrored order.
+            std::vector<const node_type*> order;
+            for (const node_type* node :
+                source.lazy_path(e_type_of_path_on_tree::pre_order))
+                order.push_back(node);
+
+            const std::size_t count = order.size();
+            values_.reserve(count);
+            parents_.assign(count, npos);
+            child_offsets_.assign(count + 1, 0);
+
+            // Every node is visited before its descendants, so the index of
+            // a parent is always known when one of its children comes up.
+            std::vector<index_type> next_child(count);
+            index_type total = 0;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                child_offsets_[i] = total;
+                next_child[i] = total;
+                total += static_cast<index_type>(
+                    order[i]->get_children().size());
+            }
+            child_offsets_[count] = total;
+            children_.resize(total);
+
+            std::vector<index_type> depth_stack;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const node_type* node = order[i];
+                values_.push_back(node->get_data());
+
+                while (!depth_stack.empty() &&
+                    order[depth_stack.back()] != node->get_parent())
+                    depth_stack.pop_back();
+
+                if (depth_stack.empty())
+                {
+                    roots_.push_back(static_cast<index_type>(i));
+                }
+                else
+                {
+                    const index_type parent = depth_stack.back();
+                    parents_[i] = parent;
+                    children_[next_child[parent]++] =
+                        static_cast<index_type>(i);
+                }
+                depth_stack.push_back(static_cast<index_type>(i));
+            }
+        }
+
+    public:
+        /**
+         * Gets the number of nodes in the snapshot.
+         *
+         * @return The node count.
+         */
+        std::size_t size() const noexcept { return values_.size(); }
+
+        /**
+         * Checks whether the snapshot has no nodes.
+         *
+         * @return True if there are no nodes.
+         */
+        bool empty() const noexcept { return values_.empty(); }
+
+        /**
+         * Retrieves the indices of the root nodes, in insertion order.
+         *
+         * @return A range over the root indices.
+         */
+        index_range get_roots() const noexcept
+        {
+            return { roots_.data(), roots_.size() };
+        }
+
+        /**
+         * Retrieves the children of a node.
+         *
+         * @param node The index of the node.
+         * @return A range over the indices of the node's children.
+         */
+        index_range get_children(index_type node) const noexcept
+        {
+            return { children_.data() + child_offsets_[node],
+                child_offsets_[node + 1] - child_offsets_[node] };
+        }
+
+        /**
+         * Gets the parent of a node.
+         *
+         * @param node The index of the node.
+         * @return The index of the parent, or npos for a root.
+         */
+        index_type get_parent(index_type node) const noexcept
+        {
+            return parents_[node];
+        }
+
+        /**
+         * Gets the data stored in a node.
+         *
+         * @param node The index of the node.
+         * @return Const reference to the node's data.
+         */
+        const T& get_data(index_type node) const noexcept
+        {
+            return values_[node];
+        }
+
+        /**
+         * Checks whether a node has no children.
+         *
+         * @param node The index of the node.
+         * @return True if the node is a leaf.
+         */
+        bool is_leaf(index_type node) const noexcept
+        {
+            return child_offsets_[node] == child_offsets_[node + 1];
+        }
+
+        /**
+         * Gets the contiguous array of node values in pre-order.
+         *
+         * @return Const reference to the value array.
+         */
+        const std::vector<T>& values() const noexcept { return values_; }
+
+        /**
+         * Gets the contiguous array of parent indices in pre-order.
+         *
+         * @return Const reference to the parent index array.
+         */
+        const std::vector<index_type>& parents() const noexcept
+        {
+            return parents_;
+        }
+
+        /**
+         * Gets the child offset array: node i's children start at
+         * child_offsets()[i], and the last entry is the total child count.
+         *
+         * @return Const reference to the child offset array.
+         */
+        const std::vector<index_type>& child_offsets() const noexcept
+        {
+            return child_offsets_;
+        }
+
+        /**
+         * Gets the child index array, grouped per parent.
+         *
+         * @return Const reference to the child index array.
+         */
+        const std::vector<index_type>& children() const noexcept
+        {
+            return children_;
+        }
+
+        /**
+         * Applies the same structural transformation as tree::translate and
+         * lays the snapshot out in pre-order again. Sorting is stable, like
+         * tree::translate, so children with equal values keep their order.
+         *
+         * @param type The transformation operation to apply on each node.
+         */
+        void translate(const e_type_of_tree_translation type)
+        {
+            for (std::size_t node = 0; node < size(); ++node)
+            {
+                auto* const first = children_.data() + child_offsets_[node];
+                auto* const last = children_.data() + child_offsets_[node + 1];
+
+                switch (type) {
+                case e_type_of_tree_translation::mirror:
+                    std::reverse(first, last);
+                    break;
+                case e_type_of_tree_translation::sort_ascending:
+                    std::stable_sort(first, last,
+                        [this](index_type a, index_type b) {
+                            return values_[a] < values_[b];
+                        });
+                    break;
+                case e_type_of_tree_translation::sort_descending:
+                    std::stable_sort(first, last,
+                        [this](index_type a, index_type b) {
+                            return values_[a] > values_[b];
+                        });
+                    break;
+                }
+            }
+            relayout();
+        }
+
+        /**
+         * Traverses the snapshot using the specified traversal strategy.
+         * Produces the same order as tree::path on the source tree.
+         *
+         * @param type The type of traversal path to use.
+         * @return The node indices in traversal order.
+         */
+        std::vector<index_type> path(e_type_of_path_on_tree type) const
+        {
+            return csr_path(size(), get_roots(), child_offsets_.data(),
+                children_.data(), type);
+        }
+
+    private:
+        /**
+         * Renumbers the nodes so that indices follow the pre-order induced by
+         * the current child lists.
+         */
+        void relayout()
+        {
+            const std::size_t count = size();
+            std::vector<index_type> order;
+            order.reserve(count);
+            std::vector<index_type> stack;
+            for (const index_type root : roots_)
+            {
+                stack.push_back(root);
+                while (!stack.empty())
+                {
+                    const index_type node = stack.back();
+                    stack.pop_back();
+                    order.push_back(node);
+                    const auto children = get_children(node);
+                    for (std::size_t i = children.size(); i-- > 0;)
+                        stack.push_back(children[i]);
+                }
+            }
+
+            std::vector<index_type> new_index(count);
+            for (std::size_t i = 0; i < count; ++i)
+                new_index[order[i]] = static_cast<index_type>(i);
+
+            std::vector<T> values;
+            std::vector<index_type> parents(count);
+            std::vector<index_type> offsets(count + 1);
+            std::vector<index_type> children;
+            values.reserve(count);
+            children.reserve(children_.size());
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const index_type old = order[i];
+                values.push_back(std::move(values_[old]));
+                parents[i] = parents_[old] == npos ? npos :
+                    new_index[parents_[old]];
+                offsets[i] = static_cast<index_type>(children.size());
+                for (const index_type child : get_children(old))
+                    children.push_back(new_index[child]);
+            }
+            offsets[count] = static_cast<index_type>(children.size());
+
+            for (auto& root : roots_)
+                root = new_index[root];
+
+            values_ = std::move(values);
+            parents_ = std::move(parents);
+            child_offsets_ = std::move(offsets);
+            children_ = std::move(children);
+        }
+
+    private:
+        /** Node values in pre-order. */
+        std::vector<T> values_;
+
+        /** Parent index of every node, npos for roots. */
+        std::vector<index_type> parents_;
+
+        /** Start of each node's slice of children_, plus one end marker. */
+        std::vector<index_type> child_offsets_;
+
+        /** Child indices of all nodes, grouped per parent. */
+        std::vector<index_type> children_;
+
+        /** Indices of the root nodes. */
+        std::vector<index_type> roots_;
+    };
+};
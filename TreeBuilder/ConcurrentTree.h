@@ -0,0 +1,490 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Tree.h"
+#include "Instrumentation.h"
+
+namespace tree_builder
+{
+    template<typename T>
+    class concurrent_tree;
+
+    /**
+     * A node of a concurrent_tree.
+     * Children are kept in an intrusive singly linked list whose head is
+     * swapped in with a compare-and-swap, so any number of threads can
+     * append children to the same node, or to different nodes, without
+     * locks. A node is fully built before it is published, and its data,
+     * parent and depth never change afterwards, so other threads may read
+     * the tree while it grows.
+     *
+     * @tparam T The type of data stored in each node.
+     */
+    template<typename T>
+    class concurrent_node
+    {
+    public:
+        friend class concurrent_tree<T>;
+        using node_type = concurrent_node<T>;
+
+        /**
+         * Forward range over the children of a node, newest first. Children
+         * appended while the range is walked may or may not be seen.
+         */
+        class child_range
+        {
+        public:
+            class iterator
+            {
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = node_type*;
+                using difference_type = std::ptrdiff_t;
+                using pointer = node_type* const*;
+                using reference = node_type* const&;
+
+                iterator() = default;
+                explicit iterator(node_type* node) noexcept : node_(node) {}
+
+                reference operator*() const noexcept { return node_; }
+
+                iterator& operator++() noexcept
+                {
+                    node_ = node_->next_sibling_;
+                    return *this;
+                }
+
+                iterator operator++(int) noexcept
+                {
+                    iterator copy = *this;
+                    ++*this;
+                    return copy;
+                }
+
+                friend bool operator==(const iterator& a, const iterator& b)
+                    noexcept
+                {
+                    return a.node_ == b.node_;
+                }
+
+                friend bool operator!=(const iterator& a, const iterator& b)
+                    noexcept
+                {
+                    return a.node_ != b.node_;
+                }
+
+            private:
+                node_type* node_ = nullptr;
+            };
+
+            explicit child_range(node_type* first) noexcept : first_(first) {}
+
+            iterator begin() const noexcept { return iterator(first_); }
+            iterator end() const noexcept { return iterator(); }
+
+        private:
+            node_type* first_;
+        };
+
+        // Deleted copy constructor and assignment operator
+        concurrent_node(const concurrent_node&) = delete;
+        concurrent_node& operator=(const concurrent_node&) = delete;
+
+    public:
+        /**
+         * Adds a new child with a copy of the given data. Safe to call from
+         * several threads at once, on the same node or on different ones.
+         *
+         * @param data The data to be stored in the new child.
+         * @return A pointer to the new child, whose address never changes.
+         */
+        node_type* add_child(const T& data)
+        {
+            return link_child(tree_->create(this, data));
+        }
+
+        /**
+         * Adds a new child by moving the given data. See the copying
+         * overload.
+         *
+         * @param data The data to be moved into the new child.
+         * @return A pointer to the new child.
+         */
+        node_type* add_child(T&& data)
+        {
+            return link_child(tree_->create(this, std::move(data)));
+        }
+
+        /**
+         * Gets the children published so far, newest first.
+         *
+         * @return A range over the children.
+         */
+        child_range get_children() const noexcept
+        {
+            return child_range(first_child_.load(std::memory_order_acquire));
+        }
+
+        /**
+         * Gets the number of children published so far.
+         *
+         * @return The child count.
+         */
+        std::uint32_t get_children_count() const noexcept
+        {
+            return children_count_.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Gets the data stored in the node.
+         *
+         * @return Const reference to the node's data.
+         */
+        const T& get_data() const noexcept { return data_; }
+
+        /**
+         * Gets the parent of the node.
+         *
+         * @return The parent, or nullptr for a root.
+         */
+        node_type* get_parent() const noexcept { return parent_; }
+
+        /**
+         * Gets the distance from this node to the root of its tree.
+         *
+         * @return The depth of the node, 0 for a root.
+         */
+        std::uint32_t get_depth() const noexcept { return depth_; }
+
+    private:
+        template<typename U>
+        concurrent_node(concurrent_tree<T>* owner, node_type* parent,
+            U&& data) : data_(std::forward<U>(data)), parent_(parent),
+            tree_(owner), depth_(parent ? parent->depth_ + 1 : 0) {}
+
+        ~concurrent_node() = default;
+
+        /**
+         * Publishes a fully constructed child at the head of the list.
+         */
+        node_type* link_child(node_type* child) noexcept
+        {
+            node_type* head = first_child_.load(std::memory_order_relaxed);
+            do
+            {
+                child->next_sibling_ = head;
+            } while (!first_child_.compare_exchange_weak(head, child,
+                std::memory_order_release, std::memory_order_relaxed));
+            children_count_.fetch_add(1, std::memory_order_release);
+            return child;
+        }
+
+    private:
+        /** The data stored in this node. */
+        T data_;
+
+        /** The parent node, nullptr for a root. */
+        node_type* parent_;
+
+        /** The tree owning this node. */
+        concurrent_tree<T>* tree_;
+
+        /** The most recently published child. */
+        std::atomic<node_type*> first_child_{ nullptr };
+
+        /** The sibling published just before this node. */
+        node_type* next_sibling_ = nullptr;
+
+        /** Number of published children. */
+        std::atomic<std::uint32_t> children_count_{ 0 };
+
+        /** Distance to the root of the tree. */
+        std::uint32_t depth_;
+    };
+
+    /**
+     * A tree that many threads can grow at once.
+     * Nodes are carved from blocks owned by the tree: every thread bump
+     * allocates from a block of its own in each tree it grows and only
+     * takes a lock to fetch a new block, so expansion scales with the
+     * number of threads, and nodes never move. Nothing is removed while
+     * building.
+     *
+     * Once building is over, seal() moves the nodes into a regular tree<T>
+     * for single-threaded use, keeping children in the order they were
+     * added.
+     *
+     * @tparam T The type of data stored in each node.
+     */
+    template<typename T>
+    class concurrent_tree
+    {
+    public:
+        using node_type = concurrent_node<T>;
+
+        // Constructor and destructor
+        concurrent_tree() = default;
+        ~concurrent_tree() { clear(); }
+
+        // Deleted copy constructor and assignment operator
+        concurrent_tree(const concurrent_tree&) = delete;
+        concurrent_tree& operator=(const concurrent_tree&) = delete;
+
+    public:
+        /**
+         * Adds a new root with a copy of the given data. Safe to call from
+         * several threads at once.
+         *
+         * @param data The data to be stored in the new root.
+         * @return A pointer to the new root.
+         */
+        node_type* add_root(const T& data)
+        {
+            return link_root(create(nullptr, data));
+        }
+
+        /**
+         * Adds a new root by moving the given data.
+         *
+         * @param data The data to be moved into the new root.
+         * @return A pointer to the new root.
+         */
+        node_type* add_root(T&& data)
+        {
+            return link_root(create(nullptr, std::move(data)));
+        }
+
+        /**
+         * Gets the roots published so far, newest first.
+         *
+         * @return A range over the roots.
+         */
+        typename node_type::child_range get_roots() const noexcept
+        {
+            return typename node_type::child_range(
+                first_root_.load(std::memory_order_acquire));
+        }
+
+        /**
+         * Gets the number of nodes created so far.
+         *
+         * @return The node count.
+         */
+        std::size_t size() const noexcept
+        {
+            return size_.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Moves every node into a regular tree, appending new roots to it,
+         * and leaves this tree empty. Children and roots keep the order in
+         * which they were added. No other thread may use this tree during
+         * the call.
+         *
+         * @param target The tree that receives the nodes.
+         */
+        void seal(tree<T>& target)
+        {
+            std::vector<node_type*> siblings;
+            std::vector<std::pair<node_type*, tree_node<T>*>> stack;
+
+            // Sibling lists are newest first, so pushing them in list order
+            // pops the oldest sibling first.
+            collect(first_root_.load(std::memory_order_acquire), siblings);
+            for (node_type* root : siblings)
+                stack.emplace_back(root, nullptr);
+
+            while (!stack.empty())
+            {
+                auto [source, parent] = stack.back();
+                stack.pop_back();
+
+                tree_node<T>* copy = parent ?
+                    parent->add_child(std::move(source->data_)) :
+                    target.add_root(std::move(source->data_));
+
+                collect(source->first_child_.load(std::memory_order_acquire),
+                    siblings);
+                for (node_type* child : siblings)
+                    stack.emplace_back(child, copy);
+            }
+            clear();
+        }
+
+        /**
+         * Destroys every node. No other thread may use this tree during the
+         * call.
+         */
+        void clear()
+        {
+            if constexpr (!std::is_trivially_destructible_v<T>)
+            {
+                std::vector<node_type*> stack;
+                for (node_type* root : get_roots())
+                    stack.push_back(root);
+                while (!stack.empty())
+                {
+                    node_type* node = stack.back();
+                    stack.pop_back();
+                    for (node_type* child : node->get_children())
+                        stack.push_back(child);
+                    node->~node_type();
+                }
+            }
+
+            for (void* block : blocks_)
+                ::operator delete(block);
+            blocks_.clear();
+            first_root_.store(nullptr, std::memory_order_relaxed);
+            size_.store(0, std::memory_order_relaxed);
+
+            // Threads may still cache a block of this tree; a new identity
+            // makes them fetch a fresh one.
+            id_ = next_id();
+        }
+
+    private:
+        friend class concurrent_node<T>;
+
+        /** The block a thread is allocating nodes from in one tree. */
+        struct thread_cache
+        {
+            std::uint64_t owner = 0;
+            std::uint64_t last_use = 0;
+            unsigned char* cursor = nullptr;
+            unsigned char* end = nullptr;
+        };
+
+        /**
+         * Creates a node from the calling thread's block.
+         */
+        template<typename U>
+        node_type* create(node_type* parent, U&& data)
+        {
+            TREE_BUILDER_INSTRUMENT(allocate_node);
+            thread_cache& cache = find_cache();
+            if (cache.cursor == cache.end)
+            {
+                cache.cursor = allocate_block();
+                cache.end = cache.cursor + k_block_nodes * sizeof(node_type);
+            }
+
+            // A slot is lost if the constructor throws, and reclaimed with
+            // its block.
+            node_type* node = ::new (cache.cursor) node_type(this, parent,
+                std::forward<U>(data));
+            cache.cursor += sizeof(node_type);
+            size_.fetch_add(1, std::memory_order_relaxed);
+            return node;
+        }
+
+        /**
+         * Finds the calling thread's block for this tree. A tree the thread
+         * has no entry for takes the least recently used one, so entries of
+         * cleared or destroyed trees are the first to go; the unused slots
+         * of an evicted block are reclaimed with its tree.
+         */
+        thread_cache& find_cache() noexcept
+        {
+            thread_cache* cache = nullptr;
+            thread_cache* oldest = caches_;
+            for (thread_cache& entry : caches_)
+            {
+                if (entry.owner == id_)
+                {
+                    cache = &entry;
+                    break;
+                }
+                if (entry.last_use < oldest->last_use)
+                    oldest = &entry;
+            }
+            if (!cache)
+            {
+                cache = oldest;
+                *cache = { id_, 0, nullptr, nullptr };
+            }
+            cache->last_use = ++uses_;
+            return *cache;
+        }
+
+        /**
+         * Allocates a block for the calling thread.
+         */
+        unsigned char* allocate_block()
+        {
+            std::lock_guard<std::mutex> lock(blocks_mutex_);
+            blocks_.reserve(blocks_.size() + 1);
+            void* block = ::operator new(k_block_nodes * sizeof(node_type));
+            blocks_.push_back(block);
+            return static_cast<unsigned char*>(block);
+        }
+
+        /**
+         * Publishes a fully constructed root.
+         */
+        node_type* link_root(node_type* root) noexcept
+        {
+            node_type* head = first_root_.load(std::memory_order_relaxed);
+            do
+            {
+                root->next_sibling_ = head;
+            } while (!first_root_.compare_exchange_weak(head, root,
+                std::memory_order_release, std::memory_order_relaxed));
+            return root;
+        }
+
+        /**
+         * Copies a sibling list, newest first, into a vector.
+         */
+        static void collect(node_type* first, std::vector<node_type*>& out)
+        {
+            out.clear();
+            for (node_type* node = first; node; node = node->next_sibling_)
+                out.push_back(node);
+        }
+
+        /** Gets a process-wide unique tree identity. */
+        static std::uint64_t next_id() noexcept
+        {
+            static std::atomic<std::uint64_t> counter{ 0 };
+            return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+
+    private:
+        /** Number of nodes in a block. */
+        static constexpr std::size_t k_block_nodes = 1024;
+
+        /** Number of trees a thread keeps a block of at once. */
+        static constexpr std::size_t k_cached_trees = 8;
+
+        /** Identity checked against the blocks cached by threads. */
+        std::uint64_t id_ = next_id();
+
+        /** The most recently published root. */
+        std::atomic<node_type*> first_root_{ nullptr };
+
+        /** Number of nodes created. */
+        std::atomic<std::size_t> size_{ 0 };
+
+        /** Guards blocks_. */
+        std::mutex blocks_mutex_;
+
+        /** Every block owned by the tree. */
+        std::vector<void*> blocks_;
+
+        /** The blocks of the calling thread, one per tree it grows. */
+        static inline thread_local thread_cache caches_[k_cached_trees];
+
+        /** Counts the calling thread's allocations, to age its entries. */
+        static inline thread_local std::uint64_t uses_ = 0;
+    };
+};
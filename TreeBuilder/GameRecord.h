@@ -0,0 +1,843 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "ArrayView.h"
+#include "BoardRecord.h"
+#include "MappedFile.h"
+#include "MoveGenerator.h"
+#include "TaskPool.h"
+#include "TreeBuilderData.h"
+#include "TreeFile.h"
+
+namespace tree_builder
+{
+    /**
+     * Fixed-size header at the start of the two files of a game archive.
+     * The data file holds the games one after another; the index file,
+     * named like the data file plus ".idx", holds the offset of each game
+     * in the data file, so that any game is reached without reading the
+     * ones before it. Both files are only ever appended to. Every field is
+     * little-endian:
+     *
+     * - file header (16 bytes): magic, "TBGR" for the data file and "TBGI"
+     * for the index file, version (uint16), then zero padding;
+     * - data file: per game a game_header, then one byte per move;
+     * - index file: per game its offset in the data file (uint64).
+     */
+    struct game_file_header
+    {
+        static constexpr unsigned char k_data_magic[4] = {
+            'T', 'B', 'G', 'R' };
+        static constexpr unsigned char k_index_magic[4] = {
+            'T', 'B', 'G', 'I' };
+        static constexpr std::uint16_t k_version = 1;
+        static constexpr std::size_t k_size = 16;
+
+        /**
+         * Encodes a file header.
+         *
+         * @param out Receives the k_size header bytes.
+         * @param magic The magic of the file.
+         */
+        static void encode(unsigned char* out, const unsigned char* magic)
+            noexcept
+        {
+            std::memset(out, 0, k_size);
+            std::memcpy(out, magic, 4);
+            tree_file_header::store_le(out + 4, k_version);
+        }
+
+        /**
+         * Checks a file header.
+         *
+         * @param in The file bytes.
+         * @param available The number of bytes in the file.
+         * @param magic The expected magic.
+         * @return True if the file starts with a valid header.
+         */
+        static bool check(const unsigned char* in, std::size_t available,
+            const unsigned char* magic) noexcept
+        {
+            return available >= k_size && std::memcmp(in, magic, 4) == 0 &&
+                tree_file_header::load_le<std::uint16_t>(in + 4) ==
+                k_version;
+        }
+    };
+
+    /**
+     * The fixed-width part of a stored game, followed in the data file by
+     * its moves. A move is stored as its index in the order
+     * move_generator::for_each_move produces the moves of the position, so
+     * it takes one byte and decoding replays the game.
+     */
+    struct game_header
+    {
+        static constexpr std::size_t k_size = 32;
+
+        /** Number of moves, each one byte. */
+        std::uint32_t move_count = 0;
+
+        /** The position the game starts from. */
+        board_record start{};
+
+        /**
+         * When the game was saved, in seconds since 1970 on the clock of
+         * the machine that played it; 0 if unknown.
+         */
+        std::int64_t saved_at = 0;
+
+        /** The outcome for the player, unknown for unfinished games. */
+        e_game_result result = e_game_result::unknown;
+
+        /**
+         * Encodes the header into its on-disk form.
+         *
+         * @param out Receives the k_size header bytes.
+         */
+        void encode(unsigned char* out) const noexcept
+        {
+            std::memset(out, 0, k_size);
+            tree_file_header::store_le(out, move_count);
+            tree_file_header::store_le(out + 4, start.player);
+            tree_file_header::store_le(out + 8, start.computer);
+            tree_file_header::store_le(out + 12, start.kings);
+            tree_file_header::store_le(out + 16, start.side_to_move);
+            tree_file_header::store_le(out + 20, saved_at);
+            out[28] = static_cast<unsigned char>(result);
+        }
+
+        /**
+         * Decodes and validates an on-disk header.
+         *
+         * @param in The header bytes, k_size of them.
+         * @return True if the fields hold valid values.
+         */
+        bool decode(const unsigned char* in) noexcept
+        {
+            move_count = tree_file_header::load_le<std::uint32_t>(in);
+            start.player = tree_file_header::load_le<std::uint32_t>(in + 4);
+            start.computer = tree_file_header::load_le<std::uint32_t>(
+                in + 8);
+            start.kings = tree_file_header::load_le<std::uint32_t>(in + 12);
+            start.side_to_move = tree_file_header::load_le<std::uint32_t>(
+                in + 16);
+            saved_at = tree_file_header::load_le<std::int64_t>(in + 20);
+            result = static_cast<e_game_result>(in[28]);
+            return start.side_to_move <= 1 &&
+                in[28] <= static_cast<unsigned char>(e_game_result::draw);
+        }
+    };
+
+    /** Marks a board that no legal move leads to. */
+    constexpr std::uint32_t k_no_game_move = 0xFFFFFFFFu;
+
+    /**
+     * Encodes the moves of a game.
+     *
+     * @param boards The positions of the game, the start first and then
+     * the board after each move.
+     * @param moves Receives one byte per move.
+     * @return False if a board does not follow from the one before by a
+     * legal move, or that move is not among the first 256.
+     */
+    inline bool encode_game_moves(array_view<const board_record> boards,
+        std::vector<std::uint8_t>& moves)
+    {
+        moves.clear();
+        for (std::size_t i = 1; i < boards.size(); ++i)
+        {
+            std::uint32_t index = 0;
+            std::uint32_t found = k_no_game_move;
+            move_generator::for_each_move(boards[i - 1],
+                [&](const board_record& child) {
+                    if (found == k_no_game_move && child == boards[i])
+                        found = index;
+                    ++index;
+                });
+            if (found > 0xFF) return false;
+            moves.push_back(static_cast<std::uint8_t>(found));
+        }
+        return true;
+    }
+
+    /**
+     * Replays the moves of a game.
+     *
+     * @param start The position the game starts from.
+     * @param moves The stored moves.
+     * @param count The number of moves.
+     * @param positions Receives count + 1 boards: the start, then the board
+     * after each move.
+     * @return False if a move does not exist in its position.
+     */
+    inline bool decode_game_moves(const board_record& start,
+        const std::uint8_t* moves, std::size_t count,
+        board_record* positions)
+    {
+        positions[0] = start;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::uint32_t index = 0;
+            bool found = false;
+            move_generator::for_each_move(positions[i],
+                [&](const board_record& child) {
+                    if (index++ == moves[i])
+                    {
+                        positions[i + 1] = child;
+                        found = true;
+                    }
+                });
+            if (!found) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Finds the games of a data file by walking their headers.
+     *
+     * @param data The bytes of the data file.
+     * @param size The number of bytes.
+     * @param offsets Receives the offset of each complete game.
+     * @return The end of the last complete game, or 0 if the file does not
+     * start with a valid header.
+     */
+    inline std::uint64_t scan_game_records(const unsigned char* data,
+        std::size_t size, std::vector<std::uint64_t>& offsets)
+    {
+        offsets.clear();
+        if (!game_file_header::check(data, size,
+            game_file_header::k_data_magic))
+            return 0;
+
+        std::uint64_t offset = game_file_header::k_size;
+        while (offset + game_header::k_size <= size)
+        {
+            game_header header;
+            if (!header.decode(data + offset)) break;
+            const std::uint64_t end = offset + game_header::k_size +
+                header.move_count;
+            if (end > size) break;
+            offsets.push_back(offset);
+            offset = end;
+        }
+        return offset;
+    }
+
+    /**
+     * Every position of many games, decoded at once.
+     */
+    struct game_batch
+    {
+        /** The header of each game. */
+        std::vector<game_header> headers;
+
+        /**
+         * Where the positions of each game start, plus the total: game i
+         * has positions offsets[i] to offsets[i + 1] - 1.
+         */
+        std::vector<std::uint64_t> offsets;
+
+        /** The positions of every game, the start of each game first. */
+        std::vector<board_record> positions;
+
+        /** Games left out because a stored move does not exist. */
+        std::size_t skipped = 0;
+    };
+
+    /**
+     * Appends games to a game archive, creating it when needed.
+     */
+    class game_record_writer
+    {
+    public:
+        // Constructor and destructor
+        game_record_writer() = default;
+        ~game_record_writer() = default;
+
+        // Deleted copy constructor and assignment operator
+        game_record_writer(const game_record_writer&) = delete;
+        game_record_writer& operator=(const game_record_writer&) = delete;
+
+    public:
+        /**
+         * Opens an archive for appending, creating it if it does not exist.
+         * A game cut short by an interrupted write is dropped, and an index
+         * that does not match the data file is rebuilt from it.
+         *
+         * @param path The path of the data file.
+         * @return False if the file exists but is not a game archive, or
+         * cannot be written.
+         */
+        bool open(const char* path)
+        {
+            close();
+            const std::string index_path = std::string(path) + ".idx";
+            std::vector<std::uint64_t> offsets;
+            std::uint64_t end = 0;
+            std::error_code error;
+            const auto size = std::filesystem::file_size(path, error);
+            if (!error && size > 0)
+            {
+                mapped_file existing;
+                if (!existing.open(path)) return false;
+                end = scan_game_records(existing.data(), existing.size(),
+                    offsets);
+                if (end == 0) return false;
+            }
+
+            if (end == 0)
+            {
+                if (!write_header(path, game_file_header::k_data_magic))
+                    return false;
+                end = game_file_header::k_size;
+            }
+            else if (end < size)
+            {
+                std::filesystem::resize_file(path, end, error);
+                if (error) return false;
+            }
+
+            if (!index_matches(index_path.c_str(), offsets) &&
+                !write_index(index_path.c_str(), offsets))
+                return false;
+
+            data_.open(path, std::ios::binary | std::ios::app);
+            index_.open(index_path, std::ios::binary | std::ios::app);
+            if (!data_ || !index_)
+            {
+                close();
+                return false;
+            }
+            end_ = end;
+            count_ = offsets.size();
+            return true;
+        }
+
+        /**
+         * Closes the archive, if open.
+         */
+        void close()
+        {
+            data_.close();
+            index_.close();
+            data_.clear();
+            index_.clear();
+            end_ = 0;
+            count_ = 0;
+        }
+
+        /**
+         * Checks whether an archive is open.
+         *
+         * @return True if an archive is open.
+         */
+        bool is_open() const { return data_.is_open(); }
+
+        /**
+         * Gets the number of games in the archive.
+         *
+         * @return The game count.
+         */
+        std::size_t size() const noexcept { return count_; }
+
+        /**
+         * Appends a game. The game is written before its index entry, so an
+         * interrupted append is repaired by the next open.
+         *
+         * @param boards The positions of the game, the start first and then
+         * the board after each move.
+         * @param result The outcome for the player.
+         * @param saved_at When the game was saved, in seconds since 1970.
+         * @return False if a board does not follow from the one before by a
+         * legal move, or the files could not be written.
+         */
+        bool append(array_view<const board_record> boards,
+            e_game_result result, std::int64_t saved_at)
+        {
+            if (!is_open() || boards.empty() ||
+                !encode_game_moves(boards, moves_))
+                return false;
+
+            game_header header;
+            header.move_count = static_cast<std::uint32_t>(moves_.size());
+            header.start = boards[0];
+            header.saved_at = saved_at;
+            header.result = result;
+            unsigned char bytes[game_header::k_size];
+            header.encode(bytes);
+            data_.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+            data_.write(reinterpret_cast<const char*>(moves_.data()),
+                static_cast<std::streamsize>(moves_.size()));
+            data_.flush();
+
+            unsigned char offset[8];
+            tree_file_header::store_le(offset, end_);
+            index_.write(reinterpret_cast<const char*>(offset),
+                sizeof(offset));
+            index_.flush();
+            if (!data_ || !index_) return false;
+
+            end_ += game_header::k_size + moves_.size();
+            ++count_;
+            return true;
+        }
+
+    private:
+        /**
+         * Creates or truncates a file holding only a file header.
+         */
+        static bool write_header(const char* path,
+            const unsigned char* magic)
+        {
+            unsigned char bytes[game_file_header::k_size];
+            game_file_header::encode(bytes, magic);
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+            return static_cast<bool>(file);
+        }
+
+        /**
+         * Checks whether an index file lists exactly the given offsets.
+         */
+        static bool index_matches(const char* path,
+            const std::vector<std::uint64_t>& offsets)
+        {
+            mapped_file index;
+            if (!index.open(path) || !game_file_header::check(index.data(),
+                index.size(), game_file_header::k_index_magic) ||
+                index.size() != game_file_header::k_size +
+                offsets.size() * 8)
+                return false;
+            const unsigned char* entries = index.data() +
+                game_file_header::k_size;
+            for (std::size_t i = 0; i < offsets.size(); ++i)
+            {
+                if (tree_file_header::load_le<std::uint64_t>(entries +
+                    i * 8) != offsets[i])
+                    return false;
+            }
+            return true;
+        }
+
+        /**
+         * Rewrites an index file from the offsets of the data file.
+         */
+        static bool write_index(const char* path,
+            const std::vector<std::uint64_t>& offsets)
+        {
+            unsigned char header[game_file_header::k_size];
+            game_file_header::encode(header, game_file_header::k_index_magic);
+            std::vector<unsigned char> entries(offsets.size() * 8);
+            for (std::size_t i = 0; i < offsets.size(); ++i)
+                tree_file_header::store_le(entries.data() + i * 8,
+                    offsets[i]);
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(entries.data()),
+                static_cast<std::streamsize>(entries.size()));
+            return static_cast<bool>(file);
+        }
+
+    private:
+        /** The data file, opened for appending. */
+        std::ofstream data_;
+
+        /** The index file, opened for appending. */
+        std::ofstream index_;
+
+        /** Size of the data file, where the next game goes. */
+        std::uint64_t end_ = 0;
+
+        /** Number of games in the archive. */
+        std::size_t count_ = 0;
+
+        /** Moves of the game being appended, kept to reuse its storage. */
+        std::vector<std::uint8_t> moves_;
+    };
+
+    /**
+     * A game archive mapped into memory for reading. Opening reads the
+     * offset index, or rebuilds it from the data file when it is missing
+     * or out of date; games are then decoded on demand, one at a time or
+     * all at once.
+     */
+    class game_archive
+    {
+    public:
+        // Constructor and destructor
+        game_archive() = default;
+        ~game_archive() = default;
+
+        // Deleted copy constructor and assignment operator
+        game_archive(const game_archive&) = delete;
+        game_archive& operator=(const game_archive&) = delete;
+
+    public:
+        /**
+         * Maps an archive, replacing any previously opened one.
+         *
+         * @param path The path of the data file.
+         * @return True if the file is a game archive.
+         */
+        bool open(const char* path)
+        {
+            close();
+            if (!data_.open(path) || !game_file_header::check(data_.data(),
+                data_.size(), game_file_header::k_data_magic))
+            {
+                close();
+                return false;
+            }
+            if (!read_index((std::string(path) + ".idx").c_str()))
+                scan_game_records(data_.data(), data_.size(), offsets_);
+            return true;
+        }
+
+        /**
+         * Unmaps the archive, if any.
+         */
+        void close() noexcept
+        {
+            data_.close();
+            offsets_.clear();
+        }
+
+        /**
+         * Checks whether an archive is open.
+         *
+         * @return True if an archive is open.
+         */
+        bool is_open() const noexcept { return data_.is_open(); }
+
+        /**
+         * Gets the number of games.
+         *
+         * @return The game count.
+         */
+        std::size_t size() const noexcept { return offsets_.size(); }
+
+        /**
+         * Gets the header of a game.
+         *
+         * @param game The index of the game, below size().
+         * @return Its header.
+         */
+        game_header get_header(std::size_t game) const noexcept
+        {
+            game_header header;
+            header.decode(data_.data() + offsets_[game]);
+            return header;
+        }
+
+        /**
+         * Gets the stored moves of a game.
+         *
+         * @param game The index of the game, below size().
+         * @return One byte per move, see game_header.
+         */
+        array_view<const std::uint8_t> get_moves(std::size_t game) const
+            noexcept
+        {
+            return { data_.data() + offsets_[game] + game_header::k_size,
+                get_header(game).move_count };
+        }
+
+        /**
+         * Decodes the positions of a game.
+         *
+         * @param game The index of the game, below size().
+         * @param positions Receives the start, then the board after each
+         * move.
+         * @return False if a stored move does not exist.
+         */
+        bool load(std::size_t game, std::vector<board_record>& positions)
+            const
+        {
+            const game_header header = get_header(game);
+            positions.resize(std::size_t{ header.move_count } + 1);
+            return decode_game_moves(header.start, get_moves(game).data(),
+                header.move_count, positions.data());
+        }
+
+        /**
+         * Decodes every game on the calling thread.
+         *
+         * @return The positions of every game.
+         */
+        game_batch load_all() const
+        {
+            game_batch batch = prepare_batch();
+            std::vector<std::uint8_t> valid(size(), 0);
+            decode_range(batch, valid, 0, size());
+            drop_invalid(batch, valid);
+            return batch;
+        }
+
+        /**
+         * Decodes every game, spreading chunks of games over a pool.
+         *
+         * @param pool The pool that runs the chunks.
+         * @return The positions of every game.
+         */
+        game_batch load_all(task_pool& pool) const
+        {
+            game_batch batch = prepare_batch();
+            std::vector<std::uint8_t> valid(size(), 0);
+            const std::size_t chunks = (size() + k_chunk - 1) / k_chunk;
+            std::atomic<std::size_t> running{ chunks };
+            for (std::size_t chunk = 0; chunk < chunks; ++chunk)
+            {
+                const std::size_t first = chunk * k_chunk;
+                const std::size_t last = (std::min)(first + k_chunk, size());
+                pool.submit([this, &batch, &valid, first, last, &running] {
+                    decode_range(batch, valid, first, last);
+                    running.fetch_sub(1, std::memory_order_release);
+                });
+            }
+            pool.wait_until([&] {
+                return running.load(std::memory_order_acquire) == 0;
+            });
+            drop_invalid(batch, valid);
+            return batch;
+        }
+
+    private:
+        /** Games decoded by one task. */
+        static constexpr std::size_t k_chunk = 256;
+
+        /**
+         * Reads the index file, if it matches the data file.
+         */
+        bool read_index(const char* path)
+        {
+            mapped_file index;
+            if (!index.open(path) || !game_file_header::check(index.data(),
+                index.size(), game_file_header::k_index_magic) ||
+                (index.size() - game_file_header::k_size) % 8 != 0)
+                return false;
+
+            const std::size_t count = (index.size() -
+                game_file_header::k_size) / 8;
+            const unsigned char* entries = index.data() +
+                game_file_header::k_size;
+            offsets_.resize(count);
+            std::uint64_t end = game_file_header::k_size;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const auto offset = tree_file_header::load_le<std::uint64_t>(
+                    entries + i * 8);
+                game_header header;
+                if (offset != end ||
+                    offset + game_header::k_size > data_.size() ||
+                    !header.decode(data_.data() + offset))
+                {
+                    offsets_.clear();
+                    return false;
+                }
+                offsets_[i] = offset;
+                end = offset + game_header::k_size + header.move_count;
+            }
+            if (end > data_.size())
+            {
+                offsets_.clear();
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Reads every header and sizes the batch.
+         */
+        game_batch prepare_batch() const
+        {
+            game_batch batch;
+            batch.headers.resize(size());
+            batch.offsets.resize(size() + 1, 0);
+            for (std::size_t i = 0; i < size(); ++i)
+            {
+                batch.headers[i] = get_header(i);
+                batch.offsets[i + 1] = batch.offsets[i] +
+                    batch.headers[i].move_count + 1;
+            }
+            batch.positions.resize(static_cast<std::size_t>(
+                batch.offsets.back()));
+            return batch;
+        }
+
+        /**
+         * Decodes a range of games into their slots of a batch.
+         */
+        void decode_range(game_batch& batch, std::vector<std::uint8_t>& valid,
+            std::size_t first, std::size_t last) const
+        {
+            for (std::size_t i = first; i < last; ++i)
+            {
+                valid[i] = decode_game_moves(batch.headers[i].start,
+                    get_moves(i).data(), batch.headers[i].move_count,
+                    batch.positions.data() + batch.offsets[i]) ? 1 : 0;
+            }
+        }
+
+        /**
+         * Removes the games that failed to decode, closing the gaps.
+         */
+        static void drop_invalid(game_batch& batch,
+            const std::vector<std::uint8_t>& valid)
+        {
+            if (std::find(valid.begin(), valid.end(), 0) == valid.end())
+                return;
+
+            std::size_t kept = 0;
+            std::uint64_t position = 0;
+            for (std::size_t i = 0; i < valid.size(); ++i)
+            {
+                const std::uint64_t first = batch.offsets[i];
+                const std::uint64_t last = batch.offsets[i + 1];
+                if (!valid[i])
+                {
+                    ++batch.skipped;
+                    continue;
+                }
+                std::copy(batch.positions.begin() + first,
+                    batch.positions.begin() + last,
+                    batch.positions.begin() + position);
+                batch.headers[kept] = batch.headers[i];
+                batch.offsets[kept] = position;
+                position += last - first;
+                ++kept;
+            }
+            batch.headers.resize(kept);
+            batch.offsets.resize(kept + 1);
+            batch.offsets[kept] = position;
+            batch.positions.resize(static_cast<std::size_t>(position));
+        }
+
+    private:
+        /** The mapped data file. */
+        mapped_file data_;
+
+        /** Offset of each game in the data file. */
+        std::vector<std::uint64_t> offsets_;
+    };
+
+    /**
+     * Reads a game saved by the Python front end: 8 lines of 8 cells
+     * separated by spaces, using the characters listed in board_record.
+     * The files do not record whose turn it was; loading them always
+     * resumes with the player to move, and so does this.
+     *
+     * @param path The path of the text file.
+     * @param board Receives the position.
+     * @return False if the file cannot be read or is not a board.
+     */
+    inline bool parse_saved_game(const char* path, board_record& board)
+    {
+        std::ifstream file(path);
+        if (!file) return false;
+        char cells[k_board_width * k_board_width];
+        std::size_t count = 0;
+        std::string cell;
+        while (file >> cell)
+        {
+            if (cell.size() != 1 || count == sizeof(cells)) return false;
+            cells[count++] = cell[0];
+        }
+        if (count != sizeof(cells)) return false;
+        board = encode_board(cells, 0);
+        return true;
+    }
+
+    /**
+     * Reads the time a saved game was started from its file name, which
+     * the Python front end builds as "jogo_YYYYMMDD_HHMMSS.txt".
+     *
+     * @param name The file name.
+     * @return Seconds since 1970 on the clock of the machine, or 0 if the
+     * name does not hold a time.
+     */
+    inline std::int64_t saved_game_time(const std::string& name)
+    {
+        const std::size_t start = name.find('_');
+        if (start == std::string::npos || name.size() < start + 16 ||
+            name[start + 9] != '_')
+            return 0;
+        std::int64_t digits[14];
+        for (std::size_t i = 0, at = start + 1; i < 14; ++i, ++at)
+        {
+            if (at == start + 9) ++at;
+            if (!std::isdigit(static_cast<unsigned char>(name[at])))
+                return 0;
+            digits[i] = name[at] - '0';
+        }
+        auto number = [&](std::size_t first, std::size_t length) {
+            std::int64_t value = 0;
+            for (std::size_t i = first; i < first + length; ++i)
+                value = value * 10 + digits[i];
+            return value;
+        };
+
+        // Days from civil date, valid for the proleptic Gregorian calendar.
+        const std::int64_t month = number(4, 2);
+        const std::int64_t year = number(0, 4) - (month <= 2 ? 1 : 0);
+        const std::int64_t era = year / 400;
+        const std::int64_t year_of_era = year - era * 400;
+        const std::int64_t day_of_year = (153 * (month + (month > 2 ?
+            -3 : 9)) + 2) / 5 + number(6, 2) - 1;
+        const std::int64_t day_of_era = year_of_era * 365 +
+            year_of_era / 4 - year_of_era / 100 + day_of_year;
+        const std::int64_t days = era * 146097 + day_of_era - 719468;
+        return days * 86400 + number(8, 2) * 3600 + number(10, 2) * 60 +
+            number(12, 2);
+    }
+
+    /**
+     * Appends every game saved by the Python front end in a directory to
+     * an archive, in file name order, as games of one position without
+     * moves: the text files keep no history. A game whose player has no
+     * move left is recorded as a loss for the player. Converting the same
+     * directory twice appends its games twice.
+     *
+     * @param directory The directory of the text files, jogos_salvos.
+     * @param writer An open archive.
+     * @return The number of games converted; files that are not boards
+     * are skipped.
+     */
+    inline std::size_t convert_saved_games(const char* directory,
+        game_record_writer& writer)
+    {
+        std::vector<std::filesystem::path> files;
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(
+            directory, error))
+        {
+            if (entry.is_regular_file(error) &&
+                entry.path().extension() == ".txt")
+                files.push_back(entry.path());
+        }
+        std::sort(files.begin(), files.end());
+
+        std::size_t converted = 0;
+        for (const auto& file : files)
+        {
+            board_record board;
+            if (!parse_saved_game(file.string().c_str(), board)) continue;
+            const e_game_result result = move_generator::count(board) == 0 ?
+                e_game_result::loss : e_game_result::unknown;
+            if (writer.append({ &board, 1 }, result,
+                saved_game_time(file.filename().string())))
+                ++converted;
+        }
+        return converted;
+    }
+};
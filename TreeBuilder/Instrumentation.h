@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "TreeBuilderData.h"
+
+namespace tree_builder
+{
+    /** Number of values in e_instrumented_call. */
+    constexpr std::size_t k_instrumented_calls = 4;
+
+    /**
+     * Process-wide call counts and cumulative times of the hot paths listed
+     * in e_instrumented_call.
+     * Recording is compiled in only when TREE_BUILDER_INSTRUMENTATION is
+     * defined; otherwise the TREE_BUILDER_INSTRUMENT macro expands to
+     * nothing, enabled() is false and every counter stays at zero. The
+     * counters are atomic, so trees on different threads can be measured
+     * at the same time.
+     */
+    class instrumentation
+    {
+    public:
+        /**
+         * Checks whether this build records calls.
+         *
+         * @return True if TREE_BUILDER_INSTRUMENTATION was defined.
+         */
+        static constexpr bool enabled() noexcept
+        {
+#ifdef TREE_BUILDER_INSTRUMENTATION
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * Gets the number of recorded calls of an operation.
+         *
+         * @param call The operation.
+         * @return The call count since the last reset.
+         */
+        static std::uint64_t get_calls(e_instrumented_call call) noexcept
+        {
+            return counter_of(call).calls.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * Gets the cumulative time spent in an operation.
+         *
+         * @param call The operation.
+         * @return The total time in nanoseconds since the last reset.
+         */
+        static std::uint64_t get_nanoseconds(e_instrumented_call call)
+            noexcept
+        {
+            return counter_of(call).nanoseconds.load(
+                std::memory_order_relaxed);
+        }
+
+        /**
+         * Records one call of an operation.
+         *
+         * @param call The operation.
+         * @param nanoseconds The time the call took.
+         */
+        static void record(e_instrumented_call call,
+            std::uint64_t nanoseconds) noexcept
+        {
+            counter& target = counter_of(call);
+            target.calls.fetch_add(1, std::memory_order_relaxed);
+            target.nanoseconds.fetch_add(nanoseconds,
+                std::memory_order_relaxed);
+        }
+
+        /**
+         * Sets every counter back to zero.
+         */
+        static void reset() noexcept
+        {
+            for (std::size_t i = 0; i < k_instrumented_calls; ++i)
+            {
+                counter& target = counters()[i];
+                target.calls.store(0, std::memory_order_relaxed);
+                target.nanoseconds.store(0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        /** Counters of one operation. */
+        struct counter
+        {
+            std::atomic<std::uint64_t> calls{ 0 };
+            std::atomic<std::uint64_t> nanoseconds{ 0 };
+        };
+
+        /** One counter per e_instrumented_call value. */
+        static counter* counters() noexcept
+        {
+            static counter instance[k_instrumented_calls];
+            return instance;
+        }
+
+        static counter& counter_of(e_instrumented_call call) noexcept
+        {
+            return counters()[static_cast<std::size_t>(call)];
+        }
+    };
+
+    /**
+     * Times the enclosing scope and records it as one call of an operation.
+     */
+    class scoped_call_timer
+    {
+    public:
+        explicit scoped_call_timer(e_instrumented_call call) noexcept
+            : call_(call), start_(std::chrono::steady_clock::now()) {}
+
+        ~scoped_call_timer()
+        {
+            const auto elapsed = std::chrono::steady_clock::now() - start_;
+            instrumentation::record(call_, static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    elapsed).count()));
+        }
+
+        // Deleted copy constructor and assignment operator
+        scoped_call_timer(const scoped_call_timer&) = delete;
+        scoped_call_timer& operator=(const scoped_call_timer&) = delete;
+
+    private:
+        /** The operation being timed. */
+        e_instrumented_call call_;
+
+        /** When the scope was entered. */
+        std::chrono::steady_clock::time_point start_;
+    };
+};
+
+#ifdef TREE_BUILDER_INSTRUMENTATION
+#define TREE_BUILDER_INSTRUMENT(call) \
+    ::tree_builder::scoped_call_timer tree_builder_call_timer_( \
+        ::tree_builder::e_instrumented_call::call)
+#else
+#define TREE_BUILDER_INSTRUMENT(call) ((void)0)
+#endif
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tree_builder
+{
+    /**
+     * Whether keys of a type can be radix sorted: integers other than bool,
+     * and enumerations, which compare like their underlying integer.
+     */
+    template<typename Key>
+    constexpr bool is_radix_key_v = (std::is_integral_v<Key> &&
+        !std::is_same_v<Key, bool>) || std::is_enum_v<Key>;
+
+    /**
+     * Maps a radix-sortable key to an unsigned integer of the same width
+     * whose natural order is the order of the keys.
+     *
+     * @param key The key.
+     * @return The unsigned image of the key.
+     */
+    template<typename Key>
+    constexpr auto to_radix_key(Key key) noexcept
+    {
+        if constexpr (std::is_enum_v<Key>)
+        {
+            return to_radix_key(static_cast<std::underlying_type_t<Key>>(key));
+        }
+        else
+        {
+            using unsigned_type = std::make_unsigned_t<Key>;
+            auto bits = static_cast<unsigned_type>(key);
+            if constexpr (std::is_signed_v<Key>)
+            {
+                // Flipping the sign bit puts negative keys first.
+                bits ^= static_cast<unsigned_type>(
+                    unsigned_type{ 1 } << (std::numeric_limits<
+                        unsigned_type>::digits - 1));
+            }
+            return bits;
+        }
+    }
+
+    /** Fewest items for the radix sort to beat a comparison sort. */
+    constexpr std::size_t k_radix_sort_threshold = 64;
+
+    /**
+     * Stably sorts items by a key, gathering the keys next to the items
+     * first so that the sort never has to go through an item to compare
+     * it. Radix-sortable keys compared with std::less are sorted by a least
+     * significant digit radix sort in linear time once there are at least
+     * k_radix_sort_threshold items; other keys, and fewer items, use
+     * std::stable_sort on the gathered pairs.
+     *
+     * @param first The first item.
+     * @param last One past the last item.
+     * @param project Maps an item to its key.
+     * @param comp The strict weak ordering of the keys.
+     * @param descending Whether to sort from the greatest key down. Equal
+     * keys keep their relative order either way.
+     */
+    template<typename Item, typename Projection, typename Compare>
+    void sort_by_key(Item* first, Item* last, Projection& project,
+        Compare& comp, bool descending)
+    {
+        using key_type = std::decay_t<std::invoke_result_t<Projection&,
+            const Item&>>;
+        const auto count = static_cast<std::size_t>(last - first);
+        if (count < 2) return;
+
+        if constexpr (is_radix_key_v<key_type> &&
+            std::is_same_v<std::decay_t<Compare>, std::less<>>)
+        {
+            if (count >= k_radix_sort_threshold)
+            {
+                using radix_type = decltype(to_radix_key(key_type{}));
+                constexpr std::size_t k_digits = sizeof(radix_type);
+
+                thread_local std::vector<std::pair<radix_type, Item>> keyed;
+                thread_local std::vector<std::pair<radix_type, Item>> spare;
+                keyed.resize(count);
+                spare.resize(count);
+
+                // One pass gathers the keys and counts every digit.
+                std::size_t histogram[k_digits][256] = {};
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    radix_type key = to_radix_key(std::invoke(project,
+                        first[i]));
+                    if (descending) key = static_cast<radix_type>(~key);
+                    keyed[i] = { key, std::move(first[i]) };
+                    for (std::size_t d = 0; d < k_digits; ++d)
+                        ++histogram[d][(key >> (8 * d)) & 0xFF];
+                }
+
+                for (std::size_t d = 0; d < k_digits; ++d)
+                {
+                    std::size_t* const buckets = histogram[d];
+                    // A digit shared by every key leaves the order as is.
+                    if (buckets[(keyed[0].first >> (8 * d)) & 0xFF] == count)
+                        continue;
+                    std::size_t offset = 0;
+                    for (std::size_t b = 0; b < 256; ++b)
+                    {
+                        const std::size_t size = buckets[b];
+                        buckets[b] = offset;
+                        offset += size;
+                    }
+                    for (auto& entry : keyed)
+                        spare[buckets[(entry.first >> (8 * d)) & 0xFF]++] =
+                            std::move(entry);
+                    keyed.swap(spare);
+                }
+
+                // The buffers keep their capacity for the next call but no
+                // items, which may own resources such as shared nodes.
+                for (std::size_t i = 0; i < count; ++i)
+                    first[i] = std::move(keyed[i].second);
+                keyed.clear();
+                spare.clear();
+                return;
+            }
+        }
+
+        thread_local std::vector<std::pair<key_type, Item>> keyed;
+        keyed.clear();
+        keyed.reserve(count);
+        for (auto* it = first; it != last; ++it)
+            keyed.emplace_back(std::invoke(project, *it), *it);
+        if (descending)
+        {
+            std::stable_sort(keyed.begin(), keyed.end(),
+                [&](const auto& a, const auto& b) {
+                    return comp(b.first, a.first);
+                });
+        }
+        else
+        {
+            std::stable_sort(keyed.begin(), keyed.end(),
+                [&](const auto& a, const auto& b) {
+                    return comp(a.first, b.first);
+                });
+        }
+        for (std::size_t i = 0; i < count; ++i)
+            first[i] = std::move(keyed[i].second);
+        keyed.clear();
+    }
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tree_builder
+{
+    /**
+     * A read-only memory mapping of a whole file.
+     * The operating system pages the contents in on demand, so opening a
+     * file is cheap regardless of its size and nothing is copied.
+     */
+    class mapped_file
+    {
+    public:
+        // Constructor and destructor
+        mapped_file() = default;
+        ~mapped_file() { close(); }
+
+        // Deleted copy constructor and assignment operator
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+    public:
+        /**
+         * Maps the given file, replacing any previous mapping.
+         *
+         * @param path The path of the file to map.
+         * @return True if the file was mapped.
+         */
+        bool open(const char* path)
+        {
+            close();
+#ifdef _WIN32
+            HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ,
+                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) return false;
+
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+            {
+                CloseHandle(file);
+                return false;
+            }
+
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY,
+                0, 0, nullptr);
+            CloseHandle(file);
+            if (!mapping) return false;
+
+            void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            if (!view) return false;
+
+            data_ = static_cast<const unsigned char*>(view);
+            size_ = static_cast<std::size_t>(size.QuadPart);
+#else
+            const int file = ::open(path, O_RDONLY);
+            if (file < 0) return false;
+
+            struct stat info;
+            if (fstat(file, &info) != 0 || info.st_size == 0)
+            {
+                ::close(file);
+                return false;
+            }
+
+            void* view = mmap(nullptr, static_cast<std::size_t>(info.st_size),
+                PROT_READ, MAP_SHARED, file, 0);
+            ::close(file);
+            if (view == MAP_FAILED) return false;
+
+            data_ = static_cast<const unsigned char*>(view);
+            size_ = static_cast<std::size_t>(info.st_size);
+#endif
+            return true;
+        }
+
+        /**
+         * Unmaps the file, if any.
+         */
+        void close() noexcept
+        {
+            if (!data_) return;
+#ifdef _WIN32
+            UnmapViewOfFile(data_);
+#else
+            munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+            data_ = nullptr;
+            size_ = 0;
+        }
+
+        /**
+         * Gets the first byte of the mapping, or nullptr if nothing is mapped.
+         *
+         * @return A pointer to the mapped bytes.
+         */
+        const unsigned char* data() const noexcept { return data_; }
+
+        /**
+         * Gets the size of the mapping in bytes.
+         *
+         * @return The mapped size.
+         */
+        std::size_t size() const noexcept { return size_; }
+
+        /**
+         * Checks whether a file is currently mapped.
+         *
+         * @return True if a file is mapped.
+         */
+        bool is_open() const noexcept { return data_ != nullptr; }
+
+    private:
+        /** The mapped bytes. */
+        const unsigned char* data_ = nullptr;
+
+        /** The size of the mapping in bytes. */
+        std::size_t size_ = 0;
+    };
+};
@@ -0,0 +1,477 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BoardRecord.h"
+#include "MoveGenerator.h"
+#include "TaskPool.h"
+#include "Tree.h"
+
+namespace tree_builder
+{
+    /**
+     * The payload of a node of a Monte Carlo search tree: a position and
+     * the statistics of the playouts that went through it. The statistics
+     * are atomic, and mutable so that search threads update them through
+     * the const data of a shared node.
+     */
+    struct mcts_record
+    {
+        /** The position. */
+        board_record board;
+
+        /** Playouts through this node, including those still running. */
+        mutable std::atomic<std::uint32_t> visits{ 0 };
+
+        /**
+         * Score of the finished playouts, for the side that moved into this
+         * node: 2 per win and 1 per draw.
+         */
+        mutable std::atomic<std::uint32_t> score{ 0 };
+
+        /** One of k_unexpanded, k_expanding and k_expanded. */
+        mutable std::atomic<std::uint8_t> state{ 0 };
+
+        /** The node has no children yet and nobody is adding them. */
+        static constexpr std::uint8_t k_unexpanded = 0;
+
+        /** A thread is adding the children. */
+        static constexpr std::uint8_t k_expanding = 1;
+
+        /** The children are in place and never change again. */
+        static constexpr std::uint8_t k_expanded = 2;
+
+        // Constructors
+        mcts_record() noexcept : board{} {}
+        explicit mcts_record(const board_record& position) noexcept
+            : board(position) {}
+
+        /** Copies a snapshot of the statistics. */
+        mcts_record(const mcts_record& other) noexcept : board(other.board),
+            visits(other.visits.load(std::memory_order_relaxed)),
+            score(other.score.load(std::memory_order_relaxed)),
+            state(other.state.load(std::memory_order_relaxed)) {}
+
+        mcts_record& operator=(const mcts_record& other) noexcept
+        {
+            board = other.board;
+            visits.store(other.visits.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+            score.store(other.score.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+            state.store(other.state.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+            return *this;
+        }
+    };
+
+    /**
+     * Orders records by position only, which is what a tree needs to keep
+     * or sort its children in order.
+     */
+    inline bool operator<(const mcts_record& a, const mcts_record& b) noexcept
+    {
+        return a.board < b.board;
+    }
+
+    /**
+     * The statistics of a move from the searched position.
+     */
+    struct mcts_child
+    {
+        /** The board the move leads to. */
+        board_record board;
+
+        /** Playouts that started with this move. */
+        std::uint32_t visits;
+
+        /** Average result for the side moving, from 0 (loss) to 1 (win). */
+        double value;
+    };
+
+    /**
+     * A Monte Carlo tree search of checkers positions whose tree is a
+     * tree<mcts_record>. Every playout descends from the root by UCT,
+     * adds the children of the leaf it stops at once that leaf was visited
+     * before, plays random moves to the end of the game and adds the result
+     * to every node on its way down.
+     *
+     * Several threads run playouts on the same tree at once. A thread counts
+     * its visit on the way down, before the result is known, so that other
+     * threads see the node as visited without a win (a virtual loss) and
+     * spread out over other branches; the statistics are atomic counters.
+     * A node is expanded by a single thread, under the lock that guards the
+     * allocator of the tree, and published through its atomic state, after
+     * which its children never change, so descending takes no lock.
+     *
+     * The tree outlives a search. Moving on to a position the tree already
+     * holds keeps its subtree and statistics and removes the rest, and the
+     * removed nodes go back to the free lists of the tree; other positions
+     * prune the whole tree the same way. Either way later expansions reuse
+     * the nodes instead of allocating.
+     */
+    class mcts_engine
+    {
+    public:
+        using node_type = tree_node<mcts_record>;
+
+        /** Moves after which a playout counts as a draw. */
+        static constexpr std::uint32_t k_playout_plies = 200;
+
+        /**
+         * Constructs an engine with the starting position.
+         *
+         * @param threads The number of playout threads; 0 picks one per
+         * hardware thread.
+         * @param exploration The UCT exploration constant.
+         */
+        explicit mcts_engine(std::size_t threads = 0,
+            double exploration = 1.4)
+            : tree_(e_node_allocation::arena), exploration_(exploration)
+        {
+            if (threads == 0)
+                threads = (std::max)(1u, std::thread::hardware_concurrency());
+            if (threads > 1)
+                pool_ = std::make_unique<task_pool>(threads - 1);
+            root_ = tree_.add_root(mcts_record(k_initial_board));
+        }
+
+        // Deleted copy constructor and assignment operator
+        mcts_engine(const mcts_engine&) = delete;
+        mcts_engine& operator=(const mcts_engine&) = delete;
+
+    public:
+        /**
+         * Gets the number of threads a search uses.
+         *
+         * @return The thread count.
+         */
+        std::size_t get_thread_count() const noexcept
+        {
+            return pool_ ? pool_->size() + 1 : 1;
+        }
+
+        /**
+         * Gets the search tree. The current position is get_root(), which
+         * may sit below the nodes of earlier positions.
+         *
+         * @return The tree.
+         */
+        const tree<mcts_record>& get_tree() const noexcept { return tree_; }
+
+        /**
+         * Gets the node of the current position.
+         *
+         * @return The node.
+         */
+        const node_type* get_root() const noexcept { return root_; }
+
+        /**
+         * Moves to a new position. A position one or two moves below the
+         * current one keeps its subtree; any other starts a new tree.
+         *
+         * @param board The position to search next.
+         * @return Whether the subtree of the position was kept.
+         */
+        bool set_position(const board_record& board)
+        {
+            if (board == root_->get_data().board) return true;
+            for (node_type* child : expanded_children(root_))
+            {
+                node_type* found = nullptr;
+                if (child->get_data().board == board)
+                    found = child;
+                else
+                {
+                    for (node_type* grandchild : expanded_children(child))
+                    {
+                        if (grandchild->get_data().board == board)
+                            found = grandchild;
+                    }
+                }
+                if (!found) continue;
+                if (found != child) keep_only(child, found);
+                keep_only(root_, child);
+                root_ = found;
+                return true;
+            }
+
+            tree_.prune_if([](const node_type*) { return true; });
+            root_ = tree_.add_root(mcts_record(board));
+            return false;
+        }
+
+        /**
+         * Runs playouts from the current position until a budget runs out.
+         * A zero budget is no limit; with neither set a single playout
+         * runs.
+         *
+         * @param budget The time after which the search stops.
+         * @param playouts The number of playouts after which it stops.
+         * @return The statistics of every move, in generation order.
+         */
+        std::vector<mcts_child> search(std::chrono::milliseconds budget,
+            std::uint64_t playouts)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + budget;
+            const bool timed = budget.count() > 0;
+            if (!timed && playouts == 0) playouts = 1;
+            std::atomic<std::uint64_t> started{ 0 };
+            std::atomic<bool> stop{ false };
+
+            auto run = [&](std::uint64_t seed, bool main) {
+                worker_state worker(seed);
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    if (playouts > 0 && started.fetch_add(1,
+                        std::memory_order_relaxed) >= playouts)
+                        break;
+                    playout(worker);
+                    if (main && timed &&
+                        std::chrono::steady_clock::now() >= deadline)
+                        stop.store(true, std::memory_order_relaxed);
+                }
+                if (main) stop.store(true, std::memory_order_relaxed);
+            };
+
+            std::atomic<std::size_t> running{ get_thread_count() - 1 };
+            for (std::size_t i = 1; i < get_thread_count(); ++i)
+            {
+                pool_->submit([&, i] {
+                    run(i, false);
+                    running.fetch_sub(1, std::memory_order_release);
+                });
+            }
+            run(0, true);
+            if (pool_)
+            {
+                pool_->wait_until([&] {
+                    return running.load(std::memory_order_acquire) == 0;
+                });
+            }
+            return get_root_children();
+        }
+
+        /**
+         * Gets the statistics of every move from the current position.
+         *
+         * @return One entry per move, in generation order; empty before the
+         * first search or when the game is over.
+         */
+        std::vector<mcts_child> get_root_children() const
+        {
+            std::vector<mcts_child> children;
+            for (const node_type* child : expanded_children(root_))
+            {
+                const mcts_record& data = child->get_data();
+                const std::uint32_t visits = data.visits.load(
+                    std::memory_order_relaxed);
+                children.push_back({ data.board, visits, visits == 0 ? 0.0 :
+                    data.score.load(std::memory_order_relaxed) /
+                    (2.0 * visits) });
+            }
+            return children;
+        }
+
+    private:
+        /** What a thread keeps between playouts. */
+        struct worker_state
+        {
+            explicit worker_state(std::uint64_t seed)
+                : random(0x9E3779B97F4A7C15ull * (seed + 1) ^
+                    static_cast<std::uint64_t>(std::chrono::steady_clock::
+                        now().time_since_epoch().count())) {}
+
+            /** State of the xorshift generator of the random moves. */
+            std::uint64_t random;
+
+            /** Nodes of the current playout, root first. */
+            std::vector<node_type*> path;
+
+            /** Moves of the position being played out. */
+            std::vector<board_record> moves;
+        };
+
+        /**
+         * Gets the children of a node once they are published.
+         */
+        static array_view<node_type* const> expanded_children(
+            const node_type* node) noexcept
+        {
+            if (node->get_data().state.load(std::memory_order_acquire) !=
+                mcts_record::k_expanded)
+                return {};
+            return node->get_children();
+        }
+
+        /**
+         * Removes every child of a node but one, handing the nodes back to
+         * the tree.
+         */
+        static void keep_only(node_type* node, const node_type* kept)
+        {
+            for (std::uint32_t i = static_cast<std::uint32_t>(
+                node->get_children().size()); i-- > 0;)
+            {
+                if (node->get_children()[i] != kept)
+                    node->remove_child_at(i);
+            }
+        }
+
+        /**
+         * Draws a random number below a bound.
+         */
+        static std::uint32_t draw(std::uint64_t& state, std::size_t bound)
+            noexcept
+        {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return static_cast<std::uint32_t>(
+                ((state * 0x2545F4914F6CDD1Dull) >> 32) % bound);
+        }
+
+        /**
+         * Picks the child with the best UCT value. Unvisited children come
+         * first.
+         */
+        node_type* select(const node_type* node) const
+        {
+            const auto children = node->get_children();
+            const double log_visits = std::log(static_cast<double>((std::max)(
+                node->get_data().visits.load(std::memory_order_relaxed),
+                1u)));
+            node_type* best = children[0];
+            double best_value = -1.0;
+            for (node_type* child : children)
+            {
+                const mcts_record& data = child->get_data();
+                const std::uint32_t visits = data.visits.load(
+                    std::memory_order_relaxed);
+                if (visits == 0) return child;
+                const double value = data.score.load(
+                    std::memory_order_relaxed) / (2.0 * visits) +
+                    exploration_ * std::sqrt(log_visits / visits);
+                if (value > best_value)
+                {
+                    best_value = value;
+                    best = child;
+                }
+            }
+            return best;
+        }
+
+        /**
+         * Adds the children of a node unless another thread is already
+         * doing it.
+         *
+         * @return Whether the node is expanded now.
+         */
+        bool expand(node_type* node)
+        {
+            const mcts_record& data = node->get_data();
+            std::uint8_t expected = mcts_record::k_unexpanded;
+            if (!data.state.compare_exchange_strong(expected,
+                mcts_record::k_expanding, std::memory_order_acquire))
+                return expected == mcts_record::k_expanded;
+            {
+                std::lock_guard<std::mutex> lock(expand_mutex_);
+                move_generator::for_each_move(data.board,
+                    [&](const board_record& child) {
+                        node->add_child(mcts_record(child));
+                    });
+            }
+            data.state.store(mcts_record::k_expanded,
+                std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Plays a game out with random moves.
+         *
+         * @return The side that won, 0 or 1, or 2 for a draw.
+         */
+        static std::uint32_t roll_out(board_record board,
+            worker_state& worker)
+        {
+            for (std::uint32_t ply = 0; ply < k_playout_plies; ++ply)
+            {
+                worker.moves.clear();
+                move_generator::generate(board, worker.moves);
+                if (worker.moves.empty()) return (board.side_to_move & 1) ^ 1;
+                board = worker.moves[draw(worker.random,
+                    worker.moves.size())];
+            }
+            return 2;
+        }
+
+        /**
+         * Runs one playout: selection, expansion, simulation and update.
+         */
+        void playout(worker_state& worker)
+        {
+            worker.path.clear();
+            node_type* node = root_;
+            node->get_data().visits.fetch_add(1, std::memory_order_relaxed);
+            worker.path.push_back(node);
+            for (;;)
+            {
+                const mcts_record& data = node->get_data();
+                const std::uint8_t state = data.state.load(
+                    std::memory_order_acquire);
+                if (state != mcts_record::k_expanded)
+                {
+                    // Leaves are expanded on their second visit, the root
+                    // at once.
+                    if (state == mcts_record::k_expanding ||
+                        (node != root_ && data.visits.load(
+                            std::memory_order_relaxed) < 2) ||
+                        !expand(node))
+                        break;
+                }
+                if (node->get_children().empty()) break;
+                node = select(node);
+                node->get_data().visits.fetch_add(1,
+                    std::memory_order_relaxed);
+                worker.path.push_back(node);
+            }
+
+            const std::uint32_t winner = roll_out(node->get_data().board,
+                worker);
+            for (node_type* visited : worker.path)
+            {
+                const mcts_record& data = visited->get_data();
+                const std::uint32_t mover = (data.board.side_to_move & 1) ^ 1;
+                const std::uint32_t points = winner == 2 ? 1 :
+                    winner == mover ? 2 : 0;
+                if (points)
+                    data.score.fetch_add(points, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        /** The search tree, reused across positions. */
+        tree<mcts_record> tree_;
+
+        /** The node of the current position. */
+        node_type* root_ = nullptr;
+
+        /** Serializes expansions, which share the allocator of the tree. */
+        std::mutex expand_mutex_;
+
+        /** Runs the helper threads; null for a single-threaded engine. */
+        std::unique_ptr<task_pool> pool_;
+
+        /** The UCT exploration constant. */
+        double exploration_;
+    };
+};
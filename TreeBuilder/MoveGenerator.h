@@ -0,0 +1,353 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "BoardRecord.h"
+#include "Tree.h"
+
+namespace tree_builder
+{
+    /**
+     * The starting position: the computer on rows 0 to 2, the player on
+     * rows 5 to 7 and the player to move.
+     */
+    constexpr board_record k_initial_board{ 0xFFF00000u, 0x00000FFFu, 0, 0 };
+
+    /**
+     * Neighbour tables of the dark squares. Directions 0 and 1 go up-left
+     * and up-right, towards row 0, and 2 and 3 down-left and down-right;
+     * missing squares are k_board_squares.
+     */
+    struct board_geometry
+    {
+        /** Square one step away in each direction. */
+        std::uint8_t step[k_board_squares][4];
+
+        /** Square two steps away in each direction, a jump landing. */
+        std::uint8_t jump[k_board_squares][4];
+    };
+
+    /**
+     * Computes the neighbour tables.
+     *
+     * @return The tables.
+     */
+    constexpr board_geometry make_board_geometry() noexcept
+    {
+        constexpr int k_rows[4] = { -1, -1, 1, 1 };
+        constexpr int k_columns[4] = { -1, 1, -1, 1 };
+        constexpr int k_width = static_cast<int>(k_board_width);
+        board_geometry result{};
+        for (std::uint32_t square = 0; square < k_board_squares; ++square)
+        {
+            const int row = static_cast<int>(square / 4);
+            const int column = static_cast<int>(square % 4) * 2 +
+                (row % 2 == 0 ? 1 : 0);
+            for (int d = 0; d < 4; ++d)
+            {
+                for (int distance = 1; distance <= 2; ++distance)
+                {
+                    const int r = row + k_rows[d] * distance;
+                    const int c = column + k_columns[d] * distance;
+                    const auto target = static_cast<std::uint8_t>(
+                        r < 0 || r >= k_width || c < 0 || c >= k_width ?
+                        k_board_squares : square_of(
+                            static_cast<std::uint32_t>(r),
+                            static_cast<std::uint32_t>(c)));
+                    if (distance == 1)
+                        result.step[square][d] = target;
+                    else
+                        result.jump[square][d] = target;
+                }
+            }
+        }
+        return result;
+    }
+
+    /** Neighbour tables, computed at compile time. */
+    constexpr board_geometry k_board_geometry = make_board_geometry();
+
+    /**
+     * Generates the legal checkers moves of a board_record straight on its
+     * bitboards. The rules are those of English draughts, which the Python
+     * front end follows: men step one square diagonally forward, the player
+     * towards row 0 and the computer towards row 7; kings step in all four
+     * diagonal directions; capturing is mandatory and a capture continues
+     * with further jumps as long as the same piece can jump, men jumping
+     * forward only; a man reaching the far row is crowned ('D' for the
+     * player, 'K' for the computer) and that ends the move.
+     *
+     * Every move is produced as the board it leads to, with the other side
+     * to move, so moves plug directly into a tree<board_record>. Capture
+     * sequences that take different routes are distinct moves even when
+     * they end on the same board.
+     */
+    class move_generator
+    {
+    public:
+        /**
+         * Calls a visitor with the board each legal move leads to.
+         *
+         * @param board The position to move from.
+         * @param visit Called as visit(const board_record&) once per move.
+         */
+        template<typename Visitor>
+        static void for_each_move(const board_record& board, Visitor&& visit)
+        {
+            const std::uint32_t side = board.side_to_move & 1;
+            const std::uint32_t own = side == 0 ? board.player :
+                board.computer;
+            const std::uint32_t enemy = side == 0 ? board.computer :
+                board.player;
+
+            bool captured = false;
+            for (std::uint32_t pieces = own; pieces; pieces &= pieces - 1)
+            {
+                const std::uint32_t square = lowest_square(pieces);
+                const std::uint32_t bit = std::uint32_t{ 1 } << square;
+                captured |= jump_from(square, (board.kings & bit) != 0, side,
+                    own & ~bit, enemy, board.kings & ~bit, visit);
+            }
+            if (captured) return;
+
+            const std::uint32_t empty = ~(own | enemy);
+            for (std::uint32_t pieces = own; pieces; pieces &= pieces - 1)
+            {
+                const std::uint32_t square = lowest_square(pieces);
+                const std::uint32_t bit = std::uint32_t{ 1 } << square;
+                const bool king = (board.kings & bit) != 0;
+                for (std::uint32_t d = first_direction(king, side);
+                    d < last_direction(king, side); ++d)
+                {
+                    const std::uint32_t target =
+                        k_board_geometry.step[square][d];
+                    if (target == k_board_squares ||
+                        !(empty & (std::uint32_t{ 1 } << target)))
+                        continue;
+                    const std::uint32_t to = std::uint32_t{ 1 } << target;
+                    const bool crowned = king || (to & promotion_row(side));
+                    visit(make_board(side, (own & ~bit) | to, enemy,
+                        (board.kings & ~bit) | (crowned ? to : 0)));
+                }
+            }
+        }
+
+        /**
+         * Appends the boards the legal moves lead to.
+         *
+         * @param board The position to move from.
+         * @param moves Receives one board per move.
+         * @return The number of moves.
+         */
+        static std::size_t generate(const board_record& board,
+            std::vector<board_record>& moves)
+        {
+            const std::size_t before = moves.size();
+            for_each_move(board, [&](const board_record& child) {
+                moves.push_back(child);
+            });
+            return moves.size() - before;
+        }
+
+        /**
+         * Counts the legal moves without producing the boards anywhere.
+         *
+         * @param board The position to move from.
+         * @return The number of moves.
+         */
+        static std::size_t count(const board_record& board)
+        {
+            std::size_t moves = 0;
+            for_each_move(board, [&](const board_record&) { ++moves; });
+            return moves;
+        }
+
+        /**
+         * Counts the move sequences of a given length, the standard check
+         * of a move generator. The last level is counted, not generated.
+         *
+         * @param board The position to start from.
+         * @param depth The number of moves in each sequence.
+         * @return The number of sequences, 1 at depth 0.
+         */
+        static std::uint64_t perft(const board_record& board,
+            std::uint32_t depth)
+        {
+            if (depth == 0) return 1;
+            if (depth == 1) return count(board);
+            std::uint64_t nodes = 0;
+            for_each_move(board, [&](const board_record& child) {
+                nodes += perft(child, depth - 1);
+            });
+            return nodes;
+        }
+
+        /**
+         * Adds one child per legal move to a node, in generation order.
+         * Suitable as the generator of a lazy tree<board_record>.
+         *
+         * @param node The node holding the position to move from.
+         * @return The number of children added.
+         */
+        static std::size_t add_moves(tree_node<board_record>* node)
+        {
+            std::size_t added = 0;
+            const board_record board = node->get_data();
+            for_each_move(board, [&](const board_record& child) {
+                node->add_child(child);
+                ++added;
+            });
+            return added;
+        }
+
+        /**
+         * Grows a tree by one level: every leaf gets one child per legal
+         * move of its position. Leaves without a legal move, finished
+         * games, stay leaves.
+         *
+         * @param target The tree to grow.
+         * @return The number of nodes added.
+         */
+        static std::size_t expand_leaves(tree<board_record>& target)
+        {
+            std::vector<tree_node<board_record>*> leaves;
+            std::vector<tree_node<board_record>*> stack;
+            for (tree_node<board_record>* root : target.get_roots())
+                stack.push_back(root);
+            while (!stack.empty())
+            {
+                tree_node<board_record>* node = stack.back();
+                stack.pop_back();
+                const auto children = node->get_children();
+                if (children.empty())
+                    leaves.push_back(node);
+                else
+                    stack.insert(stack.end(), children.begin(),
+                        children.end());
+            }
+
+            std::size_t added = 0;
+            for (tree_node<board_record>* leaf : leaves)
+                added += add_moves(leaf);
+            return added;
+        }
+
+    private:
+        /**
+         * Gets the first direction a piece may move in; men only go forward.
+         */
+        static constexpr std::uint32_t first_direction(bool king,
+            std::uint32_t side) noexcept
+        {
+            return king || side == 0 ? 0 : 2;
+        }
+
+        /**
+         * Gets one past the last direction a piece may move in.
+         */
+        static constexpr std::uint32_t last_direction(bool king,
+            std::uint32_t side) noexcept
+        {
+            return king || side == 1 ? 4 : 2;
+        }
+
+        /**
+         * Gets the squares where the men of a side are crowned.
+         */
+        static constexpr std::uint32_t promotion_row(std::uint32_t side)
+            noexcept
+        {
+            return side == 0 ? 0x0000000Fu : 0xF0000000u;
+        }
+
+        /**
+         * Gets the index of the lowest set bit, which must exist.
+         */
+        static std::uint32_t lowest_square(std::uint32_t bits) noexcept
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return static_cast<std::uint32_t>(__builtin_ctz(bits));
+#elif defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, bits);
+            return static_cast<std::uint32_t>(index);
+#else
+            std::uint32_t square = 0;
+            while (!(bits & 1))
+            {
+                bits >>= 1;
+                ++square;
+            }
+            return square;
+#endif
+        }
+
+        /**
+         * Builds the board after a move by the given side.
+         */
+        static constexpr board_record make_board(std::uint32_t side,
+            std::uint32_t own, std::uint32_t enemy, std::uint32_t kings)
+            noexcept
+        {
+            return side == 0 ? board_record{ own, enemy, kings, 1 } :
+                board_record{ enemy, own, kings, 0 };
+        }
+
+        /**
+         * Visits every capture sequence of a piece that has just arrived on
+         * a square, jumping again while it can. Captured pieces leave the
+         * board as they are jumped. The recursion is at most as deep as the
+         * number of enemy pieces.
+         *
+         * @param square Where the moving piece stands.
+         * @param king Whether the moving piece is a king.
+         * @param side The side moving.
+         * @param own The other pieces of the moving side.
+         * @param enemy The pieces of the other side still on the board.
+         * @param kings The kings of both sides, the moving piece excluded.
+         * @param visit Receives the board at the end of each sequence.
+         * @return Whether the piece could jump at all.
+         */
+        template<typename Visitor>
+        static bool jump_from(std::uint32_t square, bool king,
+            std::uint32_t side, std::uint32_t own, std::uint32_t enemy,
+            std::uint32_t kings, Visitor& visit)
+        {
+            const std::uint32_t occupied = own | enemy;
+            bool jumped = false;
+            for (std::uint32_t d = first_direction(king, side);
+                d < last_direction(king, side); ++d)
+            {
+                const std::uint32_t landing = k_board_geometry.jump[square][d];
+                if (landing == k_board_squares) continue;
+                const std::uint32_t over = std::uint32_t{ 1 } <<
+                    k_board_geometry.step[square][d];
+                const std::uint32_t to = std::uint32_t{ 1 } << landing;
+                if (!(enemy & over) || (occupied & to)) continue;
+
+                jumped = true;
+                const std::uint32_t remaining = enemy & ~over;
+                const std::uint32_t remaining_kings = kings & ~over;
+                if (!king && (to & promotion_row(side)))
+                {
+                    visit(make_board(side, own | to, remaining,
+                        remaining_kings | to));
+                    continue;
+                }
+                if (!jump_from(landing, king, side, own, remaining,
+                    remaining_kings, visit))
+                {
+                    visit(make_board(side, own | to, remaining,
+                        remaining_kings | (king ? to : 0)));
+                }
+            }
+            return jumped;
+        }
+    };
+};
@@ -0,0 +1,457 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "TreeBuilderData.h"
+#include "TreeStats.h"
+#include "Instrumentation.h"
+
+namespace tree_builder
+{
+    template<typename T>
+    class tree_node;
+
+    /**
+     * Storage policy for the nodes of a tree and for their child arrays.
+     * In heap mode every node and every child array is an individual heap
+     * allocation, as if they were created with new; destroyed nodes are
+     * kept on an intrusive free list for the next nodes instead of being
+     * freed, until release(). In arena mode both are carved out of
+     * contiguous blocks owned by the allocator: destroyed nodes and
+     * outgrown child arrays are threaded into intrusive free lists and
+     * reused, and the blocks are only handed back to the system by
+     * release(), which costs one free per block.
+     *
+     * An allocator belongs to a single tree, which makes it the place where
+     * the shape counters of that tree (see tree_counters), the bytes it
+     * holds and its orientation (see tree::is_mirrored) are tracked.
+     *
+     * @tparam T The type of data stored in each node.
+     */
+    template<typename T>
+    class node_allocator
+    {
+    public:
+        using node_type = tree_node<T>;
+
+        /**
+         * Constructs an allocator using the given storage policy.
+         *
+         * @param policy Where nodes and child arrays are allocated from.
+         * @param counted Whether to keep counters and recycle heap nodes; off
+         * for the shared heap allocator, which may be used from several
+         * threads at once.
+         */
+        explicit node_allocator(e_node_allocation policy =
+            e_node_allocation::heap, bool counted = true) noexcept
+            : policy_(policy), counted_(counted) {}
+
+        // Deleted copy constructor and assignment operator
+        node_allocator(const node_allocator&) = delete;
+        node_allocator& operator=(const node_allocator&) = delete;
+
+        // Destructor
+        ~node_allocator() { release(); }
+
+    public:
+        /**
+         * Returns the process-wide heap allocator. It is used by nodes that
+         * are constructed directly instead of through a tree.
+         *
+         * @return A reference to the shared heap allocator.
+         */
+        static node_allocator& heap() noexcept
+        {
+            static node_allocator instance(e_node_allocation::heap, false);
+            return instance;
+        }
+
+        /**
+         * Gets the storage policy of this allocator.
+         *
+         * @return The allocation policy.
+         */
+        e_node_allocation get_policy() const noexcept { return policy_; }
+
+        /**
+         * Gets the number of blocks currently owned by the allocator. Always
+         * zero in heap mode.
+         *
+         * @return The number of arena blocks.
+         */
+        std::size_t get_block_count() const noexcept { return blocks_.size(); }
+
+        /**
+         * Gets the shape counters of the nodes of this allocator.
+         *
+         * @return The counters.
+         */
+        const tree_counters& get_counters() const noexcept
+        {
+            return counters_;
+        }
+
+        /**
+         * Checks whether the tree owning the nodes is mirrored, in which case
+         * it presents every child array in reverse.
+         *
+         * @return True if the tree is mirrored.
+         */
+        bool is_mirrored() const noexcept { return mirrored_; }
+
+        /**
+         * Sets the orientation of the tree owning the nodes. Left alone by
+         * release(), like the policy.
+         *
+         * @param mirrored Whether the tree is mirrored.
+         */
+        void set_mirrored(bool mirrored) noexcept { mirrored_ = mirrored; }
+
+        /**
+         * Gets the number of bytes held for nodes and child arrays: the live
+         * and recycled allocations in heap mode, every block in arena mode.
+         * Memory owned by the node data itself is not included.
+         *
+         * @return The number of bytes.
+         */
+        std::size_t get_bytes() const noexcept { return bytes_; }
+
+        /**
+         * Counts a node that was just given its place in the tree.
+         *
+         * @param node The node, which has no children yet.
+         */
+        void count_added(const node_type* node)
+        {
+            if (counted_) counters_.node_added(node->depth_);
+        }
+
+        /**
+         * Counts a change in the number of children of a node.
+         *
+         * @param before The previous child count.
+         * @param after The new child count.
+         */
+        void count_children_changed(std::uint32_t before, std::uint32_t after)
+            noexcept
+        {
+            if (counted_) counters_.children_changed(before, after);
+        }
+
+        /**
+         * Creates a new node bound to this allocator.
+         *
+         * @param args The arguments forwarded to the node constructor.
+         * @return A pointer to the newly created node.
+         */
+        template<typename... Args>
+        node_type* create(Args&&... args)
+        {
+            TREE_BUILDER_INSTRUMENT(allocate_node);
+            void* slot = allocate_node_slot();
+            node_type* node;
+            try
+            {
+                node = ::new (slot) node_type(std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                free_node_slot(slot);
+                throw;
+            }
+            node->allocator_ = this;
+            return node;
+        }
+
+        /**
+         * Destroys a node together with its whole subtree.
+         *
+         * @param node The node to destroy. May be nullptr.
+         */
+        void destroy(node_type* node) noexcept
+        {
+            if (!node) return;
+            const std::uint32_t depth = node->depth_;
+            node->~node_type();
+            free_node_slot(node);
+            if (counted_) counters_.node_removed(depth);
+        }
+
+        /**
+         * Destroys several nodes together with their subtrees, handing heap
+         * nodes straight back to the system rather than recycling them, since
+         * this is how a whole tree is cleared.
+         *
+         * @param nodes The nodes to destroy.
+         */
+        template<typename Range>
+        void destroy_all(const Range& nodes) noexcept
+        {
+            recycle_ = false;
+            for (node_type* node : nodes)
+                destroy(node);
+            recycle_ = true;
+        }
+
+        /**
+         * Destroys every descendant of a node, leaving it without children.
+         * The walk follows parent pointers instead of recursing, so arbitrarily
+         * deep subtrees neither overflow the stack nor allocate.
+         *
+         * @param node The node whose descendants are destroyed.
+         */
+        void destroy_children(node_type* node) noexcept
+        {
+            node_type* current = node;
+            while (current != node || current->children_count_ > 0)
+            {
+                if (current->children_count_ > 0)
+                {
+                    const std::uint32_t count = current->children_count_--;
+                    count_children_changed(count, count - 1);
+                    current = current->children_[count - 1];
+                    continue;
+                }
+                node_type* parent = current->parent_;
+                current->allocator_->destroy(current);
+                current = parent;
+            }
+        }
+
+        /**
+         * Allocates an uninitialized array of child pointers.
+         *
+         * @param capacity The number of pointers, a power of two.
+         * @return A pointer to the first element of the array.
+         */
+        node_type** allocate_children(std::uint32_t capacity)
+        {
+            TREE_BUILDER_INSTRUMENT(allocate_children);
+            if (policy_ == e_node_allocation::heap)
+            {
+                node_type** array = new node_type*[capacity];
+                if (counted_) bytes_ += capacity * sizeof(node_type*);
+                return array;
+            }
+
+            const std::size_t size_class = size_class_of(capacity);
+            if (node_type** array = free_arrays_[size_class])
+            {
+                free_arrays_[size_class] = reinterpret_cast<node_type**>(
+                    array[0]);
+                return array;
+            }
+
+            if (capacity > k_array_block_size)
+            {
+                return static_cast<node_type**>(allocate_block(
+                    capacity * sizeof(node_type*)));
+            }
+
+            if (static_cast<std::size_t>(array_end_ - array_cursor_) <
+                capacity)
+            {
+                array_cursor_ = static_cast<node_type**>(allocate_block(
+                    k_array_block_size * sizeof(node_type*)));
+                array_end_ = array_cursor_ + k_array_block_size;
+            }
+            node_type** array = array_cursor_;
+            array_cursor_ += capacity;
+            return array;
+        }
+
+        /**
+         * Gives back an array obtained from allocate_children.
+         *
+         * @param array The array to release. May be nullptr.
+         * @param capacity The capacity the array was allocated with.
+         */
+        void release_children(node_type** array, std::uint32_t capacity)
+            noexcept
+        {
+            if (!array) return;
+            if (policy_ == e_node_allocation::heap)
+            {
+                delete[] array;
+                if (counted_) bytes_ -= capacity * sizeof(node_type*);
+                return;
+            }
+            const std::size_t size_class = size_class_of(capacity);
+            array[0] = reinterpret_cast<node_type*>(free_arrays_[size_class]);
+            free_arrays_[size_class] = array;
+        }
+
+        /**
+         * Returns every arena block to the system at once. Nodes still living
+         * in those blocks are not destroyed, so the caller must either have
+         * destroyed them already or know that skipping their destructors is
+         * harmless. Resets the counters, since no node is left. In heap mode
+         * it frees the recycled nodes instead.
+         */
+        void release() noexcept
+        {
+            if (policy_ == e_node_allocation::heap)
+            {
+                while (free_nodes_)
+                {
+                    free_slot* slot = free_nodes_;
+                    free_nodes_ = slot->next;
+                    slot->~free_slot();
+                    ::operator delete(slot);
+                    bytes_ -= sizeof(node_type);
+                }
+            }
+            else
+            {
+                bytes_ = 0;
+            }
+            counters_.reset();
+            for (void* block : blocks_)
+                ::operator delete(block);
+            blocks_.clear();
+            free_nodes_ = nullptr;
+            for (auto& list : free_arrays_)
+                list = nullptr;
+            node_cursor_ = node_end_ = nullptr;
+            array_cursor_ = array_end_ = nullptr;
+            next_node_block_ = k_first_node_block;
+        }
+
+    private:
+        /** Number of nodes in the first arena block. */
+        static constexpr std::size_t k_first_node_block = 64;
+
+        /** Upper bound for the number of nodes in a single arena block. */
+        static constexpr std::size_t k_max_node_block = 64 * 1024;
+
+        /** Number of child pointers in a shared array block. */
+        static constexpr std::uint32_t k_array_block_size = 4096;
+
+        /** Number of power-of-two size classes for child arrays. */
+        static constexpr std::size_t k_size_classes = 32;
+
+        /** Overlay used to chain free node slots together. */
+        struct free_slot { free_slot* next; };
+
+        /**
+         * Maps a power-of-two capacity to its free list index.
+         */
+        static std::size_t size_class_of(std::uint32_t capacity) noexcept
+        {
+            std::size_t size_class = 0;
+            while ((std::uint32_t{1} << size_class) < capacity)
+                ++size_class;
+            return size_class;
+        }
+
+        /**
+         * Allocates a raw block of memory and records it for release().
+         */
+        void* allocate_block(std::size_t bytes)
+        {
+            blocks_.reserve(blocks_.size() + 1);
+            void* block = ::operator new(bytes);
+            blocks_.push_back(block);
+            if (counted_) bytes_ += bytes;
+            return block;
+        }
+
+        /**
+         * Returns storage for one node, reusing a free slot when possible.
+         * Arena blocks grow geometrically so small trees stay small.
+         */
+        void* allocate_node_slot()
+        {
+            static_assert(sizeof(node_type) >= sizeof(free_slot),
+                "node slots must be able to hold a free list link");
+            static_assert(alignof(node_type) <=
+                __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                "over-aligned payloads are not supported");
+
+            if (free_nodes_)
+            {
+                void* slot = free_nodes_;
+                free_nodes_ = free_nodes_->next;
+                return slot;
+            }
+            if (policy_ == e_node_allocation::heap)
+            {
+                void* slot = ::operator new(sizeof(node_type));
+                if (counted_) bytes_ += sizeof(node_type);
+                return slot;
+            }
+            if (node_cursor_ == node_end_)
+            {
+                const std::size_t bytes = next_node_block_ * sizeof(node_type);
+                node_cursor_ = static_cast<unsigned char*>(
+                    allocate_block(bytes));
+                node_end_ = node_cursor_ + bytes;
+                if (next_node_block_ < k_max_node_block)
+                    next_node_block_ *= 2;
+            }
+            void* slot = node_cursor_;
+            node_cursor_ += sizeof(node_type);
+            return slot;
+        }
+
+        /**
+         * Pushes a node slot onto the free list. Heap slots are freed at once
+         * instead for the shared heap allocator and within destroy_all().
+         */
+        void free_node_slot(void* slot) noexcept
+        {
+            if (policy_ == e_node_allocation::heap && !(counted_ && recycle_))
+            {
+                ::operator delete(slot);
+                if (counted_) bytes_ -= sizeof(node_type);
+            }
+            else
+            {
+                free_nodes_ = ::new (slot) free_slot{ free_nodes_ };
+            }
+        }
+
+    private:
+        /** Where nodes and child arrays are allocated from. */
+        e_node_allocation policy_;
+
+        /** Every block owned by the arena. */
+        std::vector<void*> blocks_;
+
+        /** Head of the list of destroyed node slots, in either mode. */
+        free_slot* free_nodes_ = nullptr;
+
+        /** Heads of the lists of released child arrays, per size class. */
+        node_type** free_arrays_[k_size_classes] = {};
+
+        /** Bump pointer range of the current node block. */
+        unsigned char* node_cursor_ = nullptr;
+        unsigned char* node_end_ = nullptr;
+
+        /** Bump pointer range of the current child array block. */
+        node_type** array_cursor_ = nullptr;
+        node_type** array_end_ = nullptr;
+
+        /** Number of nodes in the next node block. */
+        std::size_t next_node_block_ = k_first_node_block;
+
+        /** Whether counters_ and bytes_ are kept up to date. */
+        bool counted_;
+
+        /** Whether the tree owning the nodes is mirrored. */
+        bool mirrored_ = false;
+
+        /** Whether destroyed heap nodes go to the free list. */
+        bool recycle_ = true;
+
+        /** Shape counters of the nodes created here. */
+        tree_counters counters_;
+
+        /** Bytes held for nodes and child arrays. */
+        std::size_t bytes_ = 0;
+    };
+};
@@ -0,0 +1,114 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "MoveGenerator.h"
+#include "Tree.h"
+
+using namespace tree_builder;
+
+namespace
+{
+    /**
+     * Published perft counts of English draughts from the starting
+     * position, indexed by depth.
+     */
+    constexpr std::uint64_t k_expected_nodes[] = {
+        1, 7, 49, 302, 1469, 7361, 36768, 179740, 845931, 3963680,
+        18391564, 85242128, 388623673
+    };
+
+    constexpr std::uint32_t k_known_depths =
+        sizeof(k_expected_nodes) / sizeof(k_expected_nodes[0]);
+
+    /**
+     * Times a callable.
+     *
+     * @param work The code to time.
+     * @return The elapsed time in seconds.
+     */
+    template<typename Work>
+    double time_s(Work&& work)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        work();
+        const auto stop = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(stop - start).count();
+    }
+
+    /**
+     * Prints one result line and checks it against the published count.
+     *
+     * @return Whether the count is right, or unknown.
+     */
+    bool report(const char* mode, std::uint32_t depth, std::uint64_t nodes,
+        double seconds)
+    {
+        const bool known = depth < k_known_depths;
+        const bool correct = !known || nodes == k_expected_nodes[depth];
+        std::printf("%-6s depth %2u  nodes %12llu  %9.3f s  %10.2f Mnps  %s\n",
+            mode, depth, static_cast<unsigned long long>(nodes), seconds,
+            seconds > 0 ? static_cast<double>(nodes) / seconds / 1e6 : 0.0,
+            !known ? "unknown" : correct ? "ok" : "MISMATCH");
+        return correct;
+    }
+
+    void print_usage(const char* program)
+    {
+        std::fprintf(stderr,
+            "usage: %s [--depth N] [--tree-depth N]\n"
+            "  --depth       deepest perft run on the move generator"
+            " (default 9)\n"
+            "  --tree-depth  deepest level built as a tree<board_record>"
+            " (default 6, 0 to skip)\n", program);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::uint32_t depth = 9;
+    std::uint32_t tree_depth = 6;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--depth") == 0 && has_value)
+            depth = static_cast<std::uint32_t>(
+                std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--tree-depth") == 0 && has_value)
+            tree_depth = static_cast<std::uint32_t>(
+                std::strtoul(argv[++i], nullptr, 10));
+        else
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    bool correct = true;
+    for (std::uint32_t d = 1; d <= depth; ++d)
+    {
+        std::uint64_t nodes = 0;
+        const double seconds = time_s([&] {
+            nodes = move_generator::perft(k_initial_board, d);
+        });
+        correct &= report("perft", d, nodes, seconds);
+    }
+
+    // Grows a real tree level by level; the new leaves of each level are
+    // the perft count of its depth.
+    tree<board_record> game_tree(e_node_allocation::arena);
+    game_tree.add_root(k_initial_board);
+    for (std::uint32_t d = 1; d <= tree_depth; ++d)
+    {
+        std::size_t added = 0;
+        const double seconds = time_s([&] {
+            added = move_generator::expand_leaves(game_tree);
+        });
+        correct &= report("tree", d, added, seconds);
+    }
+
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,519 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "TreeBuilderData.h"
+#include "ArrayView.h"
+#include "CompactTree.h"
+#include "KeySort.h"
+
+namespace tree_builder
+{
+    /**
+     * An immutable node of a persistent_tree. Once published a node never
+     * changes, so any number of versions can share it and any thread can
+     * read it without synchronization. Nodes are reference counted and a
+     * node lives as long as some version reaches it.
+     *
+     * @tparam T The type of data stored in each node.
+     */
+    template<typename T>
+    class persistent_node
+    {
+    public:
+        using pointer = std::shared_ptr<const persistent_node>;
+
+        // Constructors
+        persistent_node(T data, std::vector<pointer> children)
+            : data_(std::move(data)), children_(std::move(children)) {}
+
+        // Deleted copy constructor and assignment operator
+        persistent_node(const persistent_node&) = delete;
+        persistent_node& operator=(const persistent_node&) = delete;
+
+        /**
+         * Releases the children without recursing once per level of a deep
+         * chain. The outermost node being destroyed on a thread releases
+         * its children one at a time from an explicit stack; a node whose
+         * destruction that triggers hands its own children over to the same
+         * stack. Only the children of nodes whose last reference is gone
+         * are touched, so versions may be dropped from any thread at once.
+         */
+        ~persistent_node()
+        {
+            thread_local std::vector<pointer>* pending = nullptr;
+            if (pending)
+            {
+                for (auto& child : children_)
+                    pending->push_back(std::move(child));
+                return;
+            }
+
+            std::vector<pointer> stack = std::move(children_);
+            pending = &stack;
+            while (!stack.empty())
+            {
+                pointer child = std::move(stack.back());
+                stack.pop_back();
+                child.reset();
+            }
+            pending = nullptr;
+        }
+
+    public:
+        /**
+         * Gets the data stored in this node.
+         *
+         * @return Const reference to the data.
+         */
+        const T& get_data() const noexcept { return data_; }
+
+        /**
+         * Retrieves the children in the order they are stored, which is the
+         * order of the tree unless it is mirrored.
+         *
+         * @return A range over the children.
+         */
+        array_view<const pointer> get_children() const noexcept
+        {
+            return { children_.data(), children_.size() };
+        }
+
+        /**
+         * Gets the number of children.
+         *
+         * @return The child count.
+         */
+        std::size_t get_children_count() const noexcept
+        {
+            return children_.size();
+        }
+
+    private:
+        template<typename> friend class persistent_tree;
+
+        /** Data stored in the node. */
+        T data_;
+
+        /** Children of the node. */
+        std::vector<pointer> children_;
+    };
+
+    /**
+     * One version of a persistent tree. Versions are immutable values:
+     * every change returns a new version and leaves the old one as it was,
+     * readable for as long as someone holds it. A change copies only the
+     * nodes on the path from a root down to the changed node and shares
+     * every other subtree with the old version, so keeping the view before a
+     * change costs O(depth) nodes instead of a deep copy.
+     *
+     * Copying a version is O(1) and the copy may be handed to another
+     * thread: nodes are never modified after they are published and their
+     * reference counts are atomic, so readers of any version need no lock
+     * and never block the writer producing the next one.
+     *
+     * Nodes have no parent pointer, since a shared node has a different
+     * parent in every version. They are addressed by a location instead:
+     * the index of the root followed by the index of the child at each
+     * level, seen through the orientation of the version.
+     *
+     * @tparam T The type of data stored in each node.
+     */
+    template<typename T>
+    class persistent_tree
+    {
+    public:
+        using node_type = persistent_node<T>;
+        using node_pointer = typename node_type::pointer;
+
+        /** Where a node is: a root index, then one child index per level. */
+        using location = array_view<const std::uint32_t>;
+
+        /** Constructs an empty version. */
+        persistent_tree() = default;
+
+    public:
+        /**
+         * Gets the number of nodes of this version.
+         *
+         * @return The node count.
+         */
+        std::size_t size() const noexcept { return size_; }
+
+        /**
+         * Checks whether this version has no nodes.
+         *
+         * @return True if there is no root.
+         */
+        bool empty() const noexcept { return size_ == 0; }
+
+        /**
+         * Retrieves the roots, in the order they were added.
+         *
+         * @return A range over the roots.
+         */
+        array_view<const node_pointer> get_roots() const noexcept
+        {
+            if (!roots_) return {};
+            return { roots_->data(), roots_->size() };
+        }
+
+        /**
+         * Checks whether this version is mirrored, i.e. whether its
+         * traversals present each node's children in reverse.
+         *
+         * @return True if the version is mirrored.
+         */
+        bool is_mirrored() const noexcept { return mirrored_; }
+
+        /**
+         * Gets a child of a node as seen through the orientation of this
+         * version.
+         *
+         * @param node A node of this version.
+         * @param index The position of the child in the orientation.
+         * @return The child, or nullptr if index is out of range.
+         */
+        const node_type* get_child(const node_type* node, std::size_t index)
+            const noexcept
+        {
+            const auto& children = node->children_;
+            if (index >= children.size()) return nullptr;
+            return children[physical_index(children.size(), index)].get();
+        }
+
+        /**
+         * Finds the node at a location.
+         *
+         * @param at The location of the node.
+         * @return The node, or nullptr if there is none at that location.
+         */
+        const node_type* find(location at) const noexcept
+        {
+            if (at.empty() || at[0] >= get_roots().size()) return nullptr;
+            const node_type* node = (*roots_)[at[0]].get();
+            for (std::size_t i = 1; i < at.size() && node; ++i)
+                node = get_child(node, at[i]);
+            return node;
+        }
+
+        /**
+         * Returns a version with a new root after the existing ones.
+         *
+         * @param data The data of the root.
+         * @return The new version.
+         */
+        persistent_tree add_root(T data) const
+        {
+            auto roots = std::make_shared<std::vector<node_pointer>>();
+            if (roots_) *roots = *roots_;
+            roots->push_back(std::make_shared<node_type>(
+                std::move(data), std::vector<node_pointer>()));
+            return persistent_tree(std::move(roots), size_ + 1, mirrored_);
+        }
+
+        /**
+         * Returns a version in which a node has a new last child, as seen
+         * through the orientation of the version.
+         *
+         * @param at The location of the parent.
+         * @param data The data of the child.
+         * @return The new version, or this one if nothing is at that
+         * location.
+         */
+        persistent_tree add_child(location at, T data) const
+        {
+            return replace(at, 1, [&](const node_type& node) {
+                std::vector<node_pointer> children;
+                children.reserve(node.children_.size() + 1);
+                auto child = std::make_shared<node_type>(
+                    std::move(data), std::vector<node_pointer>());
+                if (mirrored_) children.push_back(std::move(child));
+                children.insert(children.end(), node.children_.begin(),
+                    node.children_.end());
+                if (!mirrored_) children.push_back(std::move(child));
+                return std::make_shared<node_type>(node.data_,
+                    std::move(children));
+            });
+        }
+
+        /**
+         * Returns a version in which a node holds other data.
+         *
+         * @param at The location of the node.
+         * @param data The new data.
+         * @return The new version, or this one if nothing is at that
+         * location.
+         */
+        persistent_tree set_data(location at, T data) const
+        {
+            return replace(at, 0, [&](const node_type& node) {
+                return std::make_shared<node_type>(std::move(data),
+                    node.children_);
+            });
+        }
+
+        /**
+         * Returns a version without a node and its subtree. Counting the
+         * removed nodes walks the subtree, which is otherwise kept intact
+         * for the versions that still share it.
+         *
+         * @param at The location of the node.
+         * @return The new version, or this one if nothing is at that
+         * location.
+         */
+        persistent_tree remove(location at) const
+        {
+            const node_type* target = find(at);
+            if (!target) return *this;
+            std::size_t removed = 0;
+            std::vector<const node_type*> stack{ target };
+            while (!stack.empty())
+            {
+                const node_type* node = stack.back();
+                stack.pop_back();
+                ++removed;
+                for (const auto& child : node->children_)
+                    stack.push_back(child.get());
+            }
+            return replace(at, -static_cast<std::ptrdiff_t>(removed),
+                [](const node_type&) { return node_pointer(); });
+        }
+
+        /**
+         * Returns a transformed version, with the same meaning as
+         * tree::translate. Mirroring only flips the orientation and shares
+         * every node. Sorting copies a node only when its children change
+         * order or one of its children was copied, so subtrees that are
+         * already sorted stay shared. Sorting is stable with respect to the
+         * current (possibly mirrored) order of the children.
+         *
+         * @param type The transformation operation to apply on each node.
+         * @return The new version.
+         */
+        persistent_tree translate(const e_type_of_tree_translation type) const
+        {
+            if (type == e_type_of_tree_translation::mirror)
+                return persistent_tree(roots_, size_, !mirrored_);
+            if (!roots_) return *this;
+
+            // Under a mirror a stable descending sort of the stored children
+            // is a stable ascending sort of the mirrored view.
+            const bool descending = (type ==
+                e_type_of_tree_translation::sort_ascending) == mirrored_;
+            auto key_of = [](const node_pointer& node) -> const T& {
+                return node->data_;
+            };
+            std::less<> less;
+            auto in_order = [&](const node_pointer& a, const node_pointer& b) {
+                return descending ? less(b->data_, a->data_) :
+                    less(a->data_, b->data_);
+            };
+
+            // Post-order over the stored children: a node comes up once
+            // every child left its (possibly new) pointer on results.
+            auto roots = std::make_shared<std::vector<node_pointer>>();
+            std::vector<std::pair<const node_pointer*, std::size_t>> stack;
+            std::vector<node_pointer> results;
+            for (const node_pointer& root : *roots_)
+            {
+                stack.emplace_back(&root, 0);
+                while (!stack.empty())
+                {
+                    auto& [node, next] = stack.back();
+                    const auto& children = (*node)->children_;
+                    if (next < children.size())
+                    {
+                        stack.emplace_back(&children[next++], 0);
+                        continue;
+                    }
+
+                    const auto first = results.end() -
+                        static_cast<std::ptrdiff_t>(children.size());
+                    bool changed = !std::equal(first, results.end(),
+                        children.begin());
+                    if (!std::is_sorted(first, results.end(), in_order))
+                    {
+                        sort_by_key(&*first, &*first + children.size(),
+                            key_of, less, descending);
+                        changed = true;
+                    }
+                    node_pointer result = *node;
+                    if (changed)
+                    {
+                        result = std::make_shared<node_type>(
+                            (*node)->data_, std::vector<node_pointer>(
+                                std::make_move_iterator(first),
+                                std::make_move_iterator(results.end())));
+                    }
+                    results.erase(first, results.end());
+                    results.push_back(std::move(result));
+                    stack.pop_back();
+                }
+                roots->push_back(std::move(results.back()));
+                results.pop_back();
+            }
+            return persistent_tree(std::move(roots), size_, mirrored_);
+        }
+
+        /**
+         * Traverses this version. Supports the same orders as tree::path and
+         * visits the nodes in the same sequence a tree with the same shape
+         * and orientation would.
+         *
+         * @param type The type of traversal path to use.
+         * @return The nodes in traversal order. They stay valid as long as
+         * this version, or another one sharing them, is alive.
+         */
+        std::vector<const node_type*> path(e_type_of_path_on_tree type) const
+        {
+            // Numbers the nodes in pre-order into CSR arrays, which csr_path
+            // then walks in any order.
+            std::vector<const node_type*> nodes;
+            nodes.reserve(size_);
+            std::vector<std::uint32_t> child_offsets{ 0 };
+            child_offsets.reserve(size_ + 1);
+            std::vector<std::uint32_t> children;
+            children.reserve(size_);
+            std::vector<std::uint32_t> roots;
+
+            std::vector<const node_type*> stack;
+            for (const node_pointer& root : get_roots())
+            {
+                stack.push_back(root.get());
+                while (!stack.empty())
+                {
+                    const node_type* node = stack.back();
+                    stack.pop_back();
+                    if (node == root.get())
+                        roots.push_back(static_cast<std::uint32_t>(
+                            nodes.size()));
+                    nodes.push_back(node);
+                    const std::size_t count = node->children_.size();
+                    for (std::size_t i = count; i-- > 0;)
+                        stack.push_back(get_child(node, i));
+                }
+            }
+
+            // A node's children follow its subtree's first node, so their
+            // indices come from the subtree sizes, walked backwards.
+            std::vector<std::uint32_t> subtree(nodes.size(), 1);
+            for (std::size_t i = nodes.size(); i-- > 0;)
+            {
+                std::uint32_t next = static_cast<std::uint32_t>(i) + 1;
+                for (std::size_t c = 0; c < nodes[i]->children_.size(); ++c)
+                {
+                    subtree[i] += subtree[next];
+                    next += subtree[next];
+                }
+            }
+            for (std::size_t i = 0; i < nodes.size(); ++i)
+            {
+                std::uint32_t next = static_cast<std::uint32_t>(i) + 1;
+                for (std::size_t c = 0; c < nodes[i]->children_.size(); ++c)
+                {
+                    children.push_back(next);
+                    next += subtree[next];
+                }
+                child_offsets.push_back(static_cast<std::uint32_t>(
+                    children.size()));
+            }
+
+            std::vector<const node_type*> result;
+            result.reserve(nodes.size());
+            for (const std::uint32_t index : csr_path(nodes.size(),
+                { roots.data(), roots.size() }, child_offsets.data(),
+                children.data(), type))
+                result.push_back(nodes[index]);
+            return result;
+        }
+
+    private:
+        // Constructors
+        persistent_tree(std::shared_ptr<const std::vector<node_pointer>> roots,
+            std::size_t size, bool mirrored) noexcept
+            : roots_(std::move(roots)), size_(size), mirrored_(mirrored) {}
+
+        /**
+         * Maps a position in the orientation of this version to the index
+         * the child is stored at.
+         */
+        std::size_t physical_index(std::size_t count, std::size_t index)
+            const noexcept
+        {
+            return mirrored_ ? count - 1 - index : index;
+        }
+
+        /**
+         * Returns a version in which the node at a location is replaced,
+         * copying every node on the way down to it.
+         *
+         * @param at The location of the node.
+         * @param added The change in the number of nodes.
+         * @param rebuild Makes the replacement from the old node, or returns
+         * nullptr to drop the node.
+         * @return The new version, or this one if nothing is at that
+         * location.
+         */
+        template<typename Rebuild>
+        persistent_tree replace(location at, std::ptrdiff_t added,
+            Rebuild rebuild) const
+        {
+            if (!find(at)) return *this;
+
+            // Stored index of each step below the root, and the node it
+            // starts from.
+            std::vector<const node_type*> parents;
+            std::vector<std::size_t> indices;
+            parents.reserve(at.size() - 1);
+            indices.reserve(at.size() - 1);
+            const node_type* node = (*roots_)[at[0]].get();
+            for (std::size_t i = 1; i < at.size(); ++i)
+            {
+                parents.push_back(node);
+                indices.push_back(physical_index(node->children_.size(),
+                    at[i]));
+                node = node->children_[indices.back()].get();
+            }
+
+            node_pointer current = rebuild(*node);
+            for (std::size_t i = parents.size(); i-- > 0;)
+            {
+                std::vector<node_pointer> children = parents[i]->children_;
+                const auto position = children.begin() +
+                    static_cast<std::ptrdiff_t>(indices[i]);
+                if (current)
+                    *position = std::move(current);
+                else
+                    children.erase(position);
+                current = std::make_shared<node_type>(parents[i]->data_,
+                    std::move(children));
+            }
+
+            auto roots = std::make_shared<std::vector<node_pointer>>(*roots_);
+            const auto position = roots->begin() + at[0];
+            if (current)
+                *position = std::move(current);
+            else
+                roots->erase(position);
+            return persistent_tree(std::move(roots), static_cast<std::size_t>(
+                static_cast<std::ptrdiff_t>(size_) + added), mirrored_);
+        }
+
+    private:
+        /** Roots of this version, shared with versions that kept them. */
+        std::shared_ptr<const std::vector<node_pointer>> roots_;
+
+        /** Number of nodes of this version. */
+        std::size_t size_ = 0;
+
+        /** Whether the children are presented in reverse. */
+        bool mirrored_ = false;
+    };
+};
@@ -0,0 +1,685 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "BoardRecord.h"
+#include "MoveGenerator.h"
+#include "Tablebase.h"
+#include "TaskPool.h"
+#include "Tree.h"
+#include "TreeBuilderData.h"
+#include "Zobrist.h"
+
+namespace tree_builder
+{
+    /** Score of a won position; wins found sooner score higher. */
+    constexpr int k_win_score = 30000;
+
+    /** Deepest ply a search reaches, capture extensions included. */
+    constexpr std::uint32_t k_max_search_ply = 128;
+
+    /** Marks the absence of a move in the transposition table. */
+    constexpr std::uint8_t k_no_move = 0xFF;
+
+    /**
+     * What the transposition table knows about a position.
+     */
+    struct transposition_entry
+    {
+        /** Score from the side to move, relative to this position. */
+        int score;
+
+        /** Remaining depth the score was searched to. */
+        std::uint32_t depth;
+
+        /** How the score bounds the value of the position. */
+        e_search_bound bound;
+
+        /** Generation index of the best move found, or k_no_move. */
+        std::uint8_t move;
+    };
+
+    /**
+     * A fixed-size hash table of search results shared by every search
+     * thread without locks. Each slot holds the packed entry and the
+     * position key XORed with it, both written with relaxed atomics; a read
+     * that races with a write sees a key that no longer matches and is
+     * treated as a miss, so a torn entry is never used.
+     */
+    class transposition_table
+    {
+    public:
+        /**
+         * Allocates the table.
+         *
+         * @param bytes The memory to use; rounded down to a power of two
+         * number of slots, at least one.
+         */
+        explicit transposition_table(std::size_t bytes)
+        {
+            std::size_t count = 1;
+            while (count * 2 * sizeof(slot) <= bytes)
+                count *= 2;
+            slots_ = std::make_unique<slot[]>(count);
+            mask_ = count - 1;
+        }
+
+        // Deleted copy constructor and assignment operator
+        transposition_table(const transposition_table&) = delete;
+        transposition_table& operator=(const transposition_table&) = delete;
+
+    public:
+        /**
+         * Gets the number of slots.
+         *
+         * @return The slot count.
+         */
+        std::size_t size() const noexcept { return mask_ + 1; }
+
+        /**
+         * Looks a position up.
+         *
+         * @param key The Zobrist hash of the position.
+         * @param entry Receives the entry when there is one.
+         * @return Whether the position was found.
+         */
+        bool probe(std::uint64_t key, transposition_entry& entry) const
+            noexcept
+        {
+            const slot& target = slots_[key & mask_];
+            const std::uint64_t data = target.data.load(
+                std::memory_order_relaxed);
+            const std::uint64_t check = target.check.load(
+                std::memory_order_relaxed);
+            if (!(data & k_valid) || (check ^ data) != key) return false;
+            entry.score = static_cast<std::int16_t>(data & 0xFFFF);
+            entry.depth = static_cast<std::uint32_t>((data >> 16) & 0xFF);
+            entry.bound = static_cast<e_search_bound>((data >> 24) & 0x3);
+            entry.move = static_cast<std::uint8_t>((data >> 32) & 0xFF);
+            return true;
+        }
+
+        /**
+         * Stores a search result. An entry of the current search that was
+         * searched deeper for another position is kept instead.
+         *
+         * @param key The Zobrist hash of the position.
+         * @param entry What was found.
+         */
+        void store(std::uint64_t key, const transposition_entry& entry)
+            noexcept
+        {
+            slot& target = slots_[key & mask_];
+            const std::uint64_t old = target.data.load(
+                std::memory_order_relaxed);
+            const std::uint64_t old_key = target.check.load(
+                std::memory_order_relaxed) ^ old;
+            const std::uint8_t generation = generation_.load(
+                std::memory_order_relaxed);
+            if ((old & k_valid) && old_key != key &&
+                ((old >> 40) & 0xFF) == generation &&
+                ((old >> 16) & 0xFF) > entry.depth + 2)
+                return;
+
+            const std::uint64_t data = k_valid |
+                static_cast<std::uint64_t>(generation) << 40 |
+                static_cast<std::uint64_t>(entry.move) << 32 |
+                static_cast<std::uint64_t>(entry.bound) << 24 |
+                static_cast<std::uint64_t>((std::min)(entry.depth, 255u))
+                << 16 |
+                static_cast<std::uint16_t>(entry.score);
+            target.check.store(key ^ data, std::memory_order_relaxed);
+            target.data.store(data, std::memory_order_relaxed);
+        }
+
+        /**
+         * Starts a new search, which makes the entries of the earlier ones
+         * the first to be replaced.
+         */
+        void new_search() noexcept
+        {
+            generation_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * Forgets every entry. Must not run during a search.
+         */
+        void clear() noexcept
+        {
+            for (std::size_t i = 0; i <= mask_; ++i)
+            {
+                slots_[i].check.store(0, std::memory_order_relaxed);
+                slots_[i].data.store(0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        /** Set in the data of every stored entry. */
+        static constexpr std::uint64_t k_valid = std::uint64_t{ 1 } << 63;
+
+        /** A packed entry and its key check. */
+        struct slot
+        {
+            std::atomic<std::uint64_t> check{ 0 };
+            std::atomic<std::uint64_t> data{ 0 };
+        };
+
+        /** The slots; a position goes to the slot its key selects. */
+        std::unique_ptr<slot[]> slots_;
+
+        /** Number of slots minus one. */
+        std::size_t mask_ = 0;
+
+        /** Index of the current search, wrapping around. */
+        std::atomic<std::uint8_t> generation_{ 0 };
+    };
+
+    /**
+     * The outcome of a search.
+     */
+    struct search_result
+    {
+        /** Whether the side to move had a legal move. */
+        bool has_move = false;
+
+        /** The board after the chosen move. */
+        board_record best_move{};
+
+        /** Score of the chosen move for the side to move; a man is 100. */
+        int score = 0;
+
+        /** Deepest iteration the main thread completed. */
+        std::uint32_t depth = 0;
+
+        /** Positions visited by every thread together. */
+        std::uint64_t nodes = 0;
+
+        /** The expected line of play, starting with best_move. */
+        std::vector<board_record> principal_variation;
+    };
+
+    /**
+     * An iterative-deepening alpha-beta search of checkers positions, on
+     * top of move_generator. Several threads search the same position at
+     * once and share their results through a transposition_table keyed by
+     * incrementally updated Zobrist hashes (Lazy SMP); helper threads start
+     * one ply deeper every other thread, so they fill the table ahead of the
+     * main thread, whose result is the one returned.
+     *
+     * Within a node the move stored in the table is tried first, then the
+     * others by the static evaluation of the board they lead to. Captures,
+     * which are forced, are searched past the nominal depth, so the static
+     * evaluation is only ever applied to quiet positions. Positions an
+     * endgame tablebase covers, when one is set, are scored from it instead
+     * of searched.
+     */
+    class search_engine
+    {
+    public:
+        /** Default size of the transposition table. */
+        static constexpr std::size_t k_default_table_bytes = 64u << 20;
+
+        /**
+         * Constructs an engine.
+         *
+         * @param table_bytes The memory of the transposition table.
+         * @param threads The number of search threads; 0 picks one per
+         * hardware thread.
+         */
+        explicit search_engine(std::size_t table_bytes =
+            k_default_table_bytes, std::size_t threads = 0)
+            : table_(table_bytes)
+        {
+            if (threads == 0)
+                threads = (std::max)(1u, std::thread::hardware_concurrency());
+            if (threads > 1)
+                pool_ = std::make_unique<task_pool>(threads - 1);
+        }
+
+        // Deleted copy constructor and assignment operator
+        search_engine(const search_engine&) = delete;
+        search_engine& operator=(const search_engine&) = delete;
+
+    public:
+        /**
+         * Gets the number of threads a search uses.
+         *
+         * @return The thread count.
+         */
+        std::size_t get_thread_count() const noexcept
+        {
+            return pool_ ? pool_->size() + 1 : 1;
+        }
+
+        /**
+         * Searches a position for the best move. The first iteration always
+         * completes, so a move is found even with no time at all.
+         *
+         * @param root The position to move from.
+         * @param budget The time after which the search stops.
+         * @param max_depth The deepest iteration.
+         * @return The chosen move and the expected line.
+         */
+        search_result search(const board_record& root,
+            std::chrono::milliseconds budget,
+            std::uint32_t max_depth = k_max_search_ply)
+        {
+            max_depth = (std::max)(1u, (std::min)(max_depth,
+                k_max_search_ply));
+            deadline_ = std::chrono::steady_clock::now() + budget;
+            stop_.store(false, std::memory_order_relaxed);
+            table_.new_search();
+
+            std::vector<std::unique_ptr<search_worker>> workers;
+            workers.reserve(get_thread_count());
+            for (std::size_t i = 0; i < get_thread_count(); ++i)
+                workers.push_back(std::make_unique<search_worker>(i == 0));
+
+            std::atomic<std::size_t> running{ workers.size() - 1 };
+            for (std::size_t i = 1; i < workers.size(); ++i)
+            {
+                search_worker* helper = workers[i].get();
+                const std::uint32_t first_depth = 1 + (i % 2);
+                pool_->submit([this, helper, &root, first_depth, max_depth,
+                    &running] {
+                    deepen(*helper, root, first_depth, max_depth);
+                    running.fetch_sub(1, std::memory_order_release);
+                });
+            }
+
+            search_result result;
+            deepen(*workers[0], root, 1, max_depth);
+            stop_.store(true, std::memory_order_relaxed);
+            if (pool_)
+            {
+                pool_->wait_until([&] {
+                    return running.load(std::memory_order_acquire) == 0;
+                });
+            }
+
+            const search_worker& main = *workers[0];
+            for (const auto& worker : workers)
+                result.nodes += worker->nodes;
+            result.depth = main.completed_depth;
+            result.score = main.best_score;
+            result.has_move = main.best_index != k_no_move;
+            if (result.has_move)
+            {
+                result.principal_variation = principal_variation(root,
+                    main.best_index, result.depth);
+                result.best_move = result.principal_variation.front();
+            }
+            return result;
+        }
+
+        /**
+         * Forgets everything learned by earlier searches.
+         */
+        void clear() noexcept { table_.clear(); }
+
+        /**
+         * Makes the search stop at the positions an endgame tablebase
+         * covers and score them from it, so that endgames are played
+         * perfectly. The tablebase must outlive the searches using it.
+         *
+         * @param tablebase The tablebase, or nullptr to stop using one.
+         */
+        void set_tablebase(const endgame_tablebase* tablebase) noexcept
+        {
+            tablebase_ = tablebase;
+        }
+
+        /**
+         * Evaluates a quiet position statically: material, with kings worth
+         * more than men, plus small bonuses for men that crossed the middle
+         * of the board and for men guarding their back row.
+         *
+         * @param board The position.
+         * @return The score from the side to move; a man is worth 100.
+         */
+        static int evaluate(const board_record& board) noexcept
+        {
+            const int player = side_score(board.player & ~board.kings,
+                board.player & board.kings, 0x0000FFFFu, 0xF0000000u);
+            const int computer = side_score(board.computer & ~board.kings,
+                board.computer & board.kings, 0xFFFF0000u, 0x0000000Fu);
+            const int score = player - computer;
+            return board.side_to_move & 1 ? -score : score;
+        }
+
+        /**
+         * Builds the tree a decision viewer shows for a search: the root
+         * position, every legal move below it with the chosen one first, and
+         * the principal variation continuing below the chosen move.
+         *
+         * @param root The position that was searched.
+         * @param result The result of searching it.
+         * @param target An empty tree that receives the nodes.
+         */
+        static void build_search_tree(const board_record& root,
+            const search_result& result, tree<board_record>& target)
+        {
+            tree_node<board_record>* node = target.add_root(root);
+            if (!result.has_move) return;
+            tree_node<board_record>* best = node->add_child(result.best_move);
+            bool skipped = false;
+            move_generator::for_each_move(root,
+                [&](const board_record& child) {
+                    if (!skipped && child == result.best_move)
+                        skipped = true;
+                    else
+                        node->add_child(child);
+                });
+            const auto& line = result.principal_variation;
+            for (std::size_t i = 1; i < line.size(); ++i)
+                best = best->add_child(line[i]);
+        }
+
+    private:
+        /** A move being searched and the key of the board it leads to. */
+        struct scored_move
+        {
+            board_record board;
+            std::uint64_t key;
+            int order;
+            std::uint8_t index;
+        };
+
+        /** The state of one search thread. */
+        struct search_worker
+        {
+            explicit search_worker(bool is_main) : main(is_main) {}
+
+            /** Move lists, one per ply so that recursion does not clobber. */
+            std::vector<scored_move> moves[k_max_search_ply + 1];
+
+            /** Positions visited by this thread. */
+            std::uint64_t nodes = 0;
+
+            /** Whether this is the thread whose result is returned. */
+            bool main;
+
+            /** Deepest iteration completed. */
+            std::uint32_t completed_depth = 0;
+
+            /** Best root move of the last completed iteration. */
+            std::uint8_t best_index = k_no_move;
+
+            /** Score of that move. */
+            int best_score = 0;
+
+            /** Best root move of the iteration in progress. */
+            std::uint8_t root_index = k_no_move;
+        };
+
+        /**
+         * Counts the set bits of a bitboard.
+         */
+        static int count_squares(std::uint32_t bits) noexcept
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_popcount(bits);
+#elif defined(_MSC_VER)
+            return static_cast<int>(__popcnt(bits));
+#else
+            int count = 0;
+            for (; bits; bits &= bits - 1)
+                ++count;
+            return count;
+#endif
+        }
+
+        /**
+         * Scores the pieces of one side for evaluate().
+         */
+        static int side_score(std::uint32_t men, std::uint32_t kings,
+            std::uint32_t advanced, std::uint32_t back_row) noexcept
+        {
+            return 100 * count_squares(men) + 160 * count_squares(kings) +
+                5 * count_squares(men & advanced) +
+                4 * count_squares(men & back_row);
+        }
+
+        /**
+         * Converts a score relative to the root into one relative to a
+         * position, so that stored wins keep their distance right.
+         */
+        static int to_table(int score, std::uint32_t ply) noexcept
+        {
+            const int distance = static_cast<int>(ply);
+            if (score > k_win_score - static_cast<int>(k_max_search_ply))
+                return score + distance;
+            if (score < -k_win_score + static_cast<int>(k_max_search_ply))
+                return score - distance;
+            return score;
+        }
+
+        /**
+         * Converts a tablebase value into a score, wins found sooner
+         * scoring higher like those the search finds itself.
+         */
+        static int tablebase_score(const tablebase_value& value,
+            std::uint32_t ply) noexcept
+        {
+            const int distance = static_cast<int>(ply + value.plies);
+            if (value.result == e_game_result::win)
+                return k_win_score - distance;
+            if (value.result == e_game_result::loss)
+                return -k_win_score + distance;
+            return 0;
+        }
+
+        /**
+         * Converts a stored score back, see to_table.
+         */
+        static int from_table(int score, std::uint32_t ply) noexcept
+        {
+            const int distance = static_cast<int>(ply);
+            if (score > k_win_score - static_cast<int>(k_max_search_ply))
+                return score - distance;
+            if (score < -k_win_score + static_cast<int>(k_max_search_ply))
+                return score + distance;
+            return score;
+        }
+
+        /**
+         * Runs the iterations of one thread until the deepest one, a proven
+         * result or the stop signal.
+         */
+        void deepen(search_worker& worker, const board_record& root,
+            std::uint32_t first_depth, std::uint32_t max_depth)
+        {
+            const std::uint64_t key = zobrist_hash(root);
+            for (std::uint32_t depth = first_depth; depth <= max_depth;
+                ++depth)
+            {
+                const int score = negamax(worker, root, key,
+                    static_cast<int>(depth), -k_win_score - 1,
+                    k_win_score + 1, 0);
+                if (stop_.load(std::memory_order_relaxed)) break;
+                worker.completed_depth = depth;
+                worker.best_index = worker.root_index;
+                worker.best_score = score;
+                if (worker.best_index == k_no_move || score >
+                    k_win_score - static_cast<int>(k_max_search_ply) ||
+                    score < -k_win_score + static_cast<int>(k_max_search_ply))
+                    break;
+            }
+        }
+
+        /**
+         * Checks the clock now and then on the main thread, once a first
+         * iteration is complete.
+         */
+        void poll(search_worker& worker) noexcept
+        {
+            if (worker.main && worker.completed_depth > 0 &&
+                (worker.nodes & 1023) == 0 &&
+                std::chrono::steady_clock::now() >= deadline_)
+                stop_.store(true, std::memory_order_relaxed);
+        }
+
+        /**
+         * Searches a position with a fail-soft alpha-beta.
+         *
+         * @return The score from the side to move.
+         */
+        int negamax(search_worker& worker, const board_record& board,
+            std::uint64_t key, int depth, int alpha, int beta,
+            std::uint32_t ply)
+        {
+            ++worker.nodes;
+            poll(worker);
+            if (stop_.load(std::memory_order_relaxed)) return 0;
+            if (ply > 0 && tablebase_)
+            {
+                const tablebase_value value = tablebase_->probe(board);
+                if (value.result != e_game_result::unknown)
+                    return tablebase_score(value, ply);
+            }
+
+            auto& moves = worker.moves[ply];
+            moves.clear();
+            const std::uint32_t enemy = board.side_to_move & 1 ?
+                board.player : board.computer;
+            bool capture = false;
+            std::uint8_t index = 0;
+            move_generator::for_each_move(board,
+                [&](const board_record& child) {
+                    const std::uint32_t remaining = board.side_to_move & 1 ?
+                        child.player : child.computer;
+                    capture = remaining != enemy;
+                    moves.push_back({ child, 0, 0, index });
+                    index = static_cast<std::uint8_t>((std::min)(index + 1,
+                        k_no_move - 1));
+                });
+            if (moves.empty()) return -k_win_score + static_cast<int>(ply);
+            if (ply == k_max_search_ply || (depth <= 0 && !capture))
+                return evaluate(board);
+
+            transposition_entry entry;
+            std::uint8_t stored_move = k_no_move;
+            if (table_.probe(key, entry))
+            {
+                stored_move = entry.move;
+                if (ply > 0 && static_cast<int>(entry.depth) >= depth)
+                {
+                    const int score = from_table(entry.score, ply);
+                    if (entry.bound == e_search_bound::exact) return score;
+                    if (entry.bound == e_search_bound::lower)
+                        alpha = (std::max)(alpha, score);
+                    else
+                        beta = (std::min)(beta, score);
+                    if (alpha >= beta) return score;
+                }
+            }
+
+            for (auto& move : moves)
+            {
+                move.key = zobrist_update(key, board, move.board);
+                move.order = move.index == stored_move ? k_win_score * 2 :
+                    -evaluate(move.board);
+            }
+            std::sort(moves.begin(), moves.end(),
+                [](const scored_move& a, const scored_move& b) {
+                    return a.order != b.order ? a.order > b.order :
+                        a.index < b.index;
+                });
+
+            const int original_alpha = alpha;
+            int best = -k_win_score - 1;
+            std::uint8_t best_index = k_no_move;
+            for (const scored_move& move : moves)
+            {
+                const int score = -negamax(worker, move.board, move.key,
+                    depth - 1, -beta, -alpha, ply + 1);
+                if (stop_.load(std::memory_order_relaxed)) return 0;
+                if (score > best)
+                {
+                    best = score;
+                    best_index = move.index;
+                    alpha = (std::max)(alpha, score);
+                    if (alpha >= beta) break;
+                }
+            }
+
+            if (ply == 0) worker.root_index = best_index;
+            const e_search_bound bound = best <= original_alpha ?
+                e_search_bound::upper : best >= beta ?
+                e_search_bound::lower : e_search_bound::exact;
+            table_.store(key, { to_table(best, ply),
+                static_cast<std::uint32_t>((std::max)(depth, 0)), bound,
+                best_index });
+            return best;
+        }
+
+        /**
+         * Follows the best moves stored in the table from the root.
+         *
+         * @param root The searched position.
+         * @param first The index of the chosen root move.
+         * @param length The longest line to return.
+         * @return The boards of the line, the chosen move first.
+         */
+        std::vector<board_record> principal_variation(
+            const board_record& root, std::uint8_t first,
+            std::uint32_t length) const
+        {
+            std::vector<board_record> line;
+            std::vector<std::uint64_t> seen;
+            board_record board = root;
+            std::uint64_t key = zobrist_hash(root);
+            std::uint8_t move = first;
+            while (line.size() < length && move != k_no_move)
+            {
+                std::uint8_t index = 0;
+                bool found = false;
+                move_generator::for_each_move(board,
+                    [&](const board_record& child) {
+                        if (index++ == move && !found)
+                        {
+                            found = true;
+                            key = zobrist_update(key, board, child);
+                            board = child;
+                        }
+                    });
+                if (!found ||
+                    std::find(seen.begin(), seen.end(), key) != seen.end())
+                    break;
+                line.push_back(board);
+                seen.push_back(key);
+
+                transposition_entry entry;
+                move = table_.probe(key, entry) ? entry.move : k_no_move;
+            }
+            return line;
+        }
+
+    private:
+        /** Results shared by every search thread. */
+        transposition_table table_;
+
+        /** Runs the helper threads; null for a single-threaded engine. */
+        std::unique_ptr<task_pool> pool_;
+
+        /** Scores the positions it covers; null when not set. */
+        const endgame_tablebase* tablebase_ = nullptr;
+
+        /** Tells every thread to unwind. */
+        std::atomic<bool> stop_{ false };
+
+        /** When the current search has to stop. */
+        std::chrono::steady_clock::time_point deadline_;
+    };
+};
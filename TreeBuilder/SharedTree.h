@@ -0,0 +1,379 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+#include "Tree.h"
+#include "CompactTree.h"
+#include "ArrayView.h"
+
+namespace tree_builder
+{
+    /**
+     * An immutable, hash-consed snapshot of a tree in which structurally
+     * identical subtrees are stored once, turning the forest into a DAG.
+     * Two subtrees are identical when their roots hold equal data and their
+     * children are, in order, identical subtrees; transpositions of a game
+     * tree, reached through different move orders, collapse to one entry.
+     *
+     * Each distinct subtree is an entry with its value, a Merkle hash that
+     * combines the hash of the value with the hashes of its children, and
+     * the indices of its child entries in CSR form. The snapshot is built
+     * bottom-up in one post-order pass, so the children of a node are
+     * already interned when it comes up and a hash table lookup, confirmed
+     * by comparing the value and the child indices, tells whether the
+     * subtree exists. Traversals expand shared entries again and visit the
+     * same values in the same order as tree::path on the source.
+     *
+     * @tparam T The type of data stored in each node. Needs operator==.
+     * @tparam Hash Hashes a value of type T.
+     */
+    template<typename T, typename Hash = std::hash<T>>
+    class shared_tree
+    {
+    public:
+        using index_type = std::uint32_t;
+        using node_type = tree_node<T>;
+
+        /** A contiguous, non-owning range of entry indices. */
+        using index_range = array_view<const index_type>;
+
+        /**
+         * Builds the snapshot of a tree, following its orientation. The
+         * source is only read and can keep being used afterwards.
+         *
+         * @param source The tree to compact.
+         * @param hash The hasher of the values.
+         */
+        explicit shared_tree(const tree<T>& source, Hash hash = Hash())
+            : hash_(std::move(hash))
+        {
+            const tree_stats stats = source.get_stats();
+            source_nodes_ = static_cast<std::size_t>(stats.nodes);
+            source_bytes_ = static_cast<std::size_t>(stats.bytes);
+            reset_table(0);
+            child_offsets_.push_back(0);
+
+            // Every finished node leaves its entry on ids; a node finishes
+            // right after its children, whose entries are then the last
+            // ones on ids.
+            std::vector<std::pair<const node_type*, std::size_t>> stack;
+            std::vector<index_type> ids;
+            for (const node_type* root : source.get_roots())
+            {
+                stack.emplace_back(root, 0);
+                while (!stack.empty())
+                {
+                    auto& [node, next] = stack.back();
+                    if (const node_type* child = source.get_child(node, next))
+                    {
+                        ++next;
+                        stack.emplace_back(child, 0);
+                        continue;
+                    }
+                    const std::size_t first = ids.size() - next;
+                    const index_type id = intern(node->get_data(),
+                        ids.data() + first, next);
+                    ids.resize(first);
+                    ids.push_back(id);
+                    stack.pop_back();
+                }
+                roots_.push_back(ids.back());
+                ids.pop_back();
+            }
+
+            // The table only serves the build.
+            slots_ = std::vector<index_type>();
+            values_.shrink_to_fit();
+            hashes_.shrink_to_fit();
+            sizes_.shrink_to_fit();
+            child_offsets_.shrink_to_fit();
+            children_.shrink_to_fit();
+        }
+
+        // Deleted copy constructor and assignment operator
+        shared_tree(const shared_tree&) = delete;
+        shared_tree& operator=(const shared_tree&) = delete;
+
+    public:
+        /**
+         * Gets the number of distinct subtrees, i.e. of stored entries.
+         *
+         * @return The entry count.
+         */
+        std::size_t size() const noexcept { return values_.size(); }
+
+        /**
+         * Gets the number of nodes of the source tree, which is the number
+         * of nodes the traversals visit.
+         *
+         * @return The node count of the expanded forest.
+         */
+        std::size_t get_node_count() const noexcept { return source_nodes_; }
+
+        /**
+         * Retrieves the entries of the roots, in the order of the source.
+         * Identical root trees share an entry.
+         *
+         * @return A range over the root entries.
+         */
+        index_range get_roots() const noexcept
+        {
+            return { roots_.data(), roots_.size() };
+        }
+
+        /**
+         * Retrieves the child entries of an entry, in the order of the
+         * source.
+         *
+         * @param entry The index of the entry.
+         * @return A range over the child entries.
+         */
+        index_range get_children(index_type entry) const noexcept
+        {
+            return { children_.data() + child_offsets_[entry],
+                child_offsets_[entry + 1] - child_offsets_[entry] };
+        }
+
+        /**
+         * Gets the value of an entry.
+         *
+         * @param entry The index of the entry.
+         * @return Const reference to the value.
+         */
+        const T& get_data(index_type entry) const noexcept
+        {
+            return values_[entry];
+        }
+
+        /**
+         * Gets the structural hash of an entry. Identical subtrees have
+         * equal hashes, in any snapshot built with the same hasher.
+         *
+         * @param entry The index of the entry.
+         * @return The Merkle hash of the subtree.
+         */
+        std::uint64_t get_hash(index_type entry) const noexcept
+        {
+            return hashes_[entry];
+        }
+
+        /**
+         * Gets the number of nodes the subtree of an entry expands to.
+         *
+         * @param entry The index of the entry.
+         * @return The subtree size, the entry itself included.
+         */
+        std::uint64_t get_subtree_size(index_type entry) const noexcept
+        {
+            return sizes_[entry];
+        }
+
+        /**
+         * Gets the bytes the source tree held for its nodes and child arrays
+         * when the snapshot was taken (see tree_stats::bytes). Memory owned
+         * by the node data itself is not included.
+         *
+         * @return The number of bytes.
+         */
+        std::size_t get_source_bytes() const noexcept { return source_bytes_; }
+
+        /**
+         * Gets the bytes held by the snapshot. Memory owned by the values
+         * themselves is not included.
+         *
+         * @return The number of bytes.
+         */
+        std::size_t get_bytes() const noexcept
+        {
+            return values_.capacity() * sizeof(T) +
+                (hashes_.capacity() + sizes_.capacity()) *
+                sizeof(std::uint64_t) +
+                (child_offsets_.capacity() + children_.capacity() +
+                    roots_.capacity()) *
+                sizeof(index_type);
+        }
+
+        /**
+         * Gets the memory saved by the snapshot compared with the source
+         * tree.
+         *
+         * @return The source bytes minus the snapshot bytes, which is
+         * negative when there was too little sharing to pay for the hashes.
+         */
+        std::int64_t get_reclaimed_bytes() const noexcept
+        {
+            return static_cast<std::int64_t>(source_bytes_) -
+                static_cast<std::int64_t>(get_bytes());
+        }
+
+        /**
+         * Traverses the expanded forest. Produces the same sequence of
+         * values as tree::path on the source; shared entries appear once
+         * per occurrence.
+         *
+         * @param type The type of traversal path to use.
+         * @return The entry of every visited node, in traversal order.
+         */
+        std::vector<index_type> path(e_type_of_path_on_tree type) const
+        {
+            if (type != e_type_of_path_on_tree::pre_order)
+            {
+                return csr_path(source_nodes_, get_roots(),
+                    child_offsets_.data(), children_.data(), type);
+            }
+
+            // csr_path reads a pre-order off the numbering of a tree, which
+            // a DAG does not have, so this one is walked.
+            std::vector<index_type> result;
+            result.reserve(source_nodes_);
+            std::vector<index_type> stack;
+            for (const index_type root : roots_)
+            {
+                stack.push_back(root);
+                while (!stack.empty())
+                {
+                    const index_type entry = stack.back();
+                    stack.pop_back();
+                    result.push_back(entry);
+                    const auto children = get_children(entry);
+                    for (std::size_t i = children.size(); i-- > 0;)
+                        stack.push_back(children[i]);
+                }
+            }
+            return result;
+        }
+
+    private:
+        /** Marks a free slot of the hash table. */
+        static constexpr index_type k_free_slot = static_cast<index_type>(-1);
+
+        /**
+         * Finds the entry of a subtree, adding it if it is new.
+         *
+         * @param value The value of the subtree root.
+         * @param children The entries of its children, in order.
+         * @param count The number of children.
+         * @return The index of the entry.
+         */
+        index_type intern(const T& value, const index_type* children,
+            std::size_t count)
+        {
+            std::uint64_t hash = mix(static_cast<std::uint64_t>(
+                hash_(value)) + count);
+            std::uint64_t size = 1;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                hash = mix(hash ^ hashes_[children[i]]);
+                size += sizes_[children[i]];
+            }
+
+            const std::size_t mask = slots_.size() - 1;
+            std::size_t slot = static_cast<std::size_t>(hash) & mask;
+            for (;; slot = (slot + 1) & mask)
+            {
+                const index_type entry = slots_[slot];
+                if (entry == k_free_slot) break;
+                if (hashes_[entry] == hash && matches(entry, value, children,
+                    count))
+                    return entry;
+            }
+
+            const auto entry = static_cast<index_type>(values_.size());
+            values_.push_back(value);
+            hashes_.push_back(hash);
+            sizes_.push_back(size);
+            children_.insert(children_.end(), children, children + count);
+            child_offsets_.push_back(static_cast<index_type>(
+                children_.size()));
+            slots_[slot] = entry;
+            if (values_.size() * 2 > slots_.size())
+                reset_table(values_.size());
+            return entry;
+        }
+
+        /**
+         * Checks whether an entry holds a given subtree.
+         */
+        bool matches(index_type entry, const T& value,
+            const index_type* children, std::size_t count) const
+        {
+            const auto existing = get_children(entry);
+            if (existing.size() != count || !(values_[entry] == value))
+                return false;
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                if (existing[i] != children[i]) return false;
+            }
+            return true;
+        }
+
+        /**
+         * Resizes the hash table to hold at least twice the given number of
+         * entries and inserts the existing ones again.
+         */
+        void reset_table(std::size_t entries)
+        {
+            std::size_t capacity = 16;
+            while (capacity < entries * 2)
+                capacity *= 2;
+            slots_.assign(capacity, k_free_slot);
+            for (std::size_t entry = 0; entry < values_.size(); ++entry)
+            {
+                std::size_t slot = static_cast<std::size_t>(hashes_[entry]) &
+                    (capacity - 1);
+                while (slots_[slot] != k_free_slot)
+                    slot = (slot + 1) & (capacity - 1);
+                slots_[slot] = static_cast<index_type>(entry);
+            }
+        }
+
+        /**
+         * Scrambles a 64-bit value (the splitmix64 finalizer), so that
+         * hashes differ in their low bits, which pick the table slot.
+         */
+        static std::uint64_t mix(std::uint64_t value) noexcept
+        {
+            value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+            value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+            return value ^ (value >> 31);
+        }
+
+    private:
+        /** Hashes the values. */
+        Hash hash_;
+
+        /** Value of each entry. */
+        std::vector<T> values_;
+
+        /** Merkle hash of each entry. */
+        std::vector<std::uint64_t> hashes_;
+
+        /** Number of nodes each entry expands to. */
+        std::vector<std::uint64_t> sizes_;
+
+        /** Start of each entry's slice of children_, plus one end marker. */
+        std::vector<index_type> child_offsets_;
+
+        /** Child entries of all entries, grouped per parent. */
+        std::vector<index_type> children_;
+
+        /** Entries of the roots. */
+        std::vector<index_type> roots_;
+
+        /**
+         * Open-addressing hash table of entries, k_free_slot if free. Empty
+         * once the snapshot is built.
+         */
+        std::vector<index_type> slots_;
+
+        /** Number of nodes of the source tree. */
+        std::size_t source_nodes_ = 0;
+
+        /** Bytes the source tree held; see get_source_bytes. */
+        std::size_t source_bytes_ = 0;
+    };
+};
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Tablebase.h"
+
+using namespace tree_builder;
+
+namespace
+{
+    void print_usage(const char* program)
+    {
+        std::fprintf(stderr,
+            "usage: %s [--pieces N] [--threads N] [--output PATH]\n"
+            "  --pieces   most pieces on the board, at most %u (default 4)\n"
+            "  --threads  threads scanning positions, 0 for one per"
+            " hardware thread (default 0)\n"
+            "  --output   tablebase file to write (default endgame.tb)\n",
+            program, k_max_tablebase_pieces);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::uint32_t pieces = 4;
+    std::size_t threads = 0;
+    const char* output = "endgame.tb";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--pieces") == 0 && has_value)
+            pieces = static_cast<std::uint32_t>(
+                std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+            threads = static_cast<std::size_t>(
+                std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--output") == 0 && has_value)
+            output = argv[++i];
+        else
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (pieces < 2 || pieces > k_max_tablebase_pieces)
+    {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    tablebase_generator generator(pieces, threads);
+    const auto slices = generator.get_layout().get_slices();
+    std::printf("%zu slices, %llu entries\n", slices.size(),
+        static_cast<unsigned long long>(generator.get_layout().size()));
+
+    // Each slice is named by its piece counts: player men, player kings,
+    // computer men and computer kings.
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < slices.size(); ++i)
+    {
+        const auto slice_start = std::chrono::steady_clock::now();
+        if (!generator.solve_next())
+        {
+            std::fprintf(stderr, "a distance exceeds %u plies\n",
+                k_max_tablebase_plies);
+            return 1;
+        }
+        const auto& stats = generator.get_stats()[i];
+        const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - slice_start).count();
+        std::printf("slice %u%u%u%u  wins %10llu  losses %10llu"
+            "  draws %10llu  longest %3u  %8.3f s\n",
+            slices[i].player_men, slices[i].player_kings,
+            slices[i].computer_men, slices[i].computer_kings,
+            static_cast<unsigned long long>(stats.wins),
+            static_cast<unsigned long long>(stats.losses),
+            static_cast<unsigned long long>(stats.draws), stats.longest,
+            seconds);
+    }
+    std::printf("solved in %.3f s\n", std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count());
+
+    if (!generator.save(output))
+    {
+        std::fprintf(stderr, "could not write %s\n", output);
+        return 1;
+    }
+
+    // Reads the file back through the mapping used by the lookups.
+    endgame_tablebase tablebase;
+    if (!tablebase.open(output) ||
+        tablebase.get_max_pieces() != generator.get_layout().get_max_pieces())
+    {
+        std::fprintf(stderr, "could not map %s back\n", output);
+        return 1;
+    }
+    std::printf("wrote %s\n", output);
+    return 0;
+}
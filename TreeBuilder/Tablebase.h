@@ -0,0 +1,1081 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "ArrayView.h"
+#include "BoardRecord.h"
+#include "MappedFile.h"
+#include "MoveGenerator.h"
+#include "TaskPool.h"
+#include "Tree.h"
+#include "TreeBuilderData.h"
+#include "TreeFile.h"
+
+namespace tree_builder
+{
+    /** Most pieces an endgame tablebase can cover. */
+    constexpr std::uint32_t k_max_tablebase_pieces = 6;
+
+    /** Longest distance, in plies, a tablebase entry can store. */
+    constexpr std::uint32_t k_max_tablebase_plies = 254;
+
+    /**
+     * The value of a position looked up in an endgame tablebase.
+     */
+    struct tablebase_value
+    {
+        /** The outcome for the side to move. */
+        e_game_result result = e_game_result::unknown;
+
+        /**
+         * Plies until the game ends with best play: the winner takes the
+         * shortest way, the loser the longest. 0 for draws.
+         */
+        std::uint32_t plies = 0;
+    };
+
+    /**
+     * Decodes one tablebase entry. An entry is 0 for a draw and the
+     * distance in plies plus one otherwise; the side to move wins when the
+     * distance is odd, since the game then ends after its own move, and
+     * loses when it is even.
+     *
+     * @param entry The stored byte.
+     * @return The value it encodes.
+     */
+    constexpr tablebase_value decode_tablebase_entry(std::uint8_t entry)
+        noexcept
+    {
+        if (entry == 0) return { e_game_result::draw, 0 };
+        const std::uint32_t plies = entry - 1u;
+        return { plies % 2 == 1 ? e_game_result::win : e_game_result::loss,
+            plies };
+    }
+
+    /**
+     * The positions sharing one combination of piece counts, stored
+     * contiguously in a tablebase.
+     */
+    struct tablebase_slice
+    {
+        std::uint8_t player_men = 0;
+        std::uint8_t player_kings = 0;
+        std::uint8_t computer_men = 0;
+        std::uint8_t computer_kings = 0;
+
+        /** Index of the first entry of the slice in the whole table. */
+        std::uint64_t offset = 0;
+
+        /** Number of entries, both sides to move included. */
+        std::uint64_t size = 0;
+    };
+
+    /**
+     * Binomial coefficients up to 32 choose 32.
+     */
+    struct binomial_table
+    {
+        std::uint64_t values[k_board_squares + 1][k_board_squares + 1];
+    };
+
+    /**
+     * Computes the binomial coefficients with Pascal's triangle.
+     *
+     * @return The table.
+     */
+    constexpr binomial_table make_binomial_table() noexcept
+    {
+        binomial_table table{};
+        for (std::uint32_t n = 0; n <= k_board_squares; ++n)
+        {
+            table.values[n][0] = 1;
+            for (std::uint32_t k = 1; k <= n; ++k)
+                table.values[n][k] = table.values[n - 1][k - 1] +
+                    (k < n ? table.values[n - 1][k] : 0);
+        }
+        return table;
+    }
+
+    /** Binomial coefficients, computed at compile time. */
+    constexpr binomial_table k_binomials = make_binomial_table();
+
+    /**
+     * Maps every checkers position with at most a given number of pieces to
+     * an entry of a flat table, and back.
+     *
+     * Positions are grouped into slices by their piece counts; both sides
+     * have at least one piece. Within a slice a position is ranked as a
+     * mixed-radix number whose digits are the combinatorial (colex) ranks
+     * of, in order, the computer men among the 28 squares a computer man
+     * can stand on, the player men among their own 28 squares, the player
+     * kings among the squares the men leave free and the computer kings
+     * among the squares left after that, followed by the side to move.
+     * Only the men can collide, so the few indices where a player man and a
+     * computer man share a square are the only unused entries.
+     *
+     * Slices are ordered so that every move leaving a slice, a capture or a
+     * crowning, leads to an earlier slice: fewer pieces first, then fewer
+     * men.
+     */
+    class tablebase_layout
+    {
+    public:
+        /** Squares a player man can stand on: all but row 0. */
+        static constexpr std::uint32_t k_player_men_squares = 0xFFFFFFF0u;
+
+        /** Squares a computer man can stand on: all but row 7. */
+        static constexpr std::uint32_t k_computer_men_squares = 0x0FFFFFFFu;
+
+        /**
+         * Lays out the slices of every position up to a number of pieces.
+         *
+         * @param max_pieces The most pieces on the board, clamped to
+         * k_max_tablebase_pieces.
+         */
+        explicit tablebase_layout(std::uint32_t max_pieces)
+            : max_pieces_((std::min)(max_pieces, k_max_tablebase_pieces))
+        {
+            const std::uint32_t side = max_pieces_ + 1;
+            slice_of_.assign(std::size_t{ side } * side * side * side,
+                k_no_slice);
+            for (std::uint32_t total = 2; total <= max_pieces_; ++total)
+            {
+                for (std::uint32_t men = 0; men <= total; ++men)
+                    add_slices(total, men);
+            }
+        }
+
+    public:
+        /**
+         * Gets the most pieces a covered position has.
+         *
+         * @return The piece limit.
+         */
+        std::uint32_t get_max_pieces() const noexcept { return max_pieces_; }
+
+        /**
+         * Gets the slices in the order they are stored and solved.
+         *
+         * @return The slices.
+         */
+        array_view<const tablebase_slice> get_slices() const noexcept
+        {
+            return { slices_.data(), slices_.size() };
+        }
+
+        /**
+         * Gets the number of entries of the whole table.
+         *
+         * @return The entry count.
+         */
+        std::uint64_t size() const noexcept { return size_; }
+
+        /**
+         * Finds the slice of a position.
+         *
+         * @param board The position.
+         * @return The slice, or nullptr if the position is not covered.
+         */
+        const tablebase_slice* find_slice(const board_record& board) const
+            noexcept
+        {
+            const std::uint32_t player_men = count_squares(board.player &
+                ~board.kings);
+            const std::uint32_t player_kings = count_squares(board.player &
+                board.kings);
+            const std::uint32_t computer_men = count_squares(board.computer &
+                ~board.kings);
+            const std::uint32_t computer_kings = count_squares(
+                board.computer & board.kings);
+            if (player_men + player_kings + computer_men + computer_kings >
+                max_pieces_)
+                return nullptr;
+            const std::uint32_t slice = slice_of_[key(player_men,
+                player_kings, computer_men, computer_kings)];
+            return slice == k_no_slice ? nullptr : &slices_[slice];
+        }
+
+        /**
+         * Finds the entry of a position.
+         *
+         * @param board The position.
+         * @param entry Receives the index of its entry in the whole table.
+         * @return Whether the position is covered.
+         */
+        bool locate(const board_record& board, std::uint64_t& entry) const
+            noexcept
+        {
+            if ((board.player & board.computer) ||
+                (board.kings & ~(board.player | board.computer)) ||
+                (board.player & ~board.kings & ~k_player_men_squares) ||
+                (board.computer & ~board.kings & ~k_computer_men_squares))
+                return false;
+            const tablebase_slice* slice = find_slice(board);
+            if (!slice) return false;
+            entry = slice->offset + index_in_slice(*slice, board);
+            return true;
+        }
+
+        /**
+         * Ranks a position of a slice.
+         *
+         * @param slice The slice of the position.
+         * @param board A valid position with the piece counts of the slice.
+         * @return Its index within the slice.
+         */
+        std::uint64_t index_in_slice(const tablebase_slice& slice,
+            const board_record& board) const noexcept
+        {
+            const std::uint32_t player_men = board.player & ~board.kings;
+            const std::uint32_t computer_men = board.computer & ~board.kings;
+            const std::uint32_t men = player_men | computer_men;
+            const std::uint32_t player_kings = board.player & board.kings;
+
+            std::uint64_t index = rank(compress(computer_men,
+                k_computer_men_squares));
+            index = index * k_binomials.values[28][slice.player_men] +
+                rank(compress(player_men, k_player_men_squares));
+            index = index * k_binomials.values[k_board_squares -
+                count_squares(men)][slice.player_kings] +
+                rank(compress(player_kings, ~men));
+            index = index * k_binomials.values[k_board_squares -
+                count_squares(men | player_kings)][slice.computer_kings] +
+                rank(compress(board.computer & board.kings,
+                    ~(men | player_kings)));
+            return index * 2 + (board.side_to_move & 1);
+        }
+
+        /**
+         * Unranks an index of a slice.
+         *
+         * @param slice The slice.
+         * @param index An index below the size of the slice.
+         * @param board Receives the position.
+         * @return False for the unused indices, where men collide.
+         */
+        bool board_at(const tablebase_slice& slice, std::uint64_t index,
+            board_record& board) const noexcept
+        {
+            const std::uint32_t free_squares = k_board_squares -
+                slice.player_men - slice.computer_men;
+            const std::uint64_t computer_kings_radix = k_binomials.values[
+                free_squares - slice.player_kings][slice.computer_kings];
+            const std::uint64_t player_kings_radix =
+                k_binomials.values[free_squares][slice.player_kings];
+            const std::uint64_t player_men_radix =
+                k_binomials.values[28][slice.player_men];
+
+            board.side_to_move = static_cast<std::uint32_t>(index & 1);
+            index >>= 1;
+            const std::uint64_t computer_kings_rank =
+                index % computer_kings_radix;
+            index /= computer_kings_radix;
+            const std::uint64_t player_kings_rank =
+                index % player_kings_radix;
+            index /= player_kings_radix;
+            const std::uint32_t player_men = expand(unrank(
+                index % player_men_radix, slice.player_men),
+                k_player_men_squares);
+            const std::uint32_t computer_men = expand(unrank(
+                index / player_men_radix, slice.computer_men),
+                k_computer_men_squares);
+            if (player_men & computer_men) return false;
+
+            const std::uint32_t men = player_men | computer_men;
+            const std::uint32_t player_kings = expand(unrank(
+                player_kings_rank, slice.player_kings), ~men);
+            const std::uint32_t computer_kings = expand(unrank(
+                computer_kings_rank, slice.computer_kings),
+                ~(men | player_kings));
+            board.player = player_men | player_kings;
+            board.computer = computer_men | computer_kings;
+            board.kings = player_kings | computer_kings;
+            return true;
+        }
+
+        /**
+         * Counts the set bits of a bitboard.
+         */
+        static std::uint32_t count_squares(std::uint32_t bits) noexcept
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return static_cast<std::uint32_t>(__builtin_popcount(bits));
+#elif defined(_MSC_VER)
+            return static_cast<std::uint32_t>(__popcnt(bits));
+#else
+            std::uint32_t count = 0;
+            for (; bits; bits &= bits - 1)
+                ++count;
+            return count;
+#endif
+        }
+
+    private:
+        /** Marks piece counts without a slice. */
+        static constexpr std::uint32_t k_no_slice = 0xFFFFFFFFu;
+
+        /**
+         * Adds the slices with a given number of pieces and of men.
+         */
+        void add_slices(std::uint32_t total, std::uint32_t men)
+        {
+            const std::uint32_t kings = total - men;
+            for (std::uint32_t player_men = 0; player_men <= men;
+                ++player_men)
+            {
+                const std::uint32_t computer_men = men - player_men;
+                for (std::uint32_t player_kings = 0; player_kings <= kings;
+                    ++player_kings)
+                {
+                    const std::uint32_t computer_kings = kings -
+                        player_kings;
+                    if (player_men + player_kings == 0 ||
+                        computer_men + computer_kings == 0)
+                        continue;
+
+                    tablebase_slice slice;
+                    slice.player_men = static_cast<std::uint8_t>(player_men);
+                    slice.player_kings = static_cast<std::uint8_t>(
+                        player_kings);
+                    slice.computer_men = static_cast<std::uint8_t>(
+                        computer_men);
+                    slice.computer_kings = static_cast<std::uint8_t>(
+                        computer_kings);
+                    slice.offset = size_;
+                    slice.size = 2 * k_binomials.values[28][computer_men] *
+                        k_binomials.values[28][player_men] *
+                        k_binomials.values[k_board_squares - men]
+                            [player_kings] *
+                        k_binomials.values[k_board_squares - men -
+                            player_kings][computer_kings];
+                    slice_of_[key(player_men, player_kings, computer_men,
+                        computer_kings)] = static_cast<std::uint32_t>(
+                        slices_.size());
+                    slices_.push_back(slice);
+                    size_ += slice.size;
+                }
+            }
+        }
+
+        /**
+         * Gets the position of some piece counts in slice_of_.
+         */
+        std::size_t key(std::uint32_t player_men, std::uint32_t player_kings,
+            std::uint32_t computer_men, std::uint32_t computer_kings) const
+            noexcept
+        {
+            const std::size_t side = max_pieces_ + 1;
+            return ((player_men * side + player_kings) * side +
+                computer_men) * side + computer_kings;
+        }
+
+        /**
+         * Gathers the bits of value found under the set bits of mask into
+         * the low bits of the result, in order.
+         */
+        static std::uint32_t compress(std::uint32_t value, std::uint32_t mask)
+            noexcept
+        {
+            std::uint32_t result = 0;
+            for (value &= mask; value; value &= value - 1)
+            {
+                const std::uint32_t below = (value & (0u - value)) - 1;
+                result |= std::uint32_t{ 1 } << count_squares(mask & below);
+            }
+            return result;
+        }
+
+        /**
+         * Scatters the low bits of value to the set bits of mask, the
+         * inverse of compress().
+         */
+        static std::uint32_t expand(std::uint32_t value, std::uint32_t mask)
+            noexcept
+        {
+            std::uint32_t result = 0;
+            for (; mask && value; mask &= mask - 1, value >>= 1)
+            {
+                if (value & 1)
+                    result |= mask & (0u - mask);
+            }
+            return result;
+        }
+
+        /**
+         * Ranks a set among the sets of the same size in colex order.
+         */
+        static std::uint64_t rank(std::uint32_t bits) noexcept
+        {
+            std::uint64_t result = 0;
+            std::uint32_t k = 1;
+            for (std::uint32_t i = 0; bits; ++i, bits >>= 1)
+            {
+                if (bits & 1)
+                    result += k_binomials.values[i][k++];
+            }
+            return result;
+        }
+
+        /**
+         * Builds the set of a given size and colex rank.
+         */
+        static std::uint32_t unrank(std::uint64_t index, std::uint32_t size)
+            noexcept
+        {
+            std::uint32_t bits = 0;
+            for (std::uint32_t k = size; k > 0; --k)
+            {
+                std::uint32_t element = k - 1;
+                while (element + 1 < k_board_squares &&
+                    k_binomials.values[element + 1][k] <= index)
+                    ++element;
+                index -= k_binomials.values[element][k];
+                bits |= std::uint32_t{ 1 } << element;
+            }
+            return bits;
+        }
+
+    private:
+        /** The most pieces a covered position has. */
+        std::uint32_t max_pieces_;
+
+        /** The slices in storage order. */
+        std::vector<tablebase_slice> slices_;
+
+        /** Slice index of every combination of piece counts. */
+        std::vector<std::uint32_t> slice_of_;
+
+        /** Entries of the whole table. */
+        std::uint64_t size_ = 0;
+    };
+
+    /**
+     * Fixed-size header at the start of a tablebase file, followed by one
+     * byte per entry of the tablebase_layout of its piece limit, as read by
+     * decode_tablebase_entry. Fields are little-endian:
+     *
+     * - magic "TBEG", version (uint16), piece limit (uint16);
+     * - entry count (uint64).
+     */
+    struct tablebase_file_header
+    {
+        static constexpr unsigned char k_magic[4] = { 'T', 'B', 'E', 'G' };
+        static constexpr std::uint16_t k_version = 1;
+        static constexpr std::size_t k_size = 16;
+
+        std::uint16_t version = k_version;
+        std::uint16_t max_pieces = 0;
+        std::uint64_t entry_count = 0;
+
+        /**
+         * Encodes the header into its on-disk form.
+         *
+         * @param out Receives the k_size header bytes.
+         */
+        void encode(unsigned char* out) const noexcept
+        {
+            std::memcpy(out, k_magic, 4);
+            tree_file_header::store_le(out + 4, version);
+            tree_file_header::store_le(out + 6, max_pieces);
+            tree_file_header::store_le(out + 8, entry_count);
+        }
+
+        /**
+         * Decodes and validates an on-disk header.
+         *
+         * @param in The header bytes, at least k_size of them.
+         * @param available The number of bytes in the whole file.
+         * @return True if the header is valid and the file is large enough.
+         */
+        bool decode(const unsigned char* in, std::size_t available) noexcept
+        {
+            if (available < k_size || std::memcmp(in, k_magic, 4) != 0)
+                return false;
+            version = tree_file_header::load_le<std::uint16_t>(in + 4);
+            max_pieces = tree_file_header::load_le<std::uint16_t>(in + 6);
+            entry_count = tree_file_header::load_le<std::uint64_t>(in + 8);
+            return version == k_version &&
+                max_pieces <= k_max_tablebase_pieces &&
+                entry_count <= available - k_size;
+        }
+    };
+
+    /**
+     * Looks a position up in the entries of a table.
+     *
+     * @param layout The layout of the table.
+     * @param entries The entries, one byte each.
+     * @param board The position.
+     * @return Its value, unknown if it is not covered.
+     */
+    inline tablebase_value probe_tablebase_entries(
+        const tablebase_layout& layout, const std::uint8_t* entries,
+        const board_record& board) noexcept
+    {
+        const bool computer = (board.side_to_move & 1) != 0;
+        const std::uint32_t own = computer ? board.computer : board.player;
+        const std::uint32_t enemy = computer ? board.player : board.computer;
+        if (own == 0 && enemy != 0) return { e_game_result::loss, 0 };
+
+        std::uint64_t entry;
+        if (!layout.locate(board, entry)) return {};
+        return decode_tablebase_entry(entries[entry]);
+    }
+
+    /**
+     * Computes an endgame tablebase by retrograde analysis: the exact value
+     * of every position up to a number of pieces, with the distance to the
+     * end of the game, one slice at a time in the order of the layout.
+     *
+     * Within a slice every position first scans its moves. Moves that leave
+     * the slice lead to solved slices and are read from the table; moves
+     * that stay, the quiet steps, are only counted. Positions are then
+     * resolved in increasing distance: a resolved loss makes its quiet
+     * predecessors, found by unmaking a step, wins one ply longer, and a
+     * resolved win decrements the count of its predecessors, which become
+     * losses once every move leads to a win of the opponent. What is left
+     * is drawn. The scan, which does all the move generation, is split
+     * across a task_pool.
+     */
+    class tablebase_generator
+    {
+    public:
+        /**
+         * What solving a slice found.
+         */
+        struct slice_stats
+        {
+            std::uint64_t wins = 0;
+            std::uint64_t losses = 0;
+            std::uint64_t draws = 0;
+
+            /** Longest distance in plies of a win or loss. */
+            std::uint32_t longest = 0;
+        };
+
+        /**
+         * Prepares an empty table.
+         *
+         * @param max_pieces The most pieces on the board, clamped to
+         * k_max_tablebase_pieces.
+         * @param threads The number of threads scanning positions; 0 picks
+         * one per hardware thread.
+         */
+        explicit tablebase_generator(std::uint32_t max_pieces,
+            std::size_t threads = 0)
+            : layout_(max_pieces)
+            , entries_(static_cast<std::size_t>(layout_.size()), 0)
+        {
+            if (threads == 0)
+                threads = (std::max)(1u, std::thread::hardware_concurrency());
+            if (threads > 1)
+                pool_ = std::make_unique<task_pool>(threads - 1);
+            stats_.reserve(layout_.get_slices().size());
+        }
+
+        // Deleted copy constructor and assignment operator
+        tablebase_generator(const tablebase_generator&) = delete;
+        tablebase_generator& operator=(const tablebase_generator&) = delete;
+
+    public:
+        /**
+         * Gets the layout of the table.
+         *
+         * @return The layout.
+         */
+        const tablebase_layout& get_layout() const noexcept { return layout_; }
+
+        /**
+         * Gets what solving each slice found, in layout order.
+         *
+         * @return One entry per solved slice.
+         */
+        array_view<const slice_stats> get_stats() const noexcept
+        {
+            return { stats_.data(), stats_.size() };
+        }
+
+        /**
+         * Checks whether every slice is solved.
+         *
+         * @return True once the table is complete.
+         */
+        bool is_solved() const noexcept
+        {
+            return stats_.size() == layout_.get_slices().size();
+        }
+
+        /**
+         * Solves the next slice of the layout.
+         *
+         * @return False if every slice was already solved, or if a distance
+         * exceeds k_max_tablebase_plies and the table cannot be completed.
+         */
+        bool solve_next()
+        {
+            if (is_solved() || failed_) return false;
+            const tablebase_slice& slice = layout_.get_slices()[
+                stats_.size()];
+            if (!solve(slice))
+            {
+                failed_ = true;
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Solves every remaining slice.
+         *
+         * @return Whether the whole table was solved.
+         */
+        bool solve_all()
+        {
+            while (solve_next()) {}
+            return is_solved();
+        }
+
+        /**
+         * Looks a position up in the slices solved so far.
+         *
+         * @param board The position.
+         * @return Its value, unknown if it is not covered.
+         */
+        tablebase_value probe(const board_record& board) const noexcept
+        {
+            return probe_tablebase_entries(layout_, entries_.data(), board);
+        }
+
+        /**
+         * Writes the solved table to a tablebase file.
+         *
+         * @param path The path of the file to create or overwrite.
+         * @return True if the table is complete and the file was written.
+         */
+        bool save(const char* path) const
+        {
+            if (!is_solved()) return false;
+            tablebase_file_header header;
+            header.max_pieces = static_cast<std::uint16_t>(
+                layout_.get_max_pieces());
+            header.entry_count = layout_.size();
+            unsigned char bytes[tablebase_file_header::k_size];
+            header.encode(bytes);
+
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+            file.write(reinterpret_cast<const char*>(entries_.data()),
+                static_cast<std::streamsize>(entries_.size()));
+            return static_cast<bool>(file);
+        }
+
+    private:
+        /** Per-position flags used while solving a slice. */
+        static constexpr std::uint8_t k_unused = 1;
+        static constexpr std::uint8_t k_quiet = 2;
+        static constexpr std::uint8_t k_draw_exit = 4;
+        static constexpr std::uint8_t k_win_pending = 8;
+        static constexpr std::uint8_t k_resolved = 16;
+
+        /** Positions scanned by one task. */
+        static constexpr std::uint64_t k_chunk = 1u << 14;
+
+        /**
+         * Working state of the slice being solved, one byte per position.
+         */
+        struct slice_state
+        {
+            /** Quiet moves not yet known to lead to a win of the opponent. */
+            std::vector<std::uint8_t> remaining;
+
+            /** Flags from the k_ constants above. */
+            std::vector<std::uint8_t> flags;
+
+            /**
+             * With k_win_pending, the distance of the win found so far;
+             * otherwise the longest distance of a loss through the moves
+             * already known to lead to a win of the opponent.
+             */
+            std::vector<std::uint8_t> distance;
+
+            /** Set when a distance does not fit an entry. */
+            std::atomic<bool> overflow{ false };
+        };
+
+        /**
+         * Solves one slice, whose exits are all solved.
+         *
+         * @return False if a distance does not fit an entry.
+         */
+        bool solve(const tablebase_slice& slice)
+        {
+            const auto size = static_cast<std::size_t>(slice.size);
+            slice_state state;
+            state.remaining.assign(size, 0);
+            state.flags.assign(size, 0);
+            state.distance.assign(size, 0);
+
+            scan_all(slice, state);
+            if (state.overflow.load(std::memory_order_relaxed)) return false;
+
+            std::vector<std::vector<std::uint64_t>> pending(
+                k_max_tablebase_plies + 1);
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                const std::uint8_t flags = state.flags[i];
+                if (flags & k_unused) continue;
+                if ((flags & k_win_pending) ||
+                    (state.remaining[i] == 0 && !(flags & k_draw_exit)))
+                    pending[state.distance[i]].push_back(i);
+            }
+
+            slice_stats stats;
+            for (std::uint32_t plies = 0; plies <= k_max_tablebase_plies;
+                ++plies)
+            {
+                // Pushes only go to later distances, so the list being read
+                // never grows.
+                for (const std::uint64_t index : pending[plies])
+                {
+                    if (state.flags[index] & k_resolved) continue;
+                    state.flags[index] |= k_resolved;
+                    entries_[slice.offset + index] =
+                        static_cast<std::uint8_t>(plies + 1);
+                    stats.longest = plies;
+                    if (plies % 2 == 1) ++stats.wins;
+                    else ++stats.losses;
+                    if (!resolve(slice, state, index, plies, pending))
+                        return false;
+                }
+                std::vector<std::uint64_t>().swap(pending[plies]);
+            }
+
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                if (!(state.flags[i] & (k_unused | k_resolved)))
+                    ++stats.draws;
+            }
+            stats_.push_back(stats);
+            return true;
+        }
+
+        /**
+         * Scans every position of a slice, in chunks on the pool.
+         */
+        void scan_all(const tablebase_slice& slice, slice_state& state)
+        {
+            const std::uint64_t chunks = (slice.size + k_chunk - 1) / k_chunk;
+            if (!pool_ || chunks < 2)
+            {
+                scan(slice, state, 0, slice.size);
+                return;
+            }
+
+            std::atomic<std::uint64_t> running{ chunks };
+            for (std::uint64_t chunk = 0; chunk < chunks; ++chunk)
+            {
+                const std::uint64_t first = chunk * k_chunk;
+                const std::uint64_t last = (std::min)(first + k_chunk,
+                    slice.size);
+                pool_->submit([this, &slice, &state, first, last, &running] {
+                    scan(slice, state, first, last);
+                    running.fetch_sub(1, std::memory_order_release);
+                });
+            }
+            pool_->wait_until([&] {
+                return running.load(std::memory_order_acquire) == 0;
+            });
+        }
+
+        /**
+         * Scans the moves of a range of positions: counts the quiet ones and
+         * reads the value of the others from the solved slices.
+         */
+        void scan(const tablebase_slice& slice, slice_state& state,
+            std::uint64_t first, std::uint64_t last) const
+        {
+            for (std::uint64_t index = first; index < last; ++index)
+            {
+                board_record board;
+                if (!layout_.board_at(slice, index, board))
+                {
+                    state.flags[index] = k_unused;
+                    continue;
+                }
+
+                std::uint32_t moves = 0;
+                std::uint32_t quiet = 0;
+                std::uint32_t shortest_win = k_max_tablebase_plies + 1;
+                std::uint32_t longest_loss = 0;
+                bool draw = false;
+                move_generator::for_each_move(board,
+                    [&](const board_record& child) {
+                        ++moves;
+                        if (layout_.find_slice(child) == &slice)
+                        {
+                            ++quiet;
+                            return;
+                        }
+                        const tablebase_value value = probe(child);
+                        if (value.result == e_game_result::loss)
+                            shortest_win = (std::min)(shortest_win,
+                                value.plies + 1);
+                        else if (value.result == e_game_result::win)
+                            longest_loss = (std::max)(longest_loss,
+                                value.plies + 1);
+                        else
+                            draw = true;
+                    });
+
+                std::uint8_t flags = 0;
+                std::uint32_t distance = longest_loss;
+                if (quiet > 0) flags |= k_quiet;
+                if (draw) flags |= k_draw_exit;
+                if (shortest_win <= k_max_tablebase_plies)
+                {
+                    flags |= k_win_pending;
+                    distance = shortest_win;
+                }
+                else if (moves > 0 && quiet == 0 && !draw &&
+                    longest_loss > k_max_tablebase_plies)
+                {
+                    state.overflow.store(true, std::memory_order_relaxed);
+                }
+                state.flags[index] = flags;
+                state.remaining[index] = static_cast<std::uint8_t>(quiet);
+                state.distance[index] = static_cast<std::uint8_t>(
+                    (std::min)(distance, k_max_tablebase_plies));
+            }
+        }
+
+        /**
+         * Propagates a position just resolved at a distance to its quiet
+         * predecessors.
+         *
+         * @return False if a distance does not fit an entry.
+         */
+        bool resolve(const tablebase_slice& slice, slice_state& state,
+            std::uint64_t index, std::uint32_t plies,
+            std::vector<std::vector<std::uint64_t>>& pending) const
+        {
+            board_record board;
+            layout_.board_at(slice, index, board);
+            bool fits = true;
+            for_each_unmove(board, [&](const board_record& parent) {
+                const std::uint64_t from = layout_.index_in_slice(slice,
+                    parent);
+                const std::uint8_t flags = state.flags[from];
+                if (!(flags & k_quiet) || (flags & k_resolved)) return;
+
+                if (plies % 2 == 0)
+                {
+                    if ((flags & k_win_pending) &&
+                        state.distance[from] <= plies + 1)
+                        return;
+                    if (plies + 1 > k_max_tablebase_plies)
+                    {
+                        fits = false;
+                        return;
+                    }
+                    state.flags[from] |= k_win_pending;
+                    state.distance[from] = static_cast<std::uint8_t>(
+                        plies + 1);
+                    pending[plies + 1].push_back(from);
+                    return;
+                }
+
+                if (--state.remaining[from] != 0 ||
+                    (flags & (k_draw_exit | k_win_pending)))
+                    return;
+                const std::uint32_t loss = (std::max)(
+                    std::uint32_t{ state.distance[from] }, plies + 1);
+                if (loss > k_max_tablebase_plies)
+                {
+                    fits = false;
+                    return;
+                }
+                pending[loss].push_back(from);
+            });
+            return fits;
+        }
+
+        /**
+         * Calls a visitor with every position from which a quiet step, one
+         * that neither captures nor crowns, leads to a board. The step is
+         * only legal in those positions that have no capture, which the
+         * caller checks.
+         *
+         * @param board The position reached.
+         * @param visit Called as visit(const board_record&) per predecessor.
+         */
+        template<typename Visitor>
+        static void for_each_unmove(const board_record& board,
+            Visitor&& visit)
+        {
+            const std::uint32_t mover = (board.side_to_move & 1) ^ 1;
+            const std::uint32_t own = mover == 0 ? board.player :
+                board.computer;
+            const std::uint32_t empty = ~(board.player | board.computer);
+            for (std::uint32_t pieces = own; pieces; pieces &= pieces - 1)
+            {
+                const std::uint32_t bit = pieces & (0u - pieces);
+                const std::uint32_t square = tablebase_layout::count_squares(
+                    bit - 1);
+                const bool king = (board.kings & bit) != 0;
+
+                // Men only step forward, so they came from behind.
+                const std::uint32_t first = king || mover == 1 ? 0 : 2;
+                const std::uint32_t last = king || mover == 0 ? 4 : 2;
+                for (std::uint32_t d = first; d < last; ++d)
+                {
+                    const std::uint32_t origin =
+                        k_board_geometry.step[square][d];
+                    if (origin == k_board_squares) continue;
+                    const std::uint32_t from = std::uint32_t{ 1 } << origin;
+                    if (!(empty & from)) continue;
+
+                    board_record parent = board;
+                    parent.side_to_move = mover;
+                    (mover == 0 ? parent.player : parent.computer) =
+                        (own & ~bit) | from;
+                    if (king)
+                        parent.kings = (board.kings & ~bit) | from;
+                    visit(parent);
+                }
+            }
+        }
+
+    private:
+        /** The layout of the table. */
+        tablebase_layout layout_;
+
+        /** One entry per position, filled slice by slice. */
+        std::vector<std::uint8_t> entries_;
+
+        /** What solving each slice found. */
+        std::vector<slice_stats> stats_;
+
+        /** Runs the scans; null for a single-threaded generator. */
+        std::unique_ptr<task_pool> pool_;
+
+        /** Set once a slice could not be solved. */
+        bool failed_ = false;
+    };
+
+    /**
+     * An endgame tablebase file mapped into memory. Opening only checks the
+     * header and lays out the slices; a probe ranks the position and reads
+     * one byte, which the operating system pages in on demand.
+     */
+    class endgame_tablebase
+    {
+    public:
+        // Constructor and destructor
+        endgame_tablebase() = default;
+        ~endgame_tablebase() = default;
+
+        // Deleted copy constructor and assignment operator
+        endgame_tablebase(const endgame_tablebase&) = delete;
+        endgame_tablebase& operator=(const endgame_tablebase&) = delete;
+
+    public:
+        /**
+         * Maps a tablebase file, replacing any previously opened one.
+         *
+         * @param path The path of the file to map.
+         * @return True if the file is a valid tablebase file.
+         */
+        bool open(const char* path)
+        {
+            close();
+            tablebase_file_header header;
+            if (!file_.open(path) || !header.decode(file_.data(),
+                file_.size()))
+            {
+                close();
+                return false;
+            }
+            layout_ = std::make_unique<tablebase_layout>(header.max_pieces);
+            if (layout_->size() != header.entry_count)
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Unmaps the file, if any.
+         */
+        void close() noexcept
+        {
+            file_.close();
+            layout_.reset();
+        }
+
+        /**
+         * Checks whether a file is currently mapped.
+         *
+         * @return True if a file is mapped.
+         */
+        bool is_open() const noexcept { return layout_ != nullptr; }
+
+        /**
+         * Gets the most pieces a covered position has.
+         *
+         * @return The piece limit, 0 when no file is open.
+         */
+        std::uint32_t get_max_pieces() const noexcept
+        {
+            return layout_ ? layout_->get_max_pieces() : 0;
+        }
+
+        /**
+         * Looks a position up.
+         *
+         * @param board The position.
+         * @return Its value, unknown if it is not covered.
+         */
+        tablebase_value probe(const board_record& board) const noexcept
+        {
+            if (!layout_) return {};
+            return probe_tablebase_entries(*layout_, file_.data() +
+                tablebase_file_header::k_size, board);
+        }
+
+        /**
+         * Removes the subtrees below every position of a game tree whose
+         * value the table knows, which then needs no further search.
+         *
+         * @param target The tree to cut.
+         * @return The number of nodes removed.
+         */
+        std::size_t cut_tree(tree<board_record>& target) const
+        {
+            return target.prune_if([this](tree_node<board_record>* node) {
+                const tree_node<board_record>* parent = node->get_parent();
+                return parent && probe(parent->get_data()).result !=
+                    e_game_result::unknown;
+            });
+        }
+
+    private:
+        /** The mapped file. */
+        mapped_file file_;
+
+        /** The layout of the open file; null when none is open. */
+        std::unique_ptr<tablebase_layout> layout_;
+    };
+};
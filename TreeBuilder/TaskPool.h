@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tree_builder
+{
+    /**
+     * A small work-stealing thread pool for fork-join style tree algorithms.
+     * Every worker owns a deque of tasks: it pushes and pops its own work at
+     * the back (LIFO, which keeps subtrees hot in its cache) and steals from
+     * the front of the other deques when it runs dry. Threads that are not
+     * part of the pool share one extra deque, and may lend a hand through
+     * wait_until() instead of blocking, which makes nested fork-join safe.
+     */
+    class task_pool
+    {
+    public:
+        using task = std::function<void()>;
+
+        /**
+         * Starts the worker threads.
+         *
+         * @param threads The number of workers; 0 picks one per hardware
+         * thread.
+         */
+        explicit task_pool(std::size_t threads = 0)
+        {
+            if (threads == 0)
+                threads = (std::max)(1u, std::thread::hardware_concurrency());
+
+            queues_.reserve(threads + 1);
+            for (std::size_t i = 0; i < threads + 1; ++i)
+                queues_.push_back(std::make_unique<queue>());
+
+            workers_.reserve(threads);
+            for (std::size_t i = 0; i < threads; ++i)
+                workers_.emplace_back([this, i] { worker_loop(i); });
+        }
+
+        // Deleted copy constructor and assignment operator
+        task_pool(const task_pool&) = delete;
+        task_pool& operator=(const task_pool&) = delete;
+
+        /**
+         * Stops the workers once every queued task has run.
+         */
+        ~task_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_all();
+            for (auto& worker : workers_)
+                worker.join();
+        }
+
+    public:
+        /**
+         * Gets the number of worker threads.
+         *
+         * @return The worker count.
+         */
+        std::size_t size() const noexcept { return workers_.size(); }
+
+        /**
+         * Checks whether some worker is currently waiting for work. Used to
+         * split work lazily, only when someone is there to take it.
+         *
+         * @return True if at least one worker is idle.
+         */
+        bool has_idle_workers() const noexcept
+        {
+            return idle_.load(std::memory_order_relaxed) > 0;
+        }
+
+        /**
+         * Queues a task. When called from a worker the task goes to that
+         * worker's own deque.
+         *
+         * @param work The task to run.
+         */
+        void submit(task work)
+        {
+            // Both counters use sequentially consistent operations so that a
+            // worker going to sleep and a submitter checking for sleepers
+            // can never both miss each other. The count goes up before the
+            // push so that a thief can never take it below zero.
+            queued_.fetch_add(1);
+            queue& target = *queues_[current_queue()];
+            {
+                std::lock_guard<std::mutex> lock(target.mutex);
+                target.tasks.push_back(std::move(work));
+            }
+            if (idle_.load() > 0)
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_);
+                wake_.notify_one();
+            }
+        }
+
+        /**
+         * Runs queued tasks on the calling thread until the predicate holds.
+         *
+         * @param done Returns true once the caller may continue.
+         */
+        template<typename Predicate>
+        void wait_until(Predicate done)
+        {
+            const std::size_t index = current_queue();
+            while (!done())
+            {
+                if (!run_one(index))
+                    std::this_thread::yield();
+            }
+        }
+
+    private:
+        /** A task deque and the lock that guards it. */
+        struct queue
+        {
+            std::mutex mutex;
+            std::deque<task> tasks;
+        };
+
+        /**
+         * Gets the deque owned by the calling thread; threads outside the
+         * pool share the last one.
+         */
+        std::size_t current_queue() const noexcept
+        {
+            return current_pool_ == this ? current_index_ : workers_.size();
+        }
+
+        /**
+         * Pops and runs one task, preferring the given deque.
+         *
+         * @param index The deque of the calling thread.
+         * @return True if a task was run.
+         */
+        bool run_one(std::size_t index)
+        {
+            task work;
+            if (!pop_back(*queues_[index], work))
+            {
+                bool stolen = false;
+                for (std::size_t i = 1; i < queues_.size() && !stolen; ++i)
+                    stolen = pop_front(*queues_[(index + i) % queues_.size()],
+                        work);
+                if (!stolen) return false;
+            }
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            work();
+            return true;
+        }
+
+        static bool pop_back(queue& source, task& work)
+        {
+            std::lock_guard<std::mutex> lock(source.mutex);
+            if (source.tasks.empty()) return false;
+            work = std::move(source.tasks.back());
+            source.tasks.pop_back();
+            return true;
+        }
+
+        static bool pop_front(queue& source, task& work)
+        {
+            std::lock_guard<std::mutex> lock(source.mutex);
+            if (source.tasks.empty()) return false;
+            work = std::move(source.tasks.front());
+            source.tasks.pop_front();
+            return true;
+        }
+
+        /**
+         * Main loop of a worker: run tasks while there are any, then sleep.
+         */
+        void worker_loop(std::size_t index)
+        {
+            current_pool_ = this;
+            current_index_ = index;
+
+            while (true)
+            {
+                if (run_one(index)) continue;
+
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                idle_.fetch_add(1);
+                wake_.wait(lock, [this] {
+                    return stopping_ || queued_.load() > 0;
+                });
+                idle_.fetch_sub(1);
+                if (stopping_ && queued_.load() == 0)
+                    return;
+            }
+        }
+
+    private:
+        /** One deque per worker, plus one for outside threads. */
+        std::vector<std::unique_ptr<queue>> queues_;
+
+        /** The worker threads. */
+        std::vector<std::thread> workers_;
+
+        /** Number of tasks sitting in any deque. */
+        std::atomic<std::size_t> queued_{ 0 };
+
+        /** Number of workers waiting on wake_. */
+        std::atomic<std::size_t> idle_{ 0 };
+
+        /** Guards sleeping and stopping_. */
+        std::mutex sleep_mutex_;
+
+        /** Signaled when work arrives or the pool stops. */
+        std::condition_variable wake_;
+
+        /** Set by the destructor. */
+        bool stopping_ = false;
+
+        /** The pool the calling thread works for, if any. */
+        static inline thread_local const task_pool* current_pool_ = nullptr;
+
+        /** The deque of the calling thread within current_pool_. */
+        static inline thread_local std::size_t current_index_ = 0;
+    };
+
+    /**
+     * Stable-sorts a range using the workers of a pool. The range is cut into
+     * chunks that are sorted concurrently and then merged pairwise, one round
+     * at a time. Every step is stable, so the result is identical to
+     * std::stable_sort with the same comparator.
+     *
+     * @param pool The pool that runs the chunks and merges.
+     * @param first The beginning of the range.
+     * @param last The end of the range.
+     * @param comp The strict weak ordering to sort by.
+     */
+    template<typename RandomIt, typename Compare>
+    void parallel_stable_sort(task_pool& pool, RandomIt first, RandomIt last,
+        Compare comp)
+    {
+        constexpr std::size_t k_min_chunk = 2048;
+
+        const std::size_t count = static_cast<std::size_t>(last - first);
+        const std::size_t chunks = (std::min)(pool.size() + 1,
+            count / k_min_chunk);
+        if (chunks <= 1)
+        {
+            std::stable_sort(first, last, comp);
+            return;
+        }
+
+        std::vector<RandomIt> bounds;
+        bounds.reserve(chunks + 1);
+        for (std::size_t i = 0; i <= chunks; ++i)
+            bounds.push_back(first + count * i / chunks);
+
+        std::atomic<std::size_t> pending{ chunks };
+        for (std::size_t i = 0; i < chunks; ++i)
+        {
+            pool.submit([&, i] {
+                std::stable_sort(bounds[i], bounds[i + 1], comp);
+                pending.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        pool.wait_until([&] {
+            return pending.load(std::memory_order_acquire) == 0;
+        });
+
+        for (std::size_t width = 1; width < chunks; width *= 2)
+        {
+            for (std::size_t i = 0; i + width < chunks; i += 2 * width)
+            {
+                pending.fetch_add(1, std::memory_order_relaxed);
+                const std::size_t end = (std::min)(i + 2 * width, chunks);
+                pool.submit([&, i, width, end] {
+                    std::inplace_merge(bounds[i], bounds[i + width],
+                        bounds[end], comp);
+                    pending.fetch_sub(1, std::memory_order_release);
+                });
+            }
+            pool.wait_until([&] {
+                return pending.load(std::memory_order_acquire) == 0;
+            });
+        }
+    }
+};
@@ -2,10 +2,21 @@
 
 #include <vector>
 #include <memory>
-#include <stack>
-#include <tuple>
+#include <deque>
+#include <atomic>
+#include <type_traits>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
 
 #include "TreeNode.h"
+#include "TreePath.h"
+#include "TreeLevels.h"
+#include "NodeAllocator.h"
+#include "ArrayView.h"
+#include "TaskPool.h"
+#include "TreeStats.h"
+#include "Instrumentation.h"
 
 namespace tree_builder
 {
@@ -16,6 +27,9 @@ namespace tree_builder
      * tree using pre-order, in-order or post-order paths, and transforming the
      * structure of the tree via mirroring or sorting subtrees. It is designed
      * to handle trees with multiple roots (i.e., a forest structure).
+     * Nodes are owned by an allocator that belongs to the tree; depending on
+     * the chosen e_node_allocation they are either individual heap objects or
+     * packed into arena blocks that are released together by clear().
      *
      * @tparam T The type of data stored in each node.
      */
@@ -25,9 +39,29 @@ namespace tree_builder
     public:
         using node_type = tree_node<T>;
 
-        // Constructor and destructor
-        tree() = default;
-        ~tree() = default;
+        /**
+         * Produces the children of a node in lazy mode, by calling add_child
+         * on the node it is given.
+         */
+        using generator_type = std::function<void(node_type*)>;
+
+        /** Expansion depth of a lazy tree without a depth limit. */
+        static constexpr std::uint32_t k_unlimited_depth = UINT32_MAX;
+
+        /**
+         * Constructs an empty tree.
+         *
+         * @param allocation Where the nodes of the tree are allocated from.
+         */
+        explicit tree(e_node_allocation allocation = e_node_allocation::heap)
+            : allocator_(std::make_unique<node_allocator<T>>(allocation)) {}
+
+        // Deleted copy constructor and assignment operator
+        tree(const tree&) = delete;
+        tree& operator=(const tree&) = delete;
+
+        // Destructor
+        ~tree() { clear(); }
 
     public:
         /**
@@ -40,9 +74,12 @@ namespace tree_builder
          */
         node_type* add_root(const T& data)
         {
-              roots_.emplace_back(std::make_unique<node_type>(data,
-                  e_node_kind::root));
-              return roots_.back().get();
+            roots_.reserve(roots_.size() + 1);
+            roots_.push_back(allocator_->create(data, e_node_kind::root));
+            roots_.back()->index_ = static_cast<std::uint32_t>(
+                roots_.size() - 1);
+            allocator_->count_added(roots_.back());
+            return roots_.back();
         }
 
         /**
@@ -54,46 +91,201 @@ namespace tree_builder
          */
         node_type* add_root(T&& data)
         {
-            roots_.emplace_back(std::make_unique<node_type>(std::move(data),
+            roots_.reserve(roots_.size() + 1);
+            roots_.push_back(allocator_->create(std::move(data),
                 e_node_kind::root));
-            return roots_.back().get();
+            roots_.back()->index_ = static_cast<std::uint32_t>(
+                roots_.size() - 1);
+            allocator_->count_added(roots_.back());
+            return roots_.back();
         }
 
         /**
          * Retrieves all root nodes of the tree.
+         * The returned view is invalidated when roots are added or the tree
+         * is cleared.
          *
-         * @return A vector of raw pointers to the root nodes of the tree.
+         * @return A view of raw pointers to the root nodes of the tree.
          */
-        std::vector<node_type*> get_roots() const
+        array_view<node_type* const> get_roots() const noexcept
         {
-            std::vector<node_type*> result;
-            result.reserve(roots_.size());
-            for (const auto& ptr : roots_)
-            {
-                result.push_back(ptr.get());
-            }
-            return result;
+            return { roots_.data(), roots_.size() };
+        }
+
+        /**
+         * Gets the policy used to allocate the nodes of this tree.
+         *
+         * @return The allocation policy.
+         */
+        e_node_allocation get_allocation() const noexcept
+        {
+            return allocator_->get_policy();
+        }
+
+        /**
+         * Gets the shape and memory counters of the tree. They are kept up
+         * to date by every addition and removal of nodes, so this never
+         * walks the tree.
+         *
+         * @return A snapshot of the counters.
+         */
+        tree_stats get_stats() const noexcept
+        {
+            const tree_counters& counters = allocator_->get_counters();
+            tree_stats stats;
+            stats.nodes = static_cast<std::int64_t>(counters.get_nodes());
+            stats.leaves = static_cast<std::int64_t>(counters.get_leaves());
+            stats.roots = static_cast<std::int64_t>(roots_.size());
+            stats.max_depth = counters.get_max_depth();
+            stats.bytes = static_cast<std::int64_t>(allocator_->get_bytes());
+            return stats;
+        }
+
+        /**
+         * Gets the version of the shape of the tree. It changes whenever a
+         * node is added or removed anywhere in the tree, so a structure
+         * derived from the tree can tell that it is stale.
+         *
+         * @return The version number.
+         */
+        std::uint64_t get_version() const noexcept
+        {
+            return allocator_->get_counters().get_version();
+        }
+
+        /**
+         * Gets the number of nodes per fan-out bucket: bucket 0 counts the
+         * leaves and bucket k the nodes with 2^(k-1) up to 2^k - 1 children.
+         * Kept up to date like get_stats().
+         *
+         * @param bucket The bucket, below k_fanout_buckets.
+         * @return The number of nodes in the bucket.
+         */
+        std::size_t get_fanout(std::size_t bucket) const noexcept
+        {
+            return allocator_->get_counters().get_fanout(bucket);
         }
 
         /**
          * Applies a structural transformation to all root subtrees.
-         * This function traverses each subtree from the root and applies the
-         * given transformation type, such as mirroring or sorting.
+         * Mirroring only flips the orientation of the tree in O(1); every
+         * traversal of the tree then presents each child list in reverse.
+         * Sorting traverses each subtree from the root and leaves every node
+         * keeping its children in the requested order, so later add_child
+         * calls insert in order and sorting again skips nodes that are
+         * already sorted. Sorting is stable with respect to the current
+         * (possibly mirrored) order of the children.
          *
          * @param type The transformation operation to apply on each node. Must
          * be one of the values in e_type_of_tree_translation.
          */
         void translate(const e_type_of_tree_translation type)
         {
-            for (auto& root : roots_)
+            TREE_BUILDER_INSTRUMENT(translate);
+            if (type == e_type_of_tree_translation::mirror)
+            {
+                allocator_->set_mirrored(!is_mirrored());
+                return;
+            }
+            for (auto* root : roots_)
+            {
+                translate_node(root, order_children(physical_order(type)));
+            }
+        }
+
+        /**
+         * Applies a structural transformation to all root subtrees using the
+         * workers of a task pool.
+         * Root subtrees are processed concurrently, and a worker hands part of
+         * its pending subtrees to the pool whenever another worker is idle.
+         * Very wide child lists are sorted with parallel_stable_sort. The
+         * result is identical to the sequential overload.
+         *
+         * @param type The transformation operation to apply on each node.
+         * @param pool The pool whose workers perform the transformation.
+         */
+        void translate(const e_type_of_tree_translation type, task_pool& pool)
+        {
+            TREE_BUILDER_INSTRUMENT(translate);
+            if (type == e_type_of_tree_translation::mirror)
+            {
+                allocator_->set_mirrored(!is_mirrored());
+                return;
+            }
+            std::atomic<std::size_t> pending{ 0 };
+            for (auto* root : roots_)
+            {
+                spawn_translate(root, order_children(physical_order(type)),
+                    pool, pending);
+            }
+            pool.wait_until([&] {
+                return pending.load(std::memory_order_acquire) == 0;
+            });
+        }
+
+        /**
+         * Sorts every child list by a key computed from the node data, as
+         * tree_node::sort_children_by does, in the direction given by a
+         * sorting transformation and seen through the orientation of the
+         * tree. The keys are gathered next to the children before sorting,
+         * and integral or enumeration keys are radix sorted. Mirroring
+         * ignores the projection. Sorted nodes become unordered, so later
+         * children are appended.
+         *
+         * @param type The transformation operation to apply on each node.
+         * @param project Maps the data of a node to its key, e.g. a pointer
+         * to a data member.
+         * @param comp The strict weak ordering of the keys.
+         */
+        template<typename Projection, typename Compare = std::less<>>
+        void translate(const e_type_of_tree_translation type,
+            Projection project, Compare comp = {})
+        {
+            TREE_BUILDER_INSTRUMENT(translate);
+            if (type == e_type_of_tree_translation::mirror)
+            {
+                allocator_->set_mirrored(!is_mirrored());
+                return;
+            }
+            const bool descending = physical_order(type) ==
+                e_children_order::descending;
+            const auto sort_node = [&](node_type* node, task_pool*) {
+                node->sort_children_by(project, comp, descending);
+            };
+            for (auto* root : roots_)
             {
-                translate_node(root.get(), type);
+                translate_node(root, sort_node);
             }
         }
 
+        /**
+         * Checks whether the tree is currently mirrored, i.e. whether its
+         * traversals present each node's children in reverse.
+         *
+         * @return True if the tree is mirrored.
+         */
+        bool is_mirrored() const noexcept
+        {
+            return allocator_->is_mirrored();
+        }
+
+        /**
+         * Gets a child of a node as seen through the orientation of the tree.
+         *
+         * @param node A node of this tree.
+         * @param index The position of the child in the tree's orientation.
+         * @return The child, or nullptr if index is out of range.
+         */
+        node_type* get_child(const node_type* node, std::size_t index) const
+            noexcept
+        {
+            return node->get_child(index);
+        }
+
         /**
          * Traverses the tree using the specified traversal strategy.
-         * Supports pre-order, in-order, and post-order traversals.
+         * Supports pre-order, in-order, post-order and level-order
+         * traversals. A lazy tree is walked as it is, without expanding it.
          *
          * @tparam OutputType The type to reinterpret each traversed node as.
          * @param type The type of traversal path to use.
@@ -102,165 +294,506 @@ namespace tree_builder
         template<typename OutputType>
         std::vector<OutputType*> path(e_type_of_path_on_tree type) const
         {
+            TREE_BUILDER_INSTRUMENT(path);
             std::vector<OutputType*> result;
-            for (auto* root : get_roots()) {
-                traverse<OutputType>(root, type, result);
+            for (auto* node : lazy_path(type)) {
+                result.push_back(reinterpret_cast<OutputType*>(node));
             }
             return result;
         }
 
+        /**
+         * Traverses the tree like the const overload. In lazy mode with a
+         * finite expansion depth, the reachable nodes above that depth are
+         * expanded first, shallowest first, until the node budget is
+         * reached: expansion stops there, so the tree never holds more than
+         * the budget plus the children of one node, and the path covers the
+         * generated tree as far as the budget allows. Without an expansion
+         * depth the tree is walked as it is, since a generator may never
+         * end. The nodes returned stay valid until the next call to
+         * expand().
+         *
+         * @tparam OutputType The type to reinterpret each traversed node as.
+         * @param type The type of traversal path to use.
+         * @return A vector of raw pointers to the nodes in traversal order.
+         */
+        template<typename OutputType>
+        std::vector<OutputType*> path(e_type_of_path_on_tree type)
+        {
+            if (generator_ && expansion_depth_ != k_unlimited_depth)
+                expand_reachable();
+            return static_cast<const tree&>(*this).template
+                path<OutputType>(type);
+        }
+
+        /**
+         * Turns on lazy mode, in which the children of a node are produced
+         * by a generator the first time they are asked for through expand()
+         * or path(), or turns it off when the generator is empty. Nodes
+         * keep the children they already have and the generated ones are
+         * added after them.
+         *
+         * @param generator Called once per expanded node to add its
+         * children.
+         * @param max_depth Nodes at this depth or deeper are not expanded by
+         * path(), which expands nothing if the depth is unlimited; expand()
+         * is not limited.
+         */
+        void set_generator(generator_type generator,
+            std::uint32_t max_depth = k_unlimited_depth)
+        {
+            generator_ = std::move(generator);
+            expansion_depth_ = max_depth;
+        }
+
+        /**
+         * Checks whether the tree is in lazy mode.
+         *
+         * @return True if a generator is set.
+         */
+        bool is_lazy() const noexcept { return static_cast<bool>(generator_); }
+
+        /**
+         * Bounds the number of nodes of a lazy tree. Whenever an expansion
+         * goes over the budget, the least recently used expanded nodes are
+         * collapsed, dropping their generated subtrees to be regenerated
+         * when visited again, until a quarter of the budget is free. The
+         * nodes on the path to the node being expanded are never collapsed.
+         * The freed nodes are recycled by the following expansions. A tree
+         * already over the new budget is trimmed at once, every node being
+         * a candidate.
+         *
+         * @param max_nodes The budget, or 0 for no limit.
+         */
+        void set_node_budget(std::size_t max_nodes)
+        {
+            node_budget_ = max_nodes;
+            touch(nullptr);
+            trim();
+        }
+
+        /**
+         * Gets the node budget of a lazy tree.
+         *
+         * @return The budget, or 0 if there is no limit.
+         */
+        std::size_t get_node_budget() const noexcept { return node_budget_; }
+
+        /**
+         * Gets the children of a node, generating them first in lazy mode if
+         * that has not happened yet. Marks the node and its ancestors as
+         * recently used, then enforces the node budget, which may destroy
+         * cold nodes elsewhere in the tree: only this node, its ancestors
+         * and its children are sure to survive the call.
+         *
+         * @param node A node of this tree.
+         * @return A view of the children, in the stored order.
+         */
+        array_view<node_type* const> expand(node_type* node)
+        {
+            if (generator_)
+            {
+                touch(node);
+                if (!node->expanded_) generate(node);
+                trim();
+            }
+            return node->get_children();
+        }
+
+        /**
+         * Drops the children of a node together with their subtrees, so that
+         * a lazy tree generates them again on the next expansion.
+         *
+         * @param node A node of this tree.
+         */
+        void collapse(node_type* node)
+        {
+            auto all = [](node_type*) { return true; };
+            node->prune_children_if(all);
+            node->expanded_ = false;
+        }
+
+        /**
+         * Traverses the tree lazily using the specified traversal strategy.
+         * Nodes are produced one at a time while the returned range is
+         * iterated, in the same order as path(), without building a vector.
+         *
+         * @param type The type of traversal path to use.
+         * @return A forward range over the nodes in traversal order.
+         */
+        tree_path<T> lazy_path(e_type_of_path_on_tree type) const noexcept
+        {
+            return tree_path<T>(get_roots(), type, is_mirrored());
+        }
+
+        /**
+         * Groups the nodes of the tree by depth, each depth being a
+         * contiguous batch in level order.
+         *
+         * @return The nodes of every depth.
+         */
+        tree_levels<T> levels() const
+        {
+            return tree_levels<T>(get_roots(), is_mirrored());
+        }
+
+        /**
+         * Visits every node one depth at a time, in level order.
+         * The next depth is gathered only after the visitor has seen the
+         * whole current one, so the visitor may add children to the node it
+         * is visiting and they are visited in turn.
+         *
+         * @param visit Called as visit(node, depth) for every node.
+         */
+        template<typename Visitor>
+        void for_each_level(Visitor visit)
+        {
+            std::vector<node_type*> level(roots_.begin(), roots_.end());
+            std::vector<node_type*> next;
+            for (std::size_t depth = 0; !level.empty(); ++depth)
+            {
+                for (auto* node : level)
+                    visit(node, depth);
+                gather_next_level(level, next);
+            }
+        }
+
+        /**
+         * Visits every node one depth at a time, spreading each depth over
+         * the workers of a pool. All nodes of a depth are visited before any
+         * node of the next one. The visitor runs concurrently on different
+         * nodes of the same depth; it may read the tree and change the data
+         * of the node it is given, but must not add or remove nodes.
+         *
+         * @param visit Called as visit(node, depth) for every node.
+         * @param pool The pool whose workers run the visitor.
+         */
+        template<typename Visitor>
+        void for_each_level(Visitor visit, task_pool& pool)
+        {
+            std::vector<node_type*> level(roots_.begin(), roots_.end());
+            std::vector<node_type*> next;
+            for (std::size_t depth = 0; !level.empty(); ++depth)
+            {
+                const std::size_t chunk = (std::max)(k_min_level_chunk,
+                    level.size() / (4 * (pool.size() + 1)) + 1);
+                std::atomic<std::size_t> pending{ 0 };
+                for (std::size_t first = chunk; first < level.size();
+                    first += chunk)
+                {
+                    const std::size_t last = (std::min)(first + chunk,
+                        level.size());
+                    pending.fetch_add(1, std::memory_order_relaxed);
+                    pool.submit([&, first, last, depth] {
+                        for (std::size_t i = first; i < last; ++i)
+                            visit(level[i], depth);
+                        pending.fetch_sub(1, std::memory_order_release);
+                    });
+                }
+
+                // The calling thread takes the first chunk itself.
+                for (std::size_t i = 0; i < (std::min)(chunk, level.size());
+                    ++i)
+                    visit(level[i], depth);
+                pool.wait_until([&] {
+                    return pending.load(std::memory_order_acquire) == 0;
+                });
+                gather_next_level(level, next);
+            }
+        }
         
+        /**
+         * Removes, in a single pass over the tree, every node matching a
+         * predicate together with its subtree. Subtrees of removed nodes are
+         * not tested, and the remaining roots and children keep their order.
+         * The freed nodes are recycled by later add_child calls.
+         *
+         * @param pred Called as pred(node) for every node that is still
+         * reachable; returns true to remove it.
+         * @return The number of nodes removed, subtrees included.
+         */
+        template<typename Predicate>
+        std::size_t prune_if(Predicate pred)
+        {
+            const std::size_t before = allocator_->get_counters().get_nodes();
+            std::size_t kept = 0;
+            for (auto* root : roots_)
+            {
+                if (pred(root))
+                {
+                    allocator_->destroy(root);
+                    continue;
+                }
+                root->index_ = static_cast<std::uint32_t>(kept);
+                roots_[kept++] = root;
+                root->prune_if(pred);
+            }
+            roots_.resize(kept);
+            return before - allocator_->get_counters().get_nodes();
+        }
+
         /**
          * Clears the entire tree, removing all root nodes.
-         * All dynamically allocated nodes are deleted.
+         * All dynamically allocated nodes are deleted. In arena mode with a
+         * trivially destructible T no node is visited at all: the arena
+         * blocks are simply released, so the cost depends on the number of
+         * blocks rather than on the number of nodes.
          */
-        void clear() { roots_.clear(); }
+        void clear()
+        {
+            if (!std::is_trivially_destructible_v<T> ||
+                allocator_->get_policy() == e_node_allocation::heap)
+            {
+                allocator_->destroy_all(roots_);
+            }
+            roots_.clear();
+            allocator_->release();
+        }
 
     private:
         /**
-        * Translates a subtree starting from a given root node.
+         * Marks a node and its ancestors as used at a new tick, so that an
+         * ancestor is never colder than its descendants. With no node it
+         * only starts a new tick, leaving every node older than it.
+         *
+         * @param node The node being accessed, or nullptr.
+         */
+        void touch(node_type* node)
+        {
+            if (++tick_ == 0)
+            {
+                // The tick wrapped around: restart every node from zero.
+                for (auto* visited : lazy_path(
+                    e_type_of_path_on_tree::pre_order))
+                    visited->last_use_ = 0;
+                tick_ = 1;
+            }
+            for (; node; node = node->parent_)
+                node->last_use_ = tick_;
+        }
+
+        /**
+         * Calls the generator on a node and marks its children as used at
+         * the current tick. Every child is marked, since sorted insertion
+         * and mirroring may put the new ones anywhere in the array.
+         *
+         * @param node An unexpanded node.
+         */
+        void generate(node_type* node)
+        {
+            generator_(node);
+            node->expanded_ = true;
+            for (auto* child : node->get_children())
+                child->last_use_ = tick_;
+        }
+
+        /**
+         * Expands the reachable nodes above the expansion depth in level
+         * order, marking the whole tree as used at a new tick. Generation
+         * stops once the tree holds its node budget, so the tree goes over
+         * it by the children of one node at most.
+         */
+        void expand_reachable()
+        {
+            touch(nullptr);
+            const tree_counters& counters = allocator_->get_counters();
+            std::vector<node_type*> queue(roots_.begin(), roots_.end());
+            for (std::size_t i = 0; i < queue.size(); ++i)
+            {
+                node_type* node = queue[i];
+                node->last_use_ = tick_;
+                if (!node->expanded_ && node->depth_ < expansion_depth_ &&
+                    (node_budget_ == 0 ||
+                        counters.get_nodes() < node_budget_))
+                    generate(node);
+                for (auto* child : node->get_children())
+                    queue.push_back(child);
+            }
+        }
+
+        /**
+         * Collapses the least recently used expanded nodes while the tree is
+         * over its node budget, down to three quarters of it. Nodes used at
+         * the current tick are kept.
+         */
+        void trim()
+        {
+            const tree_counters& counters = allocator_->get_counters();
+            if (node_budget_ == 0 || counters.get_nodes() <= node_budget_)
+                return;
+
+            std::vector<node_type*> candidates;
+            for (auto* node : lazy_path(e_type_of_path_on_tree::pre_order))
+            {
+                if (node->expanded_ && !node->is_leaf() &&
+                    node->last_use_ != tick_)
+                    candidates.push_back(node);
+            }
+
+            // Descendants are never warmer than their ancestors, and come
+            // first on ties, so a candidate is always collapsed before any
+            // of its ancestors can destroy it.
+            std::sort(candidates.begin(), candidates.end(),
+                [](const node_type* a, const node_type* b) {
+                    if (a->last_use_ != b->last_use_)
+                        return a->last_use_ < b->last_use_;
+                    return a->depth_ > b->depth_;
+                });
+
+            const std::size_t target = node_budget_ - node_budget_ / 4;
+            for (auto* node : candidates)
+            {
+                if (counters.get_nodes() <= target) break;
+                collapse(node);
+            }
+        }
+
+        /**
+         * Replaces a level with the children of its nodes, following the
+         * orientation of the tree.
+         *
+         * @param level The nodes of one depth; receives the next depth.
+         * @param next Scratch storage, left empty.
+         */
+        void gather_next_level(std::vector<node_type*>& level,
+            std::vector<node_type*>& next) const
+        {
+            next.clear();
+            for (auto* node : level)
+            {
+                const auto children = node->get_children();
+                if (is_mirrored())
+                    next.insert(next.end(), children.rbegin(),
+                        children.rend());
+                else
+                    next.insert(next.end(), children.begin(), children.end());
+            }
+            level.swap(next);
+            next.clear();
+        }
+
+        /**
+         * Gets the order children must be stored in so that, seen through the
+         * orientation of the tree, they are sorted as requested. Under a
+         * mirror a stable descending sort of the stored array is exactly a
+         * stable ascending sort of the mirrored view, and vice versa.
+         *
+         * @param type A sorting transformation.
+         * @return The order to store children in.
+         */
+        e_children_order physical_order(e_type_of_tree_translation type) const
+            noexcept
+        {
+            const bool ascending = (type ==
+                e_type_of_tree_translation::sort_ascending) != is_mirrored();
+            return ascending ? e_children_order::ascending :
+                e_children_order::descending;
+        }
+
+        /**
+        * Sorts every child list of a subtree starting from a given root node.
         *
-        * Supported transformations include:
-        * - Mirroring the order of children.
-        * - Sorting children in ascending or descending order.
+        * When a pool is given, every k_split_interval nodes the subtree at the
+        * bottom of the pending stack is handed to the pool if a worker is
+        * idle, and the pool is passed on to sort wide child lists.
         *
         * @param root Pointer to the root node of the subtree to transform.
-        * @param type The type of transformation to apply.
+        * @param sort_node Called as sort_node(node, pool) to sort the
+        * children of each node.
+        * @param pool Optional pool to share the work with.
+        * @param pending Counter of unfinished tasks spawned on the pool.
         */
-        void translate_node(node_type* root, e_type_of_tree_translation type)
+        template<typename SortNode>
+        void translate_node(node_type* root, const SortNode& sort_node,
+            task_pool* pool = nullptr,
+            std::atomic<std::size_t>* pending = nullptr)
         {
             if (!root) return;
 
-            std::stack<node_type*> stack;
-            stack.push(root);
+            std::deque<node_type*> stack;
+            stack.push_back(root);
+            std::size_t visited = 0;
 
             while (!stack.empty()) {
-                node_type* node = stack.top();
-                stack.pop();
-
-                switch (type) {
-                case e_type_of_tree_translation::mirror:
-                    std::reverse(node->children_.begin(), node->children_.end());
-                    break;
-                case e_type_of_tree_translation::sort_ascending:
-                    std::sort(node->children_.begin(), node->children_.end(),
-                        [](auto& a, auto& b) {
-                            return a->data() < b->data();
-                        });
-                    break;
-                case e_type_of_tree_translation::sort_descending:
-                    std::sort(node->children_.begin(), node->children_.end(),
-                        [](auto& a, auto& b) {
-                            return a->data() > b->data();
-                        });
-                    break;
+                node_type* node = stack.back();
+                stack.pop_back();
+
+                sort_node(node, pool);
+
+                auto* const first = node->children_;
+                auto* const last = first + node->children_count_;
+                for (auto* it = last; it != first;)
+                {
+                    stack.push_back(*--it);
                 }
 
-                for (auto it = node->children_.rbegin(); it !=
-                    node->children_.rend(); ++it)
+                if (pool && ++visited % k_split_interval == 0 &&
+                    stack.size() > 1 && pool->has_idle_workers())
                 {
-                    stack.push(it->get());
+                    spawn_translate(stack.front(), sort_node, *pool,
+                        *pending);
+                    stack.pop_front();
                 }
             }
         }
 
         /**
-         * Performs a depth-first traversal of the tree from a given root.
-         * This helper function populates the result vector according to the
-         * specified traversal strategy.
+         * Queues the translation of a subtree on a pool.
          *
-         * @tparam OutputType The type to reinterpret each node pointer as.
-         * @param root The root node of the subtree to traverse.
-         * @param type The traversal order (pre-order, in-order, post-order).
-         * @param result The vector that will store the traversal result.
+         * @param root Pointer to the root node of the subtree to transform.
+         * @param sort_node Sorts the children of one node.
+         * @param pool The pool to run the task on.
+         * @param pending Counter of unfinished tasks, decremented when done.
          */
-        template<typename OutputType>
-        void traverse(node_type* root, e_type_of_path_on_tree type,
-            std::vector<OutputType*>& result) const
+        template<typename SortNode>
+        void spawn_translate(node_type* root, const SortNode& sort_node,
+            task_pool& pool, std::atomic<std::size_t>& pending)
         {
-            if (!root) return;
-
-            using stack_item = std::tuple<node_type*, size_t, bool>;
+            pending.fetch_add(1, std::memory_order_relaxed);
+            pool.submit([this, root, sort_node, &pool, &pending] {
+                translate_node(root, sort_node, &pool, &pending);
+                pending.fetch_sub(1, std::memory_order_release);
+            });
+        }
 
-            switch (type)
-            {
-                case e_type_of_path_on_tree::pre_order:
-                {
-                    std::stack<node_type*> stack;
-                    stack.push(root);
-                    while (!stack.empty())
-                    {
-                        node_type* node = stack.top();
-                        stack.pop();
-                        result.push_back(reinterpret_cast<OutputType*>(node));
-                        auto& children = node->get_children();
-                        for (auto it = children.rbegin(); it != children.rend();
-                            ++it)
-                            stack.push(*it);
-                    }
-                    break;
-                }
-                case e_type_of_path_on_tree::in_order:
-                {
-                    std::stack<stack_item> stack;
-                    stack.emplace(root, 0, false);
-
-                    while (!stack.empty()) {
-                        auto& [node, index, visited] = stack.top();
-                        auto& children = node->get_children();
-                        const size_t mid = children.size() / 2;
-
-                        if (node->is_leaf()) {
-                            result.push_back(reinterpret_cast<OutputType*>(
-                                node));
-                            stack.pop();
-                        }
-                        else if (!visited) {
-                            for (size_t i = children.size(); i-- > mid;)
-                                stack.emplace(children[i], 0, false);
-
-                            stack.top() = std::make_tuple(node, 0, true);
-
-                            for (size_t i = mid; i-- > 0;)
-                                stack.emplace(children[i], 0, false);
-                        }
-                        else {
-                            result.push_back(reinterpret_cast<OutputType*>(
-                                node));
-                            stack.pop();
-                        }
-                    }
-                    break;
-                }
-                case e_type_of_path_on_tree::post_order:
-                {
-                    std::stack<std::pair<node_type*, bool>> stack;
-                    stack.emplace(root, false);
-
-                    while (!stack.empty()) {
-                        auto [node, visited] = stack.top();
-                        stack.pop();
-
-                        if (visited) {
-                            result.push_back(reinterpret_cast<OutputType*>(
-                                node));
-                        }
-                        else {
-                            stack.emplace(node, true);
-                            auto& children = node->get_children();
-                            for (auto it = children.rbegin(); it !=
-                                children.rend(); ++it)
-                                stack.emplace(*it, false);
-                        }
-                    }
-                    break;
-                }
-            }
+        /**
+         * Makes the sorting action that establishes an order on a node, a
+         * no-op for nodes that already keep that order.
+         *
+         * @param order The order to store the children in.
+         * @return The action, for translate_node.
+         */
+        static auto order_children(e_children_order order) noexcept
+        {
+            return [order](node_type* node, task_pool* pool) {
+                node->set_children_order(order, pool);
+            };
         }
 
     private:
+        /** Number of nodes a task visits between two offers to split. */
+        static constexpr std::size_t k_split_interval = 64;
+
+        /** Fewest nodes of a depth a for_each_level task visits. */
+        static constexpr std::size_t k_min_level_chunk = 256;
+
+        /** Allocator that owns every node of the tree. */
+        std::unique_ptr<node_allocator<T>> allocator_;
+
         /** List of root nodes in the tree. */
-        std::vector<std::unique_ptr<node_type>> roots_;
+        std::vector<node_type*> roots_;
+
+        /** Produces the children of nodes in lazy mode; empty otherwise. */
+        generator_type generator_;
+
+        /** Depth from which path() stops expanding a lazy tree. */
+        std::uint32_t expansion_depth_ = k_unlimited_depth;
+
+        /** Most nodes a lazy tree keeps, 0 for no limit. */
+        std::size_t node_budget_ = 0;
+
+        /** Access clock of a lazy tree; see touch(). */
+        std::uint32_t tick_ = 0;
     };    
 };
 
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+#include "Tree.h"
+#include "ArrayView.h"
+
+namespace tree_builder
+{
+    /**
+     * Appends a forest described by flat arrays to a tree.
+     * Node i holds values[i] and hangs below node parents[i], or becomes a
+     * new root when parents[i] is -1. Every parent must come before its
+     * children, which holds for any pre-order or level-order listing. The
+     * arrays are validated before anything is added, so on failure the tree
+     * is left untouched.
+     *
+     * @tparam T The type of data stored in each node.
+     * @param target The tree that receives the nodes.
+     * @param values The value of each node.
+     * @param parents The parent index of each node, -1 for roots.
+     * @param count The number of nodes.
+     * @return True if the nodes were added, false if a parent index is
+     * invalid.
+     */
+    template<typename T>
+    bool append_from_parents(tree<T>& target, const T* values,
+        const std::int32_t* parents, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (parents[i] < -1 || (parents[i] >= 0 &&
+                static_cast<std::size_t>(parents[i]) >= i))
+                return false;
+        }
+
+        std::vector<tree_node<T>*> nodes(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            nodes[i] = parents[i] < 0 ? target.add_root(values[i]) :
+                nodes[parents[i]]->add_child(values[i]);
+        }
+        return true;
+    }
+
+    /**
+     * Writes a traversal of one or more trees into caller-provided arrays.
+     * Entry i of each array describes the i-th node of the path: its value,
+     * the position of its parent within the same arrays (-1 for a root) and
+     * its depth below its root. Any of the arrays may be nullptr to skip it.
+     *
+     * At most capacity entries are written. The return value is always the
+     * full length of the path; when it exceeds capacity the arrays hold a
+     * truncated prefix and the call should be repeated with larger buffers.
+     *
+     * @tparam T The type of data stored in each node.
+     * @param roots The roots of the trees to write, one after another.
+     * @param type The traversal order.
+     * @param values Receives the node values.
+     * @param parents Receives the parent positions.
+     * @param depths Receives the node depths.
+     * @param capacity The number of entries each array can hold.
+     * @param mirrored Whether to walk every child list from the back.
+     * @return The number of nodes in the path.
+     */
+    template<typename T>
+    std::size_t flatten(array_view<tree_node<T>* const> roots,
+        e_type_of_path_on_tree type, T* values, std::int32_t* parents,
+        std::int32_t* depths, std::size_t capacity, bool mirrored = false)
+    {
+        using node_type = tree_node<T>;
+
+        if (type == e_type_of_path_on_tree::level_order)
+        {
+            // Parents always precede their children, so every parent
+            // position is known by the time a child is written.
+            std::vector<std::pair<const node_type*, std::int32_t>> level;
+            std::vector<std::pair<const node_type*, std::int32_t>> next;
+            for (const node_type* root : roots)
+                level.emplace_back(root, -1);
+
+            std::size_t count = 0;
+            for (std::int32_t depth = 0; !level.empty(); ++depth)
+            {
+                for (const auto& [node, parent] : level)
+                {
+                    const auto position = static_cast<std::int32_t>(count++);
+                    if (static_cast<std::size_t>(position) < capacity)
+                    {
+                        if (values) values[position] = node->get_data();
+                        if (parents) parents[position] = parent;
+                        if (depths) depths[position] = depth;
+                    }
+
+                    const auto children = node->get_children();
+                    for (std::size_t i = 0; i < children.size(); ++i)
+                        next.emplace_back(children[mirrored ?
+                            children.size() - 1 - i : i], position);
+                }
+                level.swap(next);
+                next.clear();
+            }
+            return count;
+        }
+
+        // One frame per level of the current branch. A node emitted before
+        // its parent (in-order and post-order) parks its position in
+        // orphans until the parent is emitted and can patch it.
+        struct frame
+        {
+            const node_type* node;
+            std::uint32_t next_child;
+            std::int32_t position;
+            std::size_t first_orphan;
+        };
+
+        std::vector<frame> stack;
+        std::vector<std::int32_t> orphans;
+        std::size_t count = 0;
+
+        auto emit = [&](frame& top) {
+            const auto position = static_cast<std::int32_t>(count++);
+            top.position = position;
+            const bool stored = static_cast<std::size_t>(position) < capacity;
+
+            if (stored && values) values[position] = top.node->get_data();
+            if (stored && depths)
+                depths[position] = static_cast<std::int32_t>(stack.size() - 1);
+
+            for (std::size_t i = top.first_orphan; i < orphans.size(); ++i)
+            {
+                if (parents) parents[orphans[i]] = position;
+            }
+            orphans.resize(top.first_orphan);
+
+            if (stack.size() == 1)
+            {
+                if (stored && parents) parents[position] = -1;
+            }
+            else if (stack[stack.size() - 2].position >= 0)
+            {
+                if (stored && parents)
+                    parents[position] = stack[stack.size() - 2].position;
+            }
+            else if (stored)
+            {
+                orphans.push_back(position);
+            }
+        };
+
+        for (const node_type* root : roots)
+        {
+            stack.push_back({ root, 0, -1, orphans.size() });
+            while (!stack.empty())
+            {
+                frame& top = stack.back();
+                const auto children = top.node->get_children();
+                const std::size_t emit_point =
+                    type == e_type_of_path_on_tree::pre_order ? 0 :
+                    type == e_type_of_path_on_tree::in_order ?
+                    children.size() / 2 : children.size();
+
+                if (top.position < 0 && top.next_child == emit_point)
+                {
+                    emit(top);
+                }
+                else if (top.next_child < children.size())
+                {
+                    const std::size_t index = top.next_child++;
+                    const node_type* child = children[mirrored ?
+                        children.size() - 1 - index : index];
+                    stack.push_back({ child, 0, -1, orphans.size() });
+                }
+                else
+                {
+                    stack.pop_back();
+                }
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Writes a traversal of every tree of a forest into caller-provided
+     * arrays, following the orientation of the tree. See the overload taking
+     * a list of roots.
+     */
+    template<typename T>
+    std::size_t flatten(const tree<T>& source, e_type_of_path_on_tree type,
+        T* values, std::int32_t* parents, std::int32_t* depths,
+        std::size_t capacity)
+    {
+        return flatten<T>(source.get_roots(), type, values, parents, depths,
+            capacity, source.is_mirrored());
+    }
+};
@@ -49,10 +49,86 @@ namespace tree_builder
      * child (Left -> Root -> Right).
      * - post_order: Visits all child nodes before the current node (Left ->
      * Right -> Root).
+     * - level_order: Visits the nodes breadth-first, one depth after another
+     * across every tree of the forest (all roots, then all their children,
+     * and so on), left to right within a depth.
      */
     enum class e_type_of_path_on_tree : uint8_t {
         pre_order,
         in_order,
-        post_order
+        post_order,
+        level_order
     };
-};    
\ No newline at end of file
+
+    /**
+     * Enum representing the order a node keeps its children in.
+     * A node with an order other than unordered inserts every new child at
+     * its sorted position, and translations asking for the order it already
+     * has leave it untouched.
+     *
+     * - unordered: Children stay in insertion order.
+     * - ascending: Children are kept sorted by ascending data.
+     * - descending: Children are kept sorted by descending data.
+     */
+    enum class e_children_order : uint8_t {
+        unordered,
+        ascending,
+        descending
+    };
+
+    /**
+     * Enum representing where the nodes of a tree are allocated from.
+     *
+     * - heap: Every node and child array is an individual heap allocation.
+     * - arena: Nodes and child arrays are carved from contiguous blocks owned
+     * by the tree, which are released all at once when the tree is cleared.
+     */
+    enum class e_node_allocation : uint8_t {
+        heap,
+        arena
+    };
+
+    /**
+     * Enum representing the operations timed by the instrumented build.
+     *
+     * - translate: Calls to tree::translate, with or without a pool.
+     * - path: Calls to tree::path.
+     * - allocate_node: Nodes created by a node_allocator.
+     * - allocate_children: Child arrays allocated by a node_allocator.
+     */
+    enum class e_instrumented_call : uint8_t {
+        translate,
+        path,
+        allocate_node,
+        allocate_children
+    };
+
+    /**
+     * Enum representing what a stored search score says about a position.
+     *
+     * - exact: The score is the value of the position.
+     * - lower: The search failed high; the value is at least the score.
+     * - upper: The search failed low; the value is at most the score.
+     */
+    enum class e_search_bound : uint8_t {
+        exact,
+        lower,
+        upper
+    };
+
+    /**
+     * Enum representing the game-theoretic value of a position for the side
+     * to move, as stored in an endgame tablebase.
+     *
+     * - unknown: The position is not covered.
+     * - win: The side to move wins with best play.
+     * - loss: The side to move loses with best play.
+     * - draw: Neither side can force a win.
+     */
+    enum class e_game_result : uint8_t {
+        unknown,
+        win,
+        loss,
+        draw
+    };
+};
@@ -0,0 +1,503 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include "Tree.h"
+#include "CompactTree.h"
+#include "MappedFile.h"
+#include "ArrayView.h"
+
+namespace tree_builder
+{
+    /**
+     * Fixed-size header at the start of a tree file.
+     * A tree file stores a forest in the pre-order CSR layout of
+     * compact_tree. Every field and array is little-endian, and every
+     * section starts at a multiple of 8 bytes:
+     *
+     * - header (32 bytes): magic "TBTR", version, value size, node count,
+     * root count, child count, then zero padding;
+     * - values: node count values of value size bytes;
+     * - parents: node count uint32, 0xFFFFFFFF for roots;
+     * - child offsets: node count + 1 uint32;
+     * - children: child count uint32;
+     * - roots: root count uint32.
+     */
+    struct tree_file_header
+    {
+        static constexpr unsigned char k_magic[4] = { 'T', 'B', 'T', 'R' };
+        static constexpr std::uint16_t k_version = 1;
+        static constexpr std::size_t k_size = 32;
+
+        std::uint16_t version = k_version;
+        std::uint16_t value_size = 0;
+        std::uint32_t node_count = 0;
+        std::uint32_t root_count = 0;
+        std::uint32_t child_count = 0;
+
+        /** Byte offset of each section, in file order. */
+        std::size_t values_offset() const noexcept { return k_size; }
+
+        std::size_t parents_offset() const noexcept
+        {
+            return align(values_offset() + std::size_t{ node_count } *
+                value_size);
+        }
+
+        std::size_t child_offsets_offset() const noexcept
+        {
+            return align(parents_offset() + std::size_t{ node_count } * 4);
+        }
+
+        std::size_t children_offset() const noexcept
+        {
+            return align(child_offsets_offset() +
+                (std::size_t{ node_count } + 1) * 4);
+        }
+
+        std::size_t roots_offset() const noexcept
+        {
+            return align(children_offset() + std::size_t{ child_count } * 4);
+        }
+
+        std::size_t file_size() const noexcept
+        {
+            return align(roots_offset() + std::size_t{ root_count } * 4);
+        }
+
+        /**
+         * Encodes the header into its on-disk form.
+         *
+         * @param out Receives the k_size header bytes.
+         */
+        void encode(unsigned char* out) const noexcept
+        {
+            std::memset(out, 0, k_size);
+            std::memcpy(out, k_magic, 4);
+            store_le(out + 4, version);
+            store_le(out + 6, value_size);
+            store_le(out + 8, node_count);
+            store_le(out + 12, root_count);
+            store_le(out + 16, child_count);
+        }
+
+        /**
+         * Decodes and validates an on-disk header.
+         *
+         * @param in The header bytes, at least k_size of them.
+         * @param available The number of bytes in the whole file.
+         * @return True if the header is valid and the file is large enough.
+         */
+        bool decode(const unsigned char* in, std::size_t available) noexcept
+        {
+            if (available < k_size || std::memcmp(in, k_magic, 4) != 0)
+                return false;
+            version = load_le<std::uint16_t>(in + 4);
+            value_size = load_le<std::uint16_t>(in + 6);
+            node_count = load_le<std::uint32_t>(in + 8);
+            root_count = load_le<std::uint32_t>(in + 12);
+            child_count = load_le<std::uint32_t>(in + 16);
+            return version == k_version &&
+                root_count <= node_count &&
+                child_count == node_count - root_count &&
+                file_size() <= available;
+        }
+
+        /**
+         * Checks whether the host stores integers little-endian, in which
+         * case the arrays of a file can be used in place.
+         */
+        static bool host_is_little_endian() noexcept
+        {
+            const std::uint16_t probe = 1;
+            unsigned char first;
+            std::memcpy(&first, &probe, 1);
+            return first == 1;
+        }
+
+        /** Writes an arithmetic value as little-endian bytes. */
+        template<typename U>
+        static void store_le(unsigned char* out, U value) noexcept
+        {
+            std::memcpy(out, &value, sizeof(U));
+            if (!host_is_little_endian())
+                std::reverse(out, out + sizeof(U));
+        }
+
+        /** Reads an arithmetic value from little-endian bytes. */
+        template<typename U>
+        static U load_le(const unsigned char* in) noexcept
+        {
+            unsigned char bytes[sizeof(U)];
+            std::memcpy(bytes, in, sizeof(U));
+            if (!host_is_little_endian())
+                std::reverse(bytes, bytes + sizeof(U));
+            U value;
+            std::memcpy(&value, bytes, sizeof(U));
+            return value;
+        }
+
+        /** Rounds a byte offset up to the next multiple of 8. */
+        static std::size_t align(std::size_t offset) noexcept
+        {
+            return (offset + 7) & ~std::size_t{ 7 };
+        }
+    };
+
+    /**
+     * Writes a snapshot to a tree file.
+     *
+     * @tparam T An arithmetic type stored in each node.
+     * @param snapshot The snapshot to write.
+     * @param path The path of the file to create or overwrite.
+     * @return True if the whole file was written.
+     */
+    template<typename T>
+    bool save_tree(const compact_tree<T>& snapshot, const char* path)
+    {
+        static_assert(std::is_arithmetic_v<T>,
+            "tree files only store arithmetic payloads");
+
+        tree_file_header header;
+        header.value_size = sizeof(T);
+        header.node_count = static_cast<std::uint32_t>(snapshot.size());
+        header.root_count = static_cast<std::uint32_t>(
+            snapshot.get_roots().size());
+        header.child_count = header.node_count - header.root_count;
+
+        std::vector<unsigned char> bytes(header.file_size());
+        header.encode(bytes.data());
+
+        auto store_all = [&](std::size_t offset, const auto* first,
+            std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i)
+                tree_file_header::store_le(bytes.data() + offset +
+                    i * sizeof(first[i]), first[i]);
+        };
+        store_all(header.values_offset(), snapshot.values().data(),
+            snapshot.size());
+        store_all(header.parents_offset(), snapshot.parents().data(),
+            snapshot.size());
+        store_all(header.child_offsets_offset(),
+            snapshot.child_offsets().data(), snapshot.size() + 1);
+        store_all(header.children_offset(), snapshot.children().data(),
+            header.child_count);
+        store_all(header.roots_offset(), snapshot.get_roots().data(),
+            header.root_count);
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(bytes.data()),
+            static_cast<std::streamsize>(bytes.size()));
+        return static_cast<bool>(file);
+    }
+
+    /**
+     * Writes a tree to a tree file.
+     *
+     * @tparam T An arithmetic type stored in each node.
+     * @param source The tree to write.
+     * @param path The path of the file to create or overwrite.
+     * @return True if the whole file was written.
+     */
+    template<typename T>
+    bool save_tree(const tree<T>& source, const char* path)
+    {
+        return save_tree(compact_tree<T>(source), path);
+    }
+
+    /**
+     * Reads a tree file and appends its forest to a tree, rebuilding regular
+     * nodes. Works on hosts of any byte order.
+     *
+     * @tparam T An arithmetic type stored in each node.
+     * @param target The tree that receives the nodes.
+     * @param path The path of the file to read.
+     * @return True if the file was valid and its nodes were added.
+     */
+    template<typename T>
+    bool load_tree(tree<T>& target, const char* path)
+    {
+        static_assert(std::is_arithmetic_v<T>,
+            "tree files only store arithmetic payloads");
+
+        mapped_file file;
+        tree_file_header header;
+        if (!file.open(path) || !header.decode(file.data(), file.size()) ||
+            header.value_size != sizeof(T))
+            return false;
+
+        const unsigned char* values = file.data() + header.values_offset();
+        const unsigned char* parents = file.data() + header.parents_offset();
+
+        // Pre-order guarantees that parents precede their children; check it
+        // before adding anything so that a corrupt file leaves target intact.
+        for (std::uint32_t i = 0; i < header.node_count; ++i)
+        {
+            const auto parent = tree_file_header::load_le<std::uint32_t>(
+                parents + i * 4);
+            if (parent != compact_tree<T>::npos && parent >= i)
+                return false;
+        }
+
+        std::vector<tree_node<T>*> nodes(header.node_count);
+        for (std::uint32_t i = 0; i < header.node_count; ++i)
+        {
+            const T value = tree_file_header::load_le<T>(values + i *
+                sizeof(T));
+            const auto parent = tree_file_header::load_le<std::uint32_t>(
+                parents + i * 4);
+            nodes[i] = parent == compact_tree<T>::npos ?
+                target.add_root(value) : nodes[parent]->add_child(value);
+        }
+        return true;
+    }
+
+    /**
+     * A tree file mapped into memory and traversed in place.
+     * Opening only validates the header and the ends of the child offsets:
+     * no node is rebuilt and the arrays are read straight from the mapping,
+     * so the cost of opening does not depend on the size of the tree. The
+     * node accessors check their reads against the array extents, and
+     * path() checks the whole forest first (see verify()), so a corrupt file
+     * never leads reads out of the mapping. It offers the same read
+     * interface as compact_tree. Since the file is little-endian, mapping
+     * requires a little-endian host; load_tree works everywhere.
+     *
+     * @tparam T An arithmetic type stored in each node.
+     */
+    template<typename T>
+    class mapped_tree
+    {
+    public:
+        using index_type = std::uint32_t;
+        using index_range = array_view<const index_type>;
+
+        /** Parent index of root nodes. */
+        static constexpr index_type npos = compact_tree<T>::npos;
+
+        // Constructor and destructor
+        mapped_tree() = default;
+        ~mapped_tree() = default;
+
+    public:
+        /**
+         * Maps a tree file, replacing any previously opened one.
+         *
+         * @param path The path of the file to map.
+         * @return True if the file is a valid tree file for T.
+         */
+        bool open(const char* path)
+        {
+            static_assert(std::is_arithmetic_v<T>,
+                "tree files only store arithmetic payloads");
+
+            close();
+            if (!tree_file_header::host_is_little_endian() ||
+                !file_.open(path) ||
+                !header_.decode(file_.data(), file_.size()) ||
+                header_.value_size != sizeof(T) ||
+                child_offsets()[0] != 0 ||
+                child_offsets()[header_.node_count] != header_.child_count)
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Unmaps the file, if any.
+         */
+        void close() noexcept
+        {
+            file_.close();
+            header_ = tree_file_header();
+        }
+
+        /**
+         * Checks whether a file is currently mapped.
+         *
+         * @return True if a file is mapped.
+         */
+        bool is_open() const noexcept { return file_.is_open(); }
+
+        /**
+         * Gets the number of nodes in the file.
+         *
+         * @return The node count.
+         */
+        std::size_t size() const noexcept { return header_.node_count; }
+
+        /**
+         * Retrieves the indices of the root nodes.
+         *
+         * @return A range over the root indices.
+         */
+        index_range get_roots() const noexcept
+        {
+            return { indices(header_.roots_offset()), header_.root_count };
+        }
+
+        /**
+         * Retrieves the children of a node.
+         *
+         * @param node The index of the node.
+         * @return A range over the indices of the node's children, empty if
+         * node is out of range or its offsets are corrupt.
+         */
+        index_range get_children(index_type node) const noexcept
+        {
+            if (node >= size()) return {};
+            const index_type first = child_offsets()[node];
+            const index_type last = child_offsets()[node + 1];
+            if (first > last || last > header_.child_count) return {};
+            return { indices(header_.children_offset()) + first,
+                last - first };
+        }
+
+        /**
+         * Gets the parent of a node.
+         *
+         * @param node The index of the node.
+         * @return The index of the parent, or npos for a root or if node is
+         * out of range.
+         */
+        index_type get_parent(index_type node) const noexcept
+        {
+            if (node >= size()) return npos;
+            return indices(header_.parents_offset())[node];
+        }
+
+        /**
+         * Gets the data stored in a node.
+         *
+         * @param node The index of the node.
+         * @return Const reference to the node's data inside the mapping, or
+         * to a zero value if node is out of range.
+         */
+        const T& get_data(index_type node) const noexcept
+        {
+            static const T zero{};
+            if (node >= size()) return zero;
+            return values()[node];
+        }
+
+        /**
+         * Checks whether a node has no children.
+         *
+         * @param node The index of the node.
+         * @return True if the node is a leaf.
+         */
+        bool is_leaf(index_type node) const noexcept
+        {
+            return get_children(node).empty();
+        }
+
+        /**
+         * Gets the node values in pre-order, straight from the mapping.
+         *
+         * @return A view over the value array.
+         */
+        array_view<const T> values() const noexcept
+        {
+            return { reinterpret_cast<const T*>(file_.data() +
+                header_.values_offset()), header_.node_count };
+        }
+
+        /**
+         * Checks the whole file in one pass over the index arrays: the child
+         * offsets never decrease, every child and root index is in range
+         * and agrees with the parent array, and walking the forest in
+         * pre-order numbers the nodes 0, 1, 2 and so on, as save_tree lays
+         * them out. Touches every page of the arrays, so it is not part of
+         * open().
+         *
+         * @return True if the arrays describe the forest the header
+         * announces.
+         */
+        bool verify() const
+        {
+            if (!is_open()) return false;
+            const index_type* offsets = child_offsets();
+            const index_type* children = indices(header_.children_offset());
+            const index_type* parents = indices(header_.parents_offset());
+            const std::uint32_t count = header_.node_count;
+
+            // With both ends checked by open(), non-decreasing offsets are
+            // all within the child array.
+            for (index_type node = 0; node < count; ++node)
+            {
+                if (offsets[node] > offsets[node + 1])
+                    return false;
+            }
+
+            // Every pop must be the next pre-order number, so no node is
+            // visited twice and the walk ends after count nodes at most.
+            index_type expected = 0;
+            std::vector<index_type> stack;
+            for (const index_type root : get_roots())
+            {
+                if (root >= count || parents[root] != npos)
+                    return false;
+                stack.push_back(root);
+                while (!stack.empty())
+                {
+                    const index_type node = stack.back();
+                    stack.pop_back();
+                    if (node != expected++)
+                        return false;
+                    for (index_type i = offsets[node + 1];
+                        i-- > offsets[node];)
+                    {
+                        const index_type child = children[i];
+                        if (child >= count || parents[child] != node)
+                            return false;
+                        stack.push_back(child);
+                    }
+                }
+            }
+            return expected == count;
+        }
+
+        /**
+         * Traverses the mapped forest using the specified traversal strategy.
+         * Produces the same order as tree::path on the saved tree. The file
+         * is checked with verify() first, at the same O(n) cost as the
+         * traversal itself.
+         *
+         * @param type The type of traversal path to use.
+         * @return The node indices in traversal order, or an empty path if
+         * the file is corrupt.
+         */
+        std::vector<index_type> path(e_type_of_path_on_tree type) const
+        {
+            if (!verify()) return {};
+            return csr_path(size(), get_roots(), child_offsets(),
+                indices(header_.children_offset()), type);
+        }
+
+    private:
+        const index_type* indices(std::size_t offset) const noexcept
+        {
+            return reinterpret_cast<const index_type*>(file_.data() + offset);
+        }
+
+        const index_type* child_offsets() const noexcept
+        {
+            return indices(header_.child_offsets_offset());
+        }
+
+    private:
+        /** The mapping of the whole file. */
+        mapped_file file_;
+
+        /** The decoded header of the mapped file. */
+        tree_file_header header_;
+    };
+};
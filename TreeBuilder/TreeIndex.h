@@ -0,0 +1,376 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "Tree.h"
+
+namespace tree_builder
+{
+    /**
+     * An index over the shape of a tree answering ancestry queries in
+     * constant time.
+     * Nodes are numbered by their entry time in a pre-order walk, so the
+     * subtree of a node occupies the entry times from its own up to its exit
+     * time (entry plus subtree size). Whether a node is an ancestor of
+     * another is then a range check, and the lowest common ancestor of two
+     * nodes is the parent of the shallowest node strictly after the first
+     * and up to the second in pre-order, found with a sparse table of range
+     * minima over the depths.
+     *
+     * The index records the version of the tree it was built from. Adding
+     * or removing nodes makes it stale (is_current() turns false) until
+     * refresh() rebuilds it; sorting or mirroring does not, since the
+     * ancestry is unchanged. Queries on a stale index are not allowed.
+     *
+     * @tparam T The type of data stored in each node.
+     */
+    template<typename T>
+    class tree_index
+    {
+    public:
+        using index_type = std::uint32_t;
+        using node_type = tree_node<T>;
+
+        /** Returned by lookups of nodes that are not in the index. */
+        static constexpr index_type npos = static_cast<index_type>(-1);
+
+        /**
+         * Builds the index of a tree, which must outlive the index.
+         *
+         * @param source The tree to index.
+         */
+        explicit tree_index(const tree<T>& source) : source_(&source)
+        {
+            rebuild();
+        }
+
+        // Deleted copy constructor and assignment operator
+        tree_index(const tree_index&) = delete;
+        tree_index& operator=(const tree_index&) = delete;
+
+    public:
+        /**
+         * Checks whether the tree still has the shape the index was built
+         * from.
+         *
+         * @return True if queries are allowed.
+         */
+        bool is_current() const noexcept
+        {
+            return version_ == source_->get_version();
+        }
+
+        /**
+         * Rebuilds the index if the tree changed shape since it was built.
+         */
+        void refresh()
+        {
+            if (!is_current()) rebuild();
+        }
+
+        /**
+         * Rebuilds the index from the current shape of the tree. Takes
+         * O(n log n) time and space.
+         */
+        void rebuild()
+        {
+            nodes_.clear();
+            parents_.clear();
+            depths_.clear();
+
+            // Each stack entry carries the entry time of its parent.
+            std::vector<std::pair<node_type*, index_type>> stack;
+            for (node_type* root : source_->get_roots())
+            {
+                stack.emplace_back(root, npos);
+                while (!stack.empty())
+                {
+                    const auto [node, parent] = stack.back();
+                    stack.pop_back();
+                    const auto entry = static_cast<index_type>(nodes_.size());
+                    nodes_.push_back(node);
+                    parents_.push_back(parent);
+                    depths_.push_back(node->get_depth());
+                    const auto children = node->get_children();
+                    for (auto it = children.rbegin(); it != children.rend();
+                        ++it)
+                        stack.emplace_back(*it, entry);
+                }
+            }
+
+            const std::size_t count = nodes_.size();
+            build_positions();
+
+            // Children come after their parent, so a backward pass sees every
+            // subtree complete before adding it to its parent.
+            sizes_.assign(count, 1);
+            for (std::size_t i = count; i-- > 0;)
+            {
+                if (parents_[i] != npos) sizes_[parents_[i]] += sizes_[i];
+            }
+
+            build_sparse_table();
+            version_ = source_->get_version();
+        }
+
+        /**
+         * Gets the number of indexed nodes.
+         *
+         * @return The node count.
+         */
+        std::size_t size() const noexcept { return nodes_.size(); }
+
+        /**
+         * Gets the entry time of a node, which is its position in the index.
+         *
+         * @param node A node of the tree.
+         * @return The entry time, or npos if the node is not indexed.
+         */
+        index_type get_entry(const node_type* node) const noexcept
+        {
+            if (positions_.empty()) return npos;
+            for (std::size_t slot = slot_of(node);;
+                slot = (slot + 1) & (positions_.size() - 1))
+            {
+                const index_type entry = positions_[slot];
+                if (entry == npos || nodes_[entry] == node) return entry;
+            }
+        }
+
+        /**
+         * Gets the node with a given entry time.
+         *
+         * @param entry An entry time below size().
+         * @return The node.
+         */
+        node_type* get_node(index_type entry) const noexcept
+        {
+            return nodes_[entry];
+        }
+
+        /**
+         * Gets the exit time of a node: one past the last entry time in its
+         * subtree.
+         *
+         * @param entry The entry time of the node.
+         * @return The exit time.
+         */
+        index_type get_exit(index_type entry) const noexcept
+        {
+            return entry + sizes_[entry];
+        }
+
+        /**
+         * Gets the number of nodes in the subtree of a node, itself included.
+         *
+         * @param entry The entry time of the node.
+         * @return The subtree size.
+         */
+        index_type get_subtree_size(index_type entry) const noexcept
+        {
+            return sizes_[entry];
+        }
+
+        /**
+         * Gets the depth of a node.
+         *
+         * @param entry The entry time of the node.
+         * @return The depth, 0 for a root.
+         */
+        index_type get_depth(index_type entry) const noexcept
+        {
+            return depths_[entry];
+        }
+
+        /**
+         * Checks whether a node is an ancestor of another. A node counts as
+         * an ancestor of itself.
+         *
+         * @param ancestor The entry time of the presumed ancestor.
+         * @param descendant The entry time of the presumed descendant.
+         * @return True if descendant lies in the subtree of ancestor.
+         */
+        bool is_ancestor(index_type ancestor, index_type descendant) const
+            noexcept
+        {
+            return ancestor <= descendant &&
+                descendant < get_exit(ancestor);
+        }
+
+        /**
+         * Finds the lowest common ancestor of two nodes.
+         *
+         * @param a The entry time of the first node.
+         * @param b The entry time of the second node.
+         * @return The entry time of the deepest node having both in its
+         * subtree, or npos if they belong to different trees.
+         */
+        index_type get_lca(index_type a, index_type b) const noexcept
+        {
+            if (a == b) return a;
+            if (a > b) std::swap(a, b);
+            return parents_[range_min(a + 1, b)];
+        }
+
+        /**
+         * Checks whether a node is an ancestor of another. Both must be
+         * nodes of the tree; see the overload taking entry times.
+         */
+        bool is_ancestor(const node_type* ancestor,
+            const node_type* descendant) const
+        {
+            return is_ancestor(get_entry(ancestor), get_entry(descendant));
+        }
+
+        /**
+         * Finds the lowest common ancestor of two nodes of the tree.
+         *
+         * @param a The first node.
+         * @param b The second node.
+         * @return The lowest common ancestor, or nullptr if the nodes belong
+         * to different trees.
+         */
+        node_type* get_lca(const node_type* a, const node_type* b) const
+        {
+            const index_type lca = get_lca(get_entry(a), get_entry(b));
+            return lca == npos ? nullptr : nodes_[lca];
+        }
+
+        /**
+         * Gets the number of nodes in the subtree of a node of the tree.
+         *
+         * @param node The node.
+         * @return The subtree size, itself included.
+         */
+        index_type get_subtree_size(const node_type* node) const
+        {
+            return get_subtree_size(get_entry(node));
+        }
+
+    private:
+        /**
+         * Fills positions_, an open-addressing hash table from node address
+         * to entry time with linear probing. It is kept at most half full,
+         * so a lookup usually touches a single slot.
+         */
+        void build_positions()
+        {
+            std::size_t capacity = 16;
+            while (capacity < nodes_.size() * 2)
+                capacity *= 2;
+            positions_.assign(capacity, npos);
+            for (std::size_t i = 0; i < nodes_.size(); ++i)
+            {
+                std::size_t slot = slot_of(nodes_[i]);
+                while (positions_[slot] != npos)
+                    slot = (slot + 1) & (capacity - 1);
+                positions_[slot] = static_cast<index_type>(i);
+            }
+        }
+
+        /**
+         * Gets the home slot of a node in positions_, which must not be
+         * empty. Mixes the address with a Fibonacci hash, since node
+         * addresses share their low bits.
+         */
+        std::size_t slot_of(const node_type* node) const noexcept
+        {
+            const auto key = static_cast<std::uint64_t>(
+                reinterpret_cast<std::uintptr_t>(node));
+            return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >>
+                32) & (positions_.size() - 1);
+        }
+
+        /**
+         * Fills table_: level k holds, for every i, the entry time of the
+         * shallowest node among entries i up to i + 2^k - 1.
+         */
+        void build_sparse_table()
+        {
+            const std::size_t count = nodes_.size();
+            table_.clear();
+            if (count == 0) return;
+
+            table_.emplace_back(count);
+            for (std::size_t i = 0; i < count; ++i)
+                table_[0][i] = static_cast<index_type>(i);
+
+            for (std::size_t k = 1; (std::size_t{ 1 } << k) <= count; ++k)
+            {
+                const std::size_t half = std::size_t{ 1 } << (k - 1);
+                const std::size_t width = count - (half << 1) + 1;
+                std::vector<index_type> level(width);
+                const auto& previous = table_[k - 1];
+                for (std::size_t i = 0; i < width; ++i)
+                    level[i] = shallower(previous[i], previous[i + half]);
+                table_.push_back(std::move(level));
+            }
+        }
+
+        /**
+         * Gets the shallowest node among entries first up to last,
+         * inclusive.
+         */
+        index_type range_min(index_type first, index_type last) const
+            noexcept
+        {
+            const std::size_t k = floor_log2(last - first + 1);
+            return shallower(table_[k][first],
+                table_[k][last + 1 - (index_type{ 1 } << k)]);
+        }
+
+        index_type shallower(index_type a, index_type b) const noexcept
+        {
+            return depths_[b] < depths_[a] ? b : a;
+        }
+
+        /** Gets the position of the highest set bit of a non-zero value. */
+        static std::size_t floor_log2(std::uint32_t value) noexcept
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return 31 - __builtin_clz(value);
+#elif defined(_MSC_VER)
+            unsigned long index;
+            _BitScanReverse(&index, value);
+            return index;
+#else
+            std::size_t log = 0;
+            while (value >>= 1)
+                ++log;
+            return log;
+#endif
+        }
+
+    private:
+        /** The indexed tree. */
+        const tree<T>* source_;
+
+        /** Version of the tree when the index was built. */
+        std::uint64_t version_ = 0;
+
+        /** Every node, by entry time. */
+        std::vector<node_type*> nodes_;
+
+        /** Entry time of each node's parent, npos for roots. */
+        std::vector<index_type> parents_;
+
+        /** Depth of each node. */
+        std::vector<index_type> depths_;
+
+        /** Subtree size of each node. */
+        std::vector<index_type> sizes_;
+
+        /** Range-minimum sparse table over depths_, one level per power. */
+        std::vector<std::vector<index_type>> table_;
+
+        /** Hash table of entry times keyed by node address, npos if free. */
+        std::vector<index_type> positions_;
+    };
+};
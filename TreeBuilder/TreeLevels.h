@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include "ArrayView.h"
+#include "TreeNode.h"
+
+namespace tree_builder
+{
+    /**
+     * The nodes of a forest grouped by depth.
+     * Every node is stored once, in level order, in a single array; the
+     * nodes of one depth form a contiguous batch of that array, so a whole
+     * ply can be handed to an evaluator at once. Depth 0 holds the roots.
+     *
+     * The batches are a snapshot: they are not updated when nodes are added
+     * or removed afterwards.
+     *
+     * @tparam T The type of data stored in each node.
+     */
+    template<typename T>
+    class tree_levels
+    {
+    public:
+        using node_type = tree_node<T>;
+        using batch = array_view<node_type* const>;
+
+        // Constructors
+        tree_levels() = default;
+
+        /**
+         * Groups every node below the given roots by depth.
+         *
+         * @param roots The roots of the trees, which make up depth 0.
+         * @param mirrored Whether to walk every child list from the back.
+         */
+        tree_levels(array_view<node_type* const> roots, bool mirrored = false)
+        {
+            nodes_.assign(roots.begin(), roots.end());
+
+            for (std::size_t first = 0; first != nodes_.size();)
+            {
+                const std::size_t last = nodes_.size();
+                offsets_.push_back(last);
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    const auto children = nodes_[i]->get_children();
+                    if (mirrored)
+                        nodes_.insert(nodes_.end(), children.rbegin(),
+                            children.rend());
+                    else
+                        nodes_.insert(nodes_.end(), children.begin(),
+                            children.end());
+                }
+                first = last;
+            }
+        }
+
+    public:
+        /**
+         * Gets the number of depths, i.e. the height of the tallest tree
+         * plus one, or 0 for an empty forest.
+         *
+         * @return The level count.
+         */
+        std::size_t size() const noexcept { return offsets_.size() - 1; }
+
+        /**
+         * Checks whether there are no levels at all.
+         *
+         * @return True if the forest is empty.
+         */
+        bool empty() const noexcept { return nodes_.empty(); }
+
+        /**
+         * Gets the nodes of one depth, left to right.
+         *
+         * @param depth The depth, below size().
+         * @return A view over the nodes at that depth.
+         */
+        batch operator[](std::size_t depth) const noexcept
+        {
+            return { nodes_.data() + offsets_[depth],
+                offsets_[depth + 1] - offsets_[depth] };
+        }
+
+        /**
+         * Gets every node in level order.
+         *
+         * @return A view over all nodes, one depth after another.
+         */
+        batch nodes() const noexcept
+        {
+            return { nodes_.data(), nodes_.size() };
+        }
+
+    private:
+        /** Every node, in level order. */
+        std::vector<node_type*> nodes_;
+
+        /** Start of each depth within nodes_, plus an end marker. */
+        std::vector<std::size_t> offsets_{ 0 };
+    };
+};
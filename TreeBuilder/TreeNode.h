@@ -3,8 +3,15 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <functional>
+#include <utility>
+#include <cstdint>
 
 #include "TreeBuilderData.h"
+#include "NodeAllocator.h"
+#include "ArrayView.h"
+#include "TaskPool.h"
+#include "KeySort.h"
 
 namespace tree_builder
 {   
@@ -23,7 +30,8 @@ namespace tree_builder
     {
     public:
         friend class tree<T>;  /*ste*/
-         using node_type = tree_node<T>;
+        friend class node_allocator<T>;
+        using node_type = tree_node<T>;
 
         /**
          * Constructs a new tree node by copying the given data.
@@ -48,19 +56,31 @@ namespace tree_builder
         tree_node(const tree_node&) = delete;
         tree_node& operator=(const tree_node&) = delete;
 
-        // Defaulted move constructor and move assignment operator
-        tree_node(tree_node&&) noexcept = default;
-        tree_node& operator=(tree_node&&) noexcept = default;
+        // Deleted move constructor and move assignment operator: children
+        // point back at their parent, so a node must never change address.
+        tree_node(tree_node&&) = delete;
+        tree_node& operator=(tree_node&&) = delete;
 
-        // Destructor
-        ~tree_node() = default;
+        /**
+         * Destroys the node together with all of its descendants.
+         */
+        ~tree_node()
+        {
+            allocator_->destroy_children(this);
+            allocator_->release_children(children_, children_capacity_);
+        }
 
     public:    
         /**
          * Adds a new child node with a copy of the given data.
          * This method creates a new child node using the provided data and node
          * kind. The newly created child will have the current node set as its
-         * parent.
+         * parent. If this node keeps its children ordered, the child is
+         * inserted at its sorted position (after any equal children) and
+         * inherits the order for its own children; otherwise it is appended.
+         * Positions are those seen through the orientation of the tree, so
+         * in a mirrored tree an appended child goes to the front of
+         * get_children().
          *
          * @param data The data to be stored in the new child node (copied).
          * @param kind The type of the node (e_node_kind).
@@ -69,17 +89,16 @@ namespace tree_builder
         node_type* add_child(const T& data, e_node_kind kind =
             e_node_kind::internal)
         {
-           children_.emplace_back(std::make_unique<node_type>(data, kind));
-           auto* child = children_.back().get();
-           child->parent_ = this;
-           return child;
+           reserve_children(children_count_ + 1);
+           return insert_child(allocator_->create(data, kind));
         }
 
         /**
          * Adds a new child node by moving the given data.
          * This overload creates a new child node using move semantics to avoid
          * unnecessary copies. The newly created child will have the current
-         * node set as its parent.
+         * node set as its parent and is positioned like in the copying
+         * overload.
          *
          * @param data The data to be moved into the new child node.
          * @param kind The type of the node (e_node_kind).
@@ -88,49 +107,149 @@ namespace tree_builder
         node_type* add_child(T&& data, e_node_kind kind =
             e_node_kind::internal)
         {
-           children_.emplace_back(std::make_unique<node_type>(std::move(data),
-              kind));
-           auto* child = children_.back().get();
-           child->parent_ = this;
-           return child;
+           reserve_children(children_count_ + 1);
+           return insert_child(allocator_->create(std::move(data), kind));
         }
 
         /**
-         * Removes a specific child node from this node.
-         * This function searches for the specified child pointer in the current
-         * node's children. If found, it detaches the child (resets its parent
-         * pointer) and erases it from the list.
+         * Removes a specific child node from this node and destroys it
+         * together with its subtree. The child is found through its stored
+         * index, so only the later children shifting left costs time.
+         * Nothing happens if the node is not a child of this one.
          *
          * @param child A pointer to the child node to be removed.
          */
         void remove_child(node_type* child)
         {
-           auto it = std::find_if(children_.begin(), children_.end(),
-                [&](const std::unique_ptr<node_type>& ptr)
-                { return ptr.get() == child; });
-           if (it != children_.end())
+           if (child && child->parent_ == this)
+               remove_child_at(child->index_);
+        }
+
+        /**
+         * Removes the child at a given index in get_children(), keeping the
+         * order of the others, and destroys it together with its subtree.
+         *
+         * @param index The index of the child, below the child count.
+         */
+        void remove_child_at(std::uint32_t index)
+        {
+           node_type* const child = children_[index];
+           auto* const end = children_ + children_count_;
+           std::move(children_ + index + 1, end, children_ + index);
+           --children_count_;
+           renumber_children(index);
+           allocator_->count_children_changed(children_count_ + 1,
+               children_count_);
+           allocator_->destroy(child);
+        }
+
+        /**
+         * Removes a specific child node in constant time by moving the last
+         * stored child into its place, and destroys it together with its
+         * subtree; in a mirrored tree that is the first child seen. Use it
+         * when the order of the children does not matter; a node that
+         * keeps its children ordered shifts them instead, like
+         * remove_child. Nothing happens if the node is not a child of this
+         * one.
+         *
+         * @param child A pointer to the child node to be removed.
+         */
+        void swap_remove_child(node_type* child)
+        {
+           if (child && child->parent_ == this)
+               swap_remove_child_at(child->index_);
+        }
+
+        /**
+         * Removes the child at a given index in get_children() by moving the
+         * last child into its place; see swap_remove_child.
+         *
+         * @param index The index of the child, below the child count.
+         */
+        void swap_remove_child_at(std::uint32_t index)
+        {
+           if (children_order_ != e_children_order::unordered)
            {
-               (*it)->parent_ = nullptr;
-               children_.erase(it);
+               remove_child_at(index);
+               return;
            }
+           node_type* const child = children_[index];
+           node_type* const last = children_[--children_count_];
+           children_[index] = last;
+           last->index_ = index;
+           allocator_->count_children_changed(children_count_ + 1,
+               children_count_);
+           allocator_->destroy(child);
         }
 
+        /**
+         * Removes, in a single pass, every descendant matching a predicate
+         * together with its subtree. Subtrees of removed nodes are not
+         * tested, and the remaining children keep their order. The walk uses
+         * an explicit stack, so deep trees do not overflow the call stack.
+         *
+         * @param pred Called as pred(node) for every descendant that is still
+         * reachable; returns true to remove it.
+         */
+        template<typename Predicate>
+        void prune_if(Predicate pred)
+        {
+           std::vector<node_type*> stack{ this };
+           while (!stack.empty())
+           {
+               node_type* node = stack.back();
+               stack.pop_back();
+               node->prune_children_if(pred);
+               for (auto* child : node->get_children())
+                   stack.push_back(child);
+           }
+        }
+
+        /**
+         * Gets the index of this node in the child array of its parent, or
+         * among the roots of its tree. It changes when earlier siblings are
+         * removed, when children are inserted before it or when the children
+         * are sorted.
+         *
+         * @return The index, as seen by get_children().
+         */
+        std::uint32_t get_index() const noexcept { return index_; }
+
         /**
          * Retrieves all child nodes of this node.
-         * Returns a vector of raw pointers to each child node in the order they
-         * were added.
+         * Returns a non-owning view over the node's own child array, in the
+         * order they are stored. A mirrored tree presents them in reverse;
+         * see get_child. Nothing is copied or
+         * allocated; the view is invalidated when children are added or
+         * removed.
          *
-         * @return A vector of raw pointers to the current node's children.
+         * @return A view of raw pointers to the current node's children.
          */
-        std::vector<node_type*> get_children() const noexcept
+        array_view<node_type* const> get_children() const noexcept
         {
-           std::vector<node_type*> result;
-           result.reserve(children_.size());
-           for (const auto& ptr : children_)
-            {
-               result.push_back(ptr.get());
-            }
-           return result;
+           return { children_, children_count_ };
+        }
+
+        /**
+         * Checks whether the tree owning this node is mirrored, in which case
+         * its traversals present get_children() in reverse.
+         *
+         * @return True if the tree is mirrored.
+         */
+        bool is_mirrored() const noexcept { return allocator_->is_mirrored(); }
+
+        /**
+         * Gets a child as seen through the orientation of the tree owning
+         * this node; see tree::get_child.
+         *
+         * @param index The position of the child in the tree's orientation.
+         * @return The child, or nullptr if index is out of range.
+         */
+        node_type* get_child(std::size_t index) const noexcept
+        {
+            if (index >= children_count_) return nullptr;
+            return children_[is_mirrored() ? children_count_ - 1 - index :
+                index];
         }
 
         /**
@@ -142,6 +261,8 @@ namespace tree_builder
 
         /**
          * Gets a mutable reference to the data stored in the node.
+         * Changing the data does not move the node among its siblings, even
+         * if its parent keeps its children ordered.
          *
          * @return Reference to the node's data.
          */
@@ -155,12 +276,27 @@ namespace tree_builder
          */
         node_type* get_parent() const noexcept { return parent_; }
 
+        /**
+         * Gets the distance from this node to the root of its tree.
+         *
+         * @return The depth of the node, 0 for a root.
+         */
+        std::uint32_t get_depth() const noexcept { return depth_; }
+
         /**
          * Checks if this node is a leaf (has no children).
          *
          * @return True if the node has no children, false otherwise.
          */
-        bool is_leaf() const noexcept { return children_.empty(); }
+        bool is_leaf() const noexcept { return children_count_ == 0; }
+
+        /**
+         * Checks whether the generator of a lazy tree has produced the
+         * children of this node; see tree::set_generator.
+         *
+         * @return True once the children were generated.
+         */
+        bool is_expanded() const noexcept { return expanded_; }
 
         /**
          * Gets the kind of this node.
@@ -176,17 +312,277 @@ namespace tree_builder
          */
         void set_kind(e_node_kind kind) noexcept { kind_ = kind; }
 
+        /**
+         * Gets the order this node keeps its children in.
+         *
+         * @return The children order.
+         */
+        e_children_order get_children_order() const noexcept
+        {
+            return children_order_;
+        }
+
+        /**
+         * Sorts the children into the given order and keeps them that way on
+         * later insertions. Sorting is stable. When the children are already
+         * in that order nothing happens, and when they are in the opposite
+         * order they are reordered in linear time. Setting unordered only
+         * drops the invariant.
+         *
+         * @param order The order to establish.
+         * @param pool Optional pool used to sort very wide child arrays.
+         */
+        void set_children_order(e_children_order order,
+            task_pool* pool = nullptr)
+        {
+            if (order == children_order_) return;
+
+            auto* const first = children_;
+            auto* const last = children_ + children_count_;
+            const auto ascending = [](node_type* a, node_type* b) {
+                return a->data_ < b->data_;
+            };
+            const auto descending = [](node_type* a, node_type* b) {
+                return b->data_ < a->data_;
+            };
+
+            if (order != e_children_order::unordered &&
+                children_order_ != e_children_order::unordered)
+            {
+                // Already sorted the other way round: reversing gives the
+                // right key order, and reversing each run of equal keys
+                // back restores the stable order of ties.
+                std::reverse(first, last);
+                for (auto* run = first; run != last;)
+                {
+                    auto* run_end = run + 1;
+                    while (run_end != last && !ascending(*run, *run_end) &&
+                        !ascending(*run_end, *run))
+                        ++run_end;
+                    std::reverse(run, run_end);
+                    run = run_end;
+                }
+            }
+            else if (order == e_children_order::ascending)
+            {
+                sort_children(first, last, pool, ascending, false);
+            }
+            else if (order == e_children_order::descending)
+            {
+                sort_children(first, last, pool, descending, true);
+            }
+            if (order != e_children_order::unordered) renumber_children(0);
+            children_order_ = order;
+        }
+
+        /**
+         * Sorts the children stably by a key computed from their data. The
+         * keys are computed once per child and sorted next to the children,
+         * and integral or enumeration keys compared with std::less are
+         * radix sorted (see sort_by_key). Since the order does not follow
+         * the data itself, it is not kept up on later insertions: the node
+         * becomes unordered and new children are appended.
+         *
+         * @param project Maps the data of a child to its key.
+         * @param comp The strict weak ordering of the keys.
+         * @param descending Whether to put the greatest key first.
+         */
+        template<typename Projection, typename Compare = std::less<>>
+        void sort_children_by(Projection project, Compare comp = {},
+            bool descending = false)
+        {
+            auto key_of = [&project](node_type* node) {
+                return std::invoke(project, std::as_const(node->data_));
+            };
+            sort_by_key(children_, children_ + children_count_, key_of, comp,
+                descending);
+            renumber_children(0);
+            children_order_ = e_children_order::unordered;
+        }
+
     private:
+        /**
+         * Makes room for at least the given number of children, growing the
+         * child array to the next power of two.
+         *
+         * @param count The number of children the array must hold.
+         */
+        void reserve_children(std::uint32_t count)
+        {
+            if (count <= children_capacity_) return;
+
+            std::uint32_t capacity = children_capacity_ ? children_capacity_ :
+                k_initial_children_capacity;
+            while (capacity < count)
+                capacity *= 2;
+
+            node_type** children = allocator_->allocate_children(capacity);
+            std::copy(children_, children_ + children_count_, children);
+            allocator_->release_children(children_, children_capacity_);
+            children_ = children;
+            children_capacity_ = capacity;
+        }
+
+        /**
+         * Adds an already created node to the child array, which must have
+         * room for it, at the position required by children_order_. In a
+         * mirrored tree the array is seen from the back, so the child goes
+         * before the stored children it would follow in that view.
+         *
+         * @param child The node to adopt.
+         * @return The adopted node.
+         */
+        node_type* insert_child(node_type* child)
+        {
+            child->parent_ = this;
+            child->depth_ = depth_ + 1;
+            child->children_order_ = children_order_;
+
+            auto* const first = children_;
+            auto* const last = children_ + children_count_;
+            const bool mirrored = is_mirrored();
+            const auto ascending = [](node_type* a, node_type* b) {
+                return a->data_ < b->data_;
+            };
+            const auto descending = [](node_type* a, node_type* b) {
+                return b->data_ < a->data_;
+            };
+            auto* position = mirrored ? first : last;
+            if (children_order_ == e_children_order::ascending)
+            {
+                position = mirrored ?
+                    std::lower_bound(first, last, child, ascending) :
+                    std::upper_bound(first, last, child, ascending);
+            }
+            else if (children_order_ == e_children_order::descending)
+            {
+                position = mirrored ?
+                    std::lower_bound(first, last, child, descending) :
+                    std::upper_bound(first, last, child, descending);
+            }
+            std::move_backward(position, last, last + 1);
+            *position = child;
+            ++children_count_;
+            renumber_children(static_cast<std::uint32_t>(position - first));
+            allocator_->count_children_changed(children_count_ - 1,
+                children_count_);
+            allocator_->count_added(child);
+            return child;
+        }
+
+        /**
+         * Removes the children matching a predicate, destroying their
+         * subtrees, and closes the gaps in one pass.
+         *
+         * @param pred Called as pred(child); returns true to remove it.
+         */
+        template<typename Predicate>
+        void prune_children_if(Predicate& pred)
+        {
+            const std::uint32_t before = children_count_;
+            std::uint32_t kept = 0;
+            for (std::uint32_t i = 0; i < before; ++i)
+            {
+                node_type* const child = children_[i];
+                if (pred(child))
+                {
+                    allocator_->destroy(child);
+                    continue;
+                }
+                child->index_ = kept;
+                children_[kept++] = child;
+            }
+            children_count_ = kept;
+            if (kept != before)
+                allocator_->count_children_changed(before, kept);
+        }
+
+        /**
+         * Refreshes the stored index of every child from a given position
+         * on.
+         *
+         * @param first The first index to refresh.
+         */
+        void renumber_children(std::uint32_t first) noexcept
+        {
+            for (std::uint32_t i = first; i < children_count_; ++i)
+                children_[i]->index_ = i;
+        }
+
+        /**
+         * Sorts a child array stably. Integral payloads are radix sorted once
+         * the array is wide enough, in linear time; other payloads are sorted
+         * in parallel when the array is very wide and a pool is available.
+         *
+         * @param first The first child.
+         * @param last One past the last child.
+         * @param pool Optional pool to sort with.
+         * @param comp The ordering of the children.
+         * @param descending Whether comp puts the greatest data first.
+         */
+        template<typename Compare>
+        static void sort_children(node_type** first, node_type** last,
+            task_pool* pool, Compare comp, bool descending)
+        {
+            if constexpr (is_radix_key_v<T>)
+            {
+                if (static_cast<std::size_t>(last - first) >=
+                    k_radix_sort_threshold)
+                {
+                    auto key_of = [](node_type* node) { return node->data_; };
+                    std::less<> less;
+                    sort_by_key(first, last, key_of, less, descending);
+                    return;
+                }
+            }
+            if (pool && static_cast<std::size_t>(last - first) >=
+                k_parallel_sort_threshold)
+                parallel_stable_sort(*pool, first, last, comp);
+            else
+                std::stable_sort(first, last, comp);
+        }
+
+    private:
+        /** Capacity of a child array when the first child is added. */
+        static constexpr std::uint32_t k_initial_children_capacity = 2;
+
+        /** Minimum number of children for a parallel sort to pay off. */
+        static constexpr std::size_t k_parallel_sort_threshold = 8192;
+
         /** The data stored in this node. */
         T data_;
      
         /** Pointer to the parent node (nullptr if root). */
         node_type* parent_;
+
+        /** Allocator that owns this node and its child array. */
+        node_allocator<T>* allocator_ = &node_allocator<T>::heap();
+
+        /** Array of owned child nodes, allocated from allocator_. */
+        node_type** children_ = nullptr;
+
+        /** Number of children in children_. */
+        std::uint32_t children_count_ = 0;
+
+        /** Number of slots available in children_. */
+        std::uint32_t children_capacity_ = 0;
      
+        /** Distance to the root of the tree. */
+        std::uint32_t depth_ = 0;
+
+        /** Position in the parent's child array, or among the roots. */
+        std::uint32_t index_ = 0;
+
+        /** Tick of the last access in a lazy tree; see tree::expand. */
+        std::uint32_t last_use_ = 0;
+
+        /** Whether a lazy tree has generated the children of this node. */
+        bool expanded_ = false;
+
         /** The kind of the node (internal or leaf). */
         e_node_kind kind_;
-     
-        /** List of owned child nodes. */
-        std::vector<std::unique_ptr<node_type>> children_;
+
+        /** The order the children are kept in. */
+        e_children_order children_order_ = e_children_order::unordered;
     };
 };
\ No newline at end of file
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+
+#include "ArrayView.h"
+#include "TreeNode.h"
+
+namespace tree_builder
+{
+    /**
+     * A lazily evaluated traversal of a tree or of a single subtree.
+     * Iterating the range visits the nodes in the requested order one at a
+     * time. For the depth-first orders each iterator keeps a single explicit
+     * stack with one frame per level of depth; for level order it keeps the
+     * current depth and the next one. Walking a path never materializes the
+     * whole node list and stopping early costs nothing.
+     *
+     * Orders match tree::path: pre-order emits a node before its children,
+     * post-order after them, in-order emits a node between the first half
+     * and the second half of its children, and level order emits every node
+     * of a depth before going one level deeper. A mirrored path walks every
+     * child list from the back.
+     *
+     * @tparam T The type of data stored in each node.
+     */
+    template<typename T>
+    class tree_path
+    {
+    public:
+        using node_type = tree_node<T>;
+
+        /**
+         * Forward iterator over the nodes of a path.
+         */
+        class iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = node_type*;
+            using difference_type = std::ptrdiff_t;
+            using pointer = node_type* const*;
+            using reference = node_type* const&;
+
+            // Constructors
+            iterator() = default;
+
+            iterator(array_view<node_type* const> roots,
+                e_type_of_path_on_tree type, bool mirrored) : roots_(roots),
+                type_(type), mirrored_(mirrored)
+            {
+                if (type_ == e_type_of_path_on_tree::level_order)
+                    level_.assign(roots_.begin(), roots_.end());
+                advance();
+            }
+
+        public:
+            reference operator*() const noexcept { return current_; }
+            pointer operator->() const noexcept { return &current_; }
+
+            iterator& operator++()
+            {
+                advance();
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator copy = *this;
+                advance();
+                return copy;
+            }
+
+            /**
+             * Gets the depth of the current node, relative to the root of
+             * the path (0 for a root).
+             *
+             * @return The depth of the current node.
+             */
+            std::size_t depth() const noexcept
+            {
+                if (type_ == e_type_of_path_on_tree::level_order)
+                    return level_depth_;
+                return stack_.empty() ? 0 : stack_.size() - 1;
+            }
+
+            friend bool operator==(const iterator& a, const iterator& b)
+                noexcept
+            {
+                return a.current_ == b.current_;
+            }
+
+            friend bool operator!=(const iterator& a, const iterator& b)
+                noexcept
+            {
+                return a.current_ != b.current_;
+            }
+
+        private:
+            /** One level of the depth-first walk. */
+            struct frame
+            {
+                node_type* node;
+                std::uint32_t next_child;
+                bool emitted;
+            };
+
+            /**
+             * Gets the number of children that are visited before the node
+             * itself is emitted.
+             */
+            std::size_t emit_point(std::size_t children) const noexcept
+            {
+                switch (type_)
+                {
+                case e_type_of_path_on_tree::pre_order:
+                    return 0;
+                case e_type_of_path_on_tree::in_order:
+                    return children / 2;
+                default:
+                    return children;
+                }
+            }
+
+            /**
+             * Moves to the next node in the path, or to the end.
+             */
+            void advance()
+            {
+                current_ = nullptr;
+                if (type_ == e_type_of_path_on_tree::level_order)
+                {
+                    advance_level();
+                    return;
+                }
+                while (true)
+                {
+                    if (stack_.empty())
+                    {
+                        if (next_root_ == roots_.size()) return;
+                        stack_.push_back({ roots_[next_root_++], 0, false });
+                    }
+
+                    frame& top = stack_.back();
+                    const auto children = top.node->get_children();
+
+                    if (!top.emitted && top.next_child ==
+                        emit_point(children.size()))
+                    {
+                        top.emitted = true;
+                        current_ = top.node;
+                        return;
+                    }
+
+                    if (top.next_child < children.size())
+                    {
+                        const std::size_t index = top.next_child++;
+                        node_type* child = children[mirrored_ ?
+                            children.size() - 1 - index : index];
+                        stack_.push_back({ child, 0, false });
+                    }
+                    else
+                    {
+                        stack_.pop_back();
+                    }
+                }
+            }
+
+            /**
+             * Moves to the next node in level order, or to the end. The
+             * children of a node are queued for the next depth as the node
+             * is emitted.
+             */
+            void advance_level()
+            {
+                if (level_index_ == level_.size())
+                {
+                    if (next_level_.empty()) return;
+                    level_.swap(next_level_);
+                    next_level_.clear();
+                    level_index_ = 0;
+                    ++level_depth_;
+                }
+
+                current_ = level_[level_index_++];
+                const auto children = current_->get_children();
+                if (mirrored_)
+                    next_level_.insert(next_level_.end(), children.rbegin(),
+                        children.rend());
+                else
+                    next_level_.insert(next_level_.end(), children.begin(),
+                        children.end());
+            }
+
+        private:
+            /** Roots of the trees being walked. */
+            array_view<node_type* const> roots_;
+
+            /** Index of the next root to enter. */
+            std::size_t next_root_ = 0;
+
+            /** The traversal order. */
+            e_type_of_path_on_tree type_ = e_type_of_path_on_tree::pre_order;
+
+            /** Whether child lists are walked from the back. */
+            bool mirrored_ = false;
+
+            /** Current branch of the walk, one frame per level. */
+            std::vector<frame> stack_;
+
+            /** Nodes of the depth being emitted, in level order. */
+            std::vector<node_type*> level_;
+
+            /** Children of the nodes of level_ emitted so far. */
+            std::vector<node_type*> next_level_;
+
+            /** Position of the next node to emit within level_. */
+            std::size_t level_index_ = 0;
+
+            /** Depth of the nodes in level_. */
+            std::size_t level_depth_ = 0;
+
+            /** The node the iterator points to, nullptr at the end. */
+            node_type* current_ = nullptr;
+        };
+
+        /**
+         * Constructs a path over every tree rooted at the given nodes.
+         *
+         * @param roots The roots, visited one after another.
+         * @param type The traversal order.
+         * @param mirrored Whether to walk every child list from the back.
+         */
+        tree_path(array_view<node_type* const> roots,
+            e_type_of_path_on_tree type, bool mirrored = false) noexcept
+            : roots_(roots), type_(type), mirrored_(mirrored) {}
+
+        /**
+         * Constructs a path over the subtree rooted at a single node. The
+         * iterators refer back to this range, which must outlive them.
+         *
+         * @param root The root of the subtree.
+         * @param type The traversal order.
+         * @param mirrored Whether to walk every child list from the back.
+         */
+        tree_path(node_type* root, e_type_of_path_on_tree type,
+            bool mirrored = false) noexcept
+            : single_root_(root), type_(type), mirrored_(mirrored) {}
+
+    public:
+        iterator begin() const
+        {
+            if (single_root_)
+                return iterator({ &single_root_, 1 }, type_, mirrored_);
+            return iterator(roots_, type_, mirrored_);
+        }
+
+        iterator end() const noexcept { return iterator(); }
+
+    private:
+        /** Roots of the trees being walked. */
+        array_view<node_type* const> roots_;
+
+        /** Root of the walked subtree, when the path covers just one. */
+        node_type* single_root_ = nullptr;
+
+        /** The traversal order. */
+        e_type_of_path_on_tree type_;
+
+        /** Whether child lists are walked from the back. */
+        bool mirrored_;
+    };
+};
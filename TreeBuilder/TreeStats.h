@@ -0,0 +1,198 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace tree_builder
+{
+    /**
+     * Number of fan-out buckets: bucket 0 counts leaves and bucket k counts
+     * nodes with 2^(k-1) up to 2^k - 1 children.
+     */
+    constexpr std::size_t k_fanout_buckets = 33;
+
+    /**
+     * A snapshot of the shape and memory use of a tree. Plain 64-bit fields
+     * only, so it can cross the C ABI unchanged.
+     */
+    struct tree_stats
+    {
+        /** Number of live nodes. */
+        std::int64_t nodes;
+
+        /** Number of nodes without children. */
+        std::int64_t leaves;
+
+        /** Number of root nodes. */
+        std::int64_t roots;
+
+        /** Depth of the deepest node (0 for a lone root), -1 if empty. */
+        std::int64_t max_depth;
+
+        /** Bytes held by the allocator of the tree for nodes and arrays. */
+        std::int64_t bytes;
+    };
+
+    /**
+     * Shape counters of a tree, kept up to date as nodes come and go so
+     * that reading them never walks the tree. Every update is O(1); the
+     * maximum depth comes from a per-depth node count whose trailing empty
+     * depths are trimmed as the deepest nodes disappear. A version number
+     * changes with every node added or removed, which lets derived
+     * structures detect that they are stale.
+     */
+    class tree_counters
+    {
+    public:
+        /**
+         * Counts a new node, which has no children yet.
+         *
+         * @param depth The depth of the node.
+         */
+        void node_added(std::uint32_t depth)
+        {
+            ++version_;
+            ++nodes_;
+            ++fanout_[0];
+            if (depth < depth_counts_.size())
+                ++depth_counts_[depth];
+            else
+                deepen(depth);
+        }
+
+        /**
+         * Counts the removal of a node, which must have no children left.
+         *
+         * @param depth The depth of the node.
+         */
+        void node_removed(std::uint32_t depth) noexcept
+        {
+            ++version_;
+            --nodes_;
+            --fanout_[0];
+            --depth_counts_[depth];
+            while (!depth_counts_.empty() && depth_counts_.back() == 0)
+                depth_counts_.pop_back();
+        }
+
+        /**
+         * Counts a change in the number of children of a node.
+         *
+         * @param before The previous child count.
+         * @param after The new child count.
+         */
+        void children_changed(std::uint32_t before, std::uint32_t after)
+            noexcept
+        {
+            // Branch-free: whether a count crosses a power of two depends on
+            // the data and would be mispredicted all the time.
+            --fanout_[bucket_of(before)];
+            ++fanout_[bucket_of(after)];
+        }
+
+        /**
+         * Forgets every node at once.
+         */
+        void reset() noexcept
+        {
+            ++version_;
+            nodes_ = 0;
+            depth_counts_.clear();
+            for (auto& bucket : fanout_)
+                bucket = 0;
+        }
+
+        /**
+         * Gets the version of the shape, which changes whenever a node is
+         * added or removed. Reordering children does not change it.
+         *
+         * @return The version number.
+         */
+        std::uint64_t get_version() const noexcept { return version_; }
+
+        /**
+         * Gets the number of live nodes.
+         *
+         * @return The node count.
+         */
+        std::size_t get_nodes() const noexcept { return nodes_; }
+
+        /**
+         * Gets the number of nodes without children.
+         *
+         * @return The leaf count.
+         */
+        std::size_t get_leaves() const noexcept { return fanout_[0]; }
+
+        /**
+         * Gets the depth of the deepest node.
+         *
+         * @return The maximum depth, or -1 if there are no nodes.
+         */
+        std::int64_t get_max_depth() const noexcept
+        {
+            return static_cast<std::int64_t>(depth_counts_.size()) - 1;
+        }
+
+        /**
+         * Gets the number of nodes in a fan-out bucket.
+         *
+         * @param bucket The bucket, below k_fanout_buckets.
+         * @return The number of nodes whose child count falls in it.
+         */
+        std::size_t get_fanout(std::size_t bucket) const noexcept
+        {
+            return fanout_[bucket];
+        }
+
+        /**
+         * Maps a child count to its fan-out bucket.
+         */
+        static std::size_t bucket_of(std::uint32_t children) noexcept
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return children ? 32 - __builtin_clz(children) : 0;
+#elif defined(_MSC_VER)
+            unsigned long index;
+            return _BitScanReverse(&index, children) ? index + 1 : 0;
+#else
+            std::size_t bucket = 0;
+            while (children)
+            {
+                children >>= 1;
+                ++bucket;
+            }
+            return bucket;
+#endif
+        }
+
+    private:
+        /**
+         * Counts a node deeper than every other one, growing the per-depth
+         * counts. Kept out of line since it only runs once per new depth.
+         */
+        void deepen(std::uint32_t depth)
+        {
+            depth_counts_.resize(depth + std::size_t{ 1 }, 0);
+            ++depth_counts_[depth];
+        }
+
+    private:
+        /** Incremented by every change of the shape. */
+        std::uint64_t version_ = 0;
+
+        /** Number of live nodes. */
+        std::size_t nodes_ = 0;
+
+        /** Number of live nodes at each depth, without trailing zeros. */
+        std::vector<std::size_t> depth_counts_;
+
+        /** Number of live nodes in each fan-out bucket. */
+        std::size_t fanout_[k_fanout_buckets] = {};
+    };
+};
@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <vector>
+
+#include "Tree.h"
+
+using namespace tree_builder;
+
+namespace
+{
+    /** Number of failed checks so far. */
+    int failures = 0;
+
+    /**
+     * Records a failed check.
+     *
+     * @param passed The outcome of the check.
+     * @param description What was checked.
+     */
+    void check(bool passed, const char* description)
+    {
+        if (passed) return;
+        std::fprintf(stderr, "FAILED: %s\n", description);
+        ++failures;
+    }
+
+    /**
+     * Gets the values of a tree in pre-order, as its traversals present them.
+     */
+    std::vector<int> pre_order_values(tree<int>& subject)
+    {
+        std::vector<int> values;
+        for (auto* node : subject.path<tree_node<int>>(
+            e_type_of_path_on_tree::pre_order))
+            values.push_back(node->get_data());
+        return values;
+    }
+
+    /**
+     * Gets the values of the children of a node, seen through the
+     * orientation of its tree.
+     */
+    std::vector<int> child_values(const tree_node<int>* node)
+    {
+        std::vector<int> values;
+        for (std::size_t i = 0; i < node->get_children().size(); ++i)
+            values.push_back(node->get_child(i)->get_data());
+        return values;
+    }
+
+    /**
+     * Children added to a mirrored tree come after the existing ones, as
+     * they would after mirroring the child lists in place.
+     */
+    void mirror_then_add()
+    {
+        tree<int> subject;
+        auto* root = subject.add_root(1);
+        root->add_child(2);
+        subject.translate(e_type_of_tree_translation::mirror);
+        root->add_child(3);
+        root->add_child(4);
+
+        check(pre_order_values(subject) == std::vector<int>{ 1, 2, 3, 4 },
+            "mirror then add: pre-order");
+        check(child_values(root) == std::vector<int>{ 2, 3, 4 },
+            "mirror then add: get_child");
+        check(subject.get_child(root, 2) == root->get_child(2),
+            "mirror then add: tree::get_child matches tree_node::get_child");
+
+        subject.translate(e_type_of_tree_translation::mirror);
+        check(pre_order_values(subject) == std::vector<int>{ 1, 4, 3, 2 },
+            "mirror then add: mirrored back");
+    }
+
+    /**
+     * Sorting a mirrored tree orders the children as seen, and children
+     * added afterwards keep that order, after any equal ones.
+     */
+    void mirror_then_sort()
+    {
+        tree<int> subject;
+        auto* root = subject.add_root(0);
+        for (const int value : { 3, 1, 2 })
+            root->add_child(value);
+        subject.translate(e_type_of_tree_translation::mirror);
+        subject.translate(e_type_of_tree_translation::sort_ascending);
+
+        check(child_values(root) == std::vector<int>{ 1, 2, 3 },
+            "mirror then sort: ascending");
+
+        auto* second_two = root->add_child(2);
+        check(child_values(root) == std::vector<int>{ 1, 2, 2, 3 } &&
+            root->get_child(2) == second_two,
+            "mirror then sort: insert after equal children");
+
+        subject.translate(e_type_of_tree_translation::sort_descending);
+        check(child_values(root) == std::vector<int>{ 3, 2, 2, 1 } &&
+            root->get_child(2) == second_two,
+            "mirror then sort: descending keeps equal children in order");
+    }
+}
+
+/**
+ * Runs the checks and returns the number of failures, 0 on success.
+ */
+int main()
+{
+    mirror_then_add();
+    mirror_then_sort();
+
+    if (failures == 0) std::printf("all checks passed\n");
+    return failures;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+
+#include "BoardRecord.h"
+
+namespace tree_builder
+{
+    /**
+     * Random keys of the Zobrist hash of a board: one per kind of piece and
+     * square, and one for the side to move. The kinds are, in order, player
+     * men, player kings, computer men and computer kings.
+     */
+    struct zobrist_keys
+    {
+        /** Key of each kind of piece on each square. */
+        std::uint64_t pieces[4][k_board_squares];
+
+        /** Key present when the computer is to move. */
+        std::uint64_t side;
+    };
+
+    /**
+     * Draws the keys from a fixed splitmix64 sequence, so that hashes are
+     * the same in every build and can be stored in files.
+     *
+     * @return The keys.
+     */
+    constexpr zobrist_keys make_zobrist_keys() noexcept
+    {
+        zobrist_keys keys{};
+        std::uint64_t state = 0x5DEECE66D2024ull;
+        auto next = [&state]() {
+            std::uint64_t value = (state += 0x9E3779B97F4A7C15ull);
+            value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+            value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+            return value ^ (value >> 31);
+        };
+        for (auto& kind : keys.pieces)
+        {
+            for (auto& key : kind)
+                key = next();
+        }
+        keys.side = next();
+        return keys;
+    }
+
+    /** Zobrist keys, computed at compile time. */
+    constexpr zobrist_keys k_zobrist_keys = make_zobrist_keys();
+
+    /**
+     * Gets the bitboard of one kind of piece.
+     *
+     * @param board The board.
+     * @param kind The kind, in the order of zobrist_keys::pieces.
+     * @return The squares holding that kind of piece.
+     */
+    constexpr std::uint32_t pieces_of_kind(const board_record& board,
+        std::uint32_t kind) noexcept
+    {
+        const std::uint32_t side = kind < 2 ? board.player : board.computer;
+        return kind % 2 == 0 ? side & ~board.kings : side & board.kings;
+    }
+
+    /**
+     * Combines the keys of one kind of piece on a set of squares.
+     */
+    constexpr std::uint64_t zobrist_squares(std::uint32_t kind,
+        std::uint32_t squares) noexcept
+    {
+        // De Bruijn multiplication finds the lowest square in a way that
+        // also works in constant expressions.
+        constexpr std::uint8_t k_lowest[32] = {
+            0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+            31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+        };
+        std::uint64_t key = 0;
+        for (; squares; squares &= squares - 1)
+        {
+            const std::uint32_t lowest = squares & (0u - squares);
+            key ^= k_zobrist_keys.pieces[kind][
+                k_lowest[(lowest * 0x077CB531u) >> 27]];
+        }
+        return key;
+    }
+
+    /**
+     * Computes the Zobrist hash of a board from scratch. Equal boards have
+     * equal hashes and different boards almost never collide, unlike a
+     * hash of the printed board.
+     *
+     * @param board The board.
+     * @return The 64-bit hash.
+     */
+    constexpr std::uint64_t zobrist_hash(const board_record& board) noexcept
+    {
+        std::uint64_t key = board.side_to_move & 1 ? k_zobrist_keys.side : 0;
+        for (std::uint32_t kind = 0; kind < 4; ++kind)
+            key ^= zobrist_squares(kind, pieces_of_kind(board, kind));
+        return key;
+    }
+
+    /**
+     * Updates the hash of a board to the hash of a board reached from it,
+     * touching only the squares that changed; a move changes two squares
+     * plus one per captured piece.
+     *
+     * @param key The hash of the first board.
+     * @param from The first board.
+     * @param to The board reached from it.
+     * @return The hash of the second board.
+     */
+    constexpr std::uint64_t zobrist_update(std::uint64_t key,
+        const board_record& from, const board_record& to) noexcept
+    {
+        if ((from.side_to_move ^ to.side_to_move) & 1)
+            key ^= k_zobrist_keys.side;
+        for (std::uint32_t kind = 0; kind < 4; ++kind)
+        {
+            key ^= zobrist_squares(kind, pieces_of_kind(from, kind) ^
+                pieces_of_kind(to, kind));
+        }
+        return key;
+    }
+};
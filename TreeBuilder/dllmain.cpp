@@ -1,8 +1,34 @@
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
 #include <windows.h>
+#define TREE_BUILDER_API __declspec(dllexport)
+#else
+#define TREE_BUILDER_API __attribute__((visibility("default")))
+#endif
 
+#include "BoardRecord.h"
+#include "GameRecord.h"
+#include "MonteCarloSearch.h"
+#include "MoveGenerator.h"
 #include "Tree.h"
 #include "TreeNode.h"
+#include "PersistentTree.h"
+#include "SearchEngine.h"
+#include "SharedTree.h"
+#include "Tablebase.h"
+#include "TaskPool.h"
+#include "TreeArrays.h"
+#include "TreeFile.h"
+#include "TreeIndex.h"
+#include "TreeStats.h"
+#include "Zobrist.h"
+#include "Instrumentation.h"
 
+#ifdef _WIN32
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReserved)
 {
     switch (ul_reason_for_call)
@@ -16,22 +42,23 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReser
 	
     return TRUE;
 }
+#endif
 
 using namespace tree_builder;
 
 // DLL Export Interface
 extern "C" {
-    __declspec(dllexport) tree<int>* start_tree(const int root_value,
+    TREE_BUILDER_API tree<int>* start_tree(const int root_value,
         int translation_type)
     {
-        auto* new_tree = new tree<int>();
+        auto* new_tree = new tree<int>(e_node_allocation::arena);
         new_tree->add_root(root_value);
         new_tree->translate(static_cast<e_type_of_tree_translation>(
             translation_type));
         return new_tree;
     }
 
-    __declspec(dllexport) void translate_tree(tree<int>* tree,
+    TREE_BUILDER_API void translate_tree(tree<int>* tree,
         int translation_type)
     {
         if (tree)
@@ -41,39 +68,833 @@ extern "C" {
         }
     }
 
-    __declspec(dllexport) tree_node<int>* get_first_node(const tree<int>* tree)
+    TREE_BUILDER_API void translate_tree_parallel(tree<int>* tree,
+        int translation_type, int thread_count)
+    {
+        if (tree)
+        {
+            task_pool pool(thread_count > 0 ? thread_count : 0);
+            tree->translate(static_cast<e_type_of_tree_translation>(
+                translation_type), pool);
+        }
+    }
+
+    TREE_BUILDER_API tree_node<int>* get_first_node(const tree<int>* tree)
     {
         if (!tree) return nullptr;
         const auto roots = tree->get_roots();
         return roots.empty() ? nullptr : roots[0];
     }
 
-    __declspec(dllexport) int get_node_value(const tree_node<int>* node)
+    TREE_BUILDER_API int get_node_value(const tree_node<int>* node)
     {
         return node ? node->get_data() : 0;
     }
 
-    __declspec(dllexport) tree_node<int>* add_child(tree_node<int>* parent,
+    TREE_BUILDER_API tree_node<int>* add_child(tree_node<int>* parent,
         const int value)
     {
         return parent->add_child(value);
     }
 
-    __declspec(dllexport) int get_children_count(const tree_node<int>* node)
+    TREE_BUILDER_API int get_children_count(const tree_node<int>* node)
     {
         if (!node) return 0;
         return static_cast<int>(node->get_children().size());
     }
 
-    __declspec(dllexport) tree_node<int>* get_child_at(tree_node<int>* node,
+    TREE_BUILDER_API tree_node<int>* get_child_at(tree_node<int>* node,
         int index)
     {
-        if (!node) return nullptr;
-        const auto& children = node->get_children();
-        if (index < 0 || index >= static_cast<int>(children.size()))
+        if (!node || index < 0) return nullptr;
+        return node->get_child(static_cast<size_t>(index));
+    }
+
+    TREE_BUILDER_API tree_node<int>* get_tree_child_at(tree<int>* tree,
+        tree_node<int>* node, int index)
+    {
+        if (!tree || !node || index < 0) return nullptr;
+        return tree->get_child(node, static_cast<size_t>(index));
+    }
+
+    TREE_BUILDER_API int remove_child_at(tree_node<int>* node, int index,
+        int keep_order)
+    {
+        if (!node || index < 0) return 0;
+        // The index is seen through the orientation of the tree, like
+        // get_child_at; the node methods take the stored position.
+        tree_node<int>* const child = node->get_child(
+            static_cast<size_t>(index));
+        if (!child) return 0;
+        if (keep_order)
+            node->remove_child(child);
+        else
+            node->swap_remove_child(child);
+        return 1;
+    }
+
+    TREE_BUILDER_API int prune_tree(tree<int>* tree,
+        int (*predicate)(int value))
+    {
+        if (!tree || !predicate) return 0;
+        return static_cast<int>(tree->prune_if(
+            [predicate](const tree_node<int>* node) {
+                return predicate(node->get_data()) != 0;
+            }));
+    }
+
+    TREE_BUILDER_API int set_tree_generator(tree<int>* tree,
+        int (*generator)(int value, int* children, int capacity,
+            void* context), void* context, int max_depth)
+    {
+        if (!tree) return 0;
+        if (!generator)
+        {
+            tree->set_generator(nullptr);
+            return 1;
+        }
+        // The callback fills a buffer and returns how many children the
+        // node has; a larger count asks for a second call with more room.
+        tree->set_generator([generator, context](tree_node<int>* node) {
+            std::vector<int> children(16);
+            int count = generator(node->get_data(), children.data(),
+                static_cast<int>(children.size()), context);
+            if (count > static_cast<int>(children.size()))
+            {
+                children.resize(static_cast<size_t>(count));
+                count = (std::min)(count, generator(node->get_data(),
+                    children.data(), count, context));
+            }
+            for (int i = 0; i < count; ++i)
+                node->add_child(children[static_cast<size_t>(i)]);
+        }, max_depth < 0 ? tree_builder::tree<int>::k_unlimited_depth :
+            static_cast<uint32_t>(max_depth));
+        return 1;
+    }
+
+    TREE_BUILDER_API void set_tree_node_budget(tree<int>* tree,
+        int64_t max_nodes)
+    {
+        if (tree && max_nodes >= 0)
+            tree->set_node_budget(static_cast<size_t>(max_nodes));
+    }
+
+    TREE_BUILDER_API int expand_tree_node(tree<int>* tree,
+        tree_node<int>* node)
+    {
+        if (!tree || !node) return 0;
+        return static_cast<int>(tree->expand(node).size());
+    }
+
+    TREE_BUILDER_API void collapse_tree_node(tree<int>* tree,
+        tree_node<int>* node)
+    {
+        if (tree && node) tree->collapse(node);
+    }
+
+    TREE_BUILDER_API tree<int>* build_tree(const int* values,
+        const int* parents, int count)
+    {
+        if (count < 0 || (count > 0 && (!values || !parents))) return nullptr;
+        auto* new_tree = new tree<int>(e_node_allocation::arena);
+        if (!append_from_parents(*new_tree, values, parents,
+            static_cast<size_t>(count)))
+        {
+            delete new_tree;
+            return nullptr;
+        }
+        return new_tree;
+    }
+
+    TREE_BUILDER_API int add_children(tree_node<int>* parent,
+        const int* values, int count)
+    {
+        if (!parent || !values || count <= 0) return 0;
+        for (int i = 0; i < count; ++i)
+            parent->add_child(values[i]);
+        return count;
+    }
+
+    TREE_BUILDER_API int export_tree(const tree<int>* tree, int path_type,
+        int* values, int* parents, int* depths, int capacity)
+    {
+        if (!tree) return 0;
+        return static_cast<int>(flatten(*tree,
+            static_cast<e_type_of_path_on_tree>(path_type), values, parents,
+            depths, capacity > 0 ? static_cast<size_t>(capacity) : 0));
+    }
+
+    TREE_BUILDER_API int export_subtree(tree_node<int>* node,
+        int path_type, int* values, int* parents, int* depths, int capacity)
+    {
+        if (!node) return 0;
+        return static_cast<int>(flatten<int>({ &node, 1 },
+            static_cast<e_type_of_path_on_tree>(path_type), values, parents,
+            depths, capacity > 0 ? static_cast<size_t>(capacity) : 0,
+            node->is_mirrored()));
+    }
+
+    TREE_BUILDER_API int save_tree_file(const tree<int>* tree,
+        const char* path)
+    {
+        if (!tree || !path) return 0;
+        return save_tree(*tree, path) ? 1 : 0;
+    }
+
+    TREE_BUILDER_API tree<int>* load_tree_file(const char* path)
+    {
+        if (!path) return nullptr;
+        auto* new_tree = new tree<int>(e_node_allocation::arena);
+        if (!load_tree(*new_tree, path))
+        {
+            delete new_tree;
+            return nullptr;
+        }
+        return new_tree;
+    }
+
+    TREE_BUILDER_API mapped_tree<int>* open_mapped_tree(const char* path)
+    {
+        if (!path) return nullptr;
+        auto* mapped = new mapped_tree<int>();
+        if (!mapped->open(path))
+        {
+            delete mapped;
+            return nullptr;
+        }
+        return mapped;
+    }
+
+    TREE_BUILDER_API int get_mapped_size(const mapped_tree<int>* mapped)
+    {
+        return mapped ? static_cast<int>(mapped->size()) : 0;
+    }
+
+    TREE_BUILDER_API int get_mapped_root_count(
+        const mapped_tree<int>* mapped)
+    {
+        return mapped ? static_cast<int>(mapped->get_roots().size()) : 0;
+    }
+
+    TREE_BUILDER_API int get_mapped_root_at(
+        const mapped_tree<int>* mapped, int index)
+    {
+        if (!mapped) return -1;
+        const auto roots = mapped->get_roots();
+        if (index < 0 || index >= static_cast<int>(roots.size())) return -1;
+        return static_cast<int>(roots[index]);
+    }
+
+    TREE_BUILDER_API const int* get_mapped_values(
+        const mapped_tree<int>* mapped)
+    {
+        return mapped ? mapped->values().data() : nullptr;
+    }
+
+    TREE_BUILDER_API int get_mapped_value(const mapped_tree<int>* mapped,
+        int node)
+    {
+        if (!mapped || node < 0 || node >= static_cast<int>(mapped->size()))
+            return 0;
+        return mapped->get_data(node);
+    }
+
+    TREE_BUILDER_API int get_mapped_parent(const mapped_tree<int>* mapped,
+        int node)
+    {
+        if (!mapped || node < 0 || node >= static_cast<int>(mapped->size()))
+            return -1;
+        return static_cast<int>(mapped->get_parent(node));
+    }
+
+    TREE_BUILDER_API int get_mapped_children_count(
+        const mapped_tree<int>* mapped, int node)
+    {
+        if (!mapped || node < 0 || node >= static_cast<int>(mapped->size()))
+            return 0;
+        return static_cast<int>(mapped->get_children(node).size());
+    }
+
+    TREE_BUILDER_API int get_mapped_child_at(
+        const mapped_tree<int>* mapped, int node, int index)
+    {
+        if (!mapped || node < 0 || node >= static_cast<int>(mapped->size()))
+            return -1;
+        const auto children = mapped->get_children(node);
+        if (index < 0 || index >= static_cast<int>(children.size())) return -1;
+        return static_cast<int>(children[index]);
+    }
+
+    TREE_BUILDER_API void close_mapped_tree(mapped_tree<int>* mapped)
+    {
+        delete mapped;
+    }
+
+    TREE_BUILDER_API int get_tree_stats(const tree<int>* tree,
+        tree_stats* stats)
+    {
+        if (!tree || !stats) return 0;
+        *stats = tree->get_stats();
+        return 1;
+    }
+
+    TREE_BUILDER_API int get_tree_fanout(const tree<int>* tree,
+        int64_t* buckets, int capacity)
+    {
+        if (!tree) return 0;
+        const size_t count = capacity > 0 && buckets ? (std::min)(
+            static_cast<size_t>(capacity), k_fanout_buckets) : 0;
+        for (size_t i = 0; i < count; ++i)
+            buckets[i] = static_cast<int64_t>(tree->get_fanout(i));
+        return static_cast<int>(k_fanout_buckets);
+    }
+
+    TREE_BUILDER_API int get_instrumentation(int call, int64_t* calls,
+        int64_t* nanoseconds)
+    {
+        if (!instrumentation::enabled() || call < 0 ||
+            call >= static_cast<int>(k_instrumented_calls))
+            return 0;
+        const auto type = static_cast<e_instrumented_call>(call);
+        if (calls)
+            *calls = static_cast<int64_t>(instrumentation::get_calls(type));
+        if (nanoseconds)
+            *nanoseconds = static_cast<int64_t>(
+                instrumentation::get_nanoseconds(type));
+        return 1;
+    }
+
+    TREE_BUILDER_API void reset_instrumentation() { instrumentation::reset(); }
+
+    TREE_BUILDER_API tree_index<int>* build_tree_index(const tree<int>* tree)
+    {
+        if (!tree) return nullptr;
+        return new tree_index<int>(*tree);
+    }
+
+    TREE_BUILDER_API int is_tree_index_current(const tree_index<int>* index)
+    {
+        return index && index->is_current() ? 1 : 0;
+    }
+
+    TREE_BUILDER_API int is_ancestor(tree_index<int>* index,
+        const tree_node<int>* ancestor, const tree_node<int>* descendant)
+    {
+        if (!index) return 0;
+        index->refresh();
+        const auto first = index->get_entry(ancestor);
+        const auto second = index->get_entry(descendant);
+        if (first == tree_index<int>::npos || second == tree_index<int>::npos)
+            return 0;
+        return index->is_ancestor(first, second) ? 1 : 0;
+    }
+
+    TREE_BUILDER_API tree_node<int>* get_lowest_common_ancestor(
+        tree_index<int>* index, const tree_node<int>* a,
+        const tree_node<int>* b)
+    {
+        if (!index) return nullptr;
+        index->refresh();
+        const auto first = index->get_entry(a);
+        const auto second = index->get_entry(b);
+        if (first == tree_index<int>::npos || second == tree_index<int>::npos)
+            return nullptr;
+        const auto lca = index->get_lca(first, second);
+        return lca == tree_index<int>::npos ? nullptr : index->get_node(lca);
+    }
+
+    TREE_BUILDER_API int get_lowest_common_ancestors(tree_index<int>* index,
+        const tree_node<int>* const* a, const tree_node<int>* const* b,
+        tree_node<int>** result, int count)
+    {
+        if (!index || count < 0 || (count > 0 && (!a || !b || !result)))
+            return 0;
+        index->refresh();
+        for (int i = 0; i < count; ++i)
+        {
+            const auto first = index->get_entry(a[i]);
+            const auto second = index->get_entry(b[i]);
+            const auto lca = first == tree_index<int>::npos ||
+                second == tree_index<int>::npos ? tree_index<int>::npos :
+                index->get_lca(first, second);
+            result[i] = lca == tree_index<int>::npos ? nullptr :
+                index->get_node(lca);
+        }
+        return 1;
+    }
+
+    TREE_BUILDER_API int get_subtree_size(tree_index<int>* index,
+        const tree_node<int>* node)
+    {
+        if (!index) return 0;
+        index->refresh();
+        const auto entry = index->get_entry(node);
+        return entry == tree_index<int>::npos ? 0 :
+            static_cast<int>(index->get_subtree_size(entry));
+    }
+
+    TREE_BUILDER_API void delete_tree_index(tree_index<int>* index)
+    {
+        delete index;
+    }
+
+    TREE_BUILDER_API shared_tree<int>* build_shared_tree(
+        const tree<int>* tree)
+    {
+        if (!tree) return nullptr;
+        return new shared_tree<int>(*tree);
+    }
+
+    TREE_BUILDER_API int get_shared_tree_memory(const shared_tree<int>* shared,
+        int64_t* unique_nodes, int64_t* nodes, int64_t* bytes,
+        int64_t* reclaimed_bytes)
+    {
+        if (!shared) return 0;
+        if (unique_nodes) *unique_nodes = static_cast<int64_t>(shared->size());
+        if (nodes) *nodes = static_cast<int64_t>(shared->get_node_count());
+        if (bytes) *bytes = static_cast<int64_t>(shared->get_bytes());
+        if (reclaimed_bytes) *reclaimed_bytes = shared->get_reclaimed_bytes();
+        return 1;
+    }
+
+    TREE_BUILDER_API int export_shared_tree(const shared_tree<int>* shared,
+        int path_type, int* values, int capacity)
+    {
+        if (!shared) return 0;
+        const auto path = shared->path(
+            static_cast<e_type_of_path_on_tree>(path_type));
+        const size_t count = capacity > 0 && values ? (std::min)(
+            static_cast<size_t>(capacity), path.size()) : 0;
+        for (size_t i = 0; i < count; ++i)
+            values[i] = shared->get_data(path[i]);
+        return static_cast<int>(path.size());
+    }
+
+    TREE_BUILDER_API void delete_shared_tree(shared_tree<int>* shared)
+    {
+        delete shared;
+    }
+
+    TREE_BUILDER_API persistent_tree<int>* start_persistent_tree(
+        const int root_value)
+    {
+        return new persistent_tree<int>(
+            persistent_tree<int>().add_root(root_value));
+    }
+
+    TREE_BUILDER_API persistent_tree<int>* persistent_add_child(
+        const persistent_tree<int>* version, const int* location, int length,
+        const int value)
+    {
+        if (!version || !location || length <= 0) return nullptr;
+        std::vector<uint32_t> at(location, location + length);
+        if (std::any_of(location, location + length,
+            [](int index) { return index < 0; }) ||
+            !version->find({ at.data(), at.size() }))
             return nullptr;
-        return children[index];
+        return new persistent_tree<int>(version->add_child(
+            { at.data(), at.size() }, value));
     }
 
-    __declspec(dllexport) void delete_int_tree(tree<int>* tree) { delete tree; }
+    TREE_BUILDER_API persistent_tree<int>* persistent_translate(
+        const persistent_tree<int>* version, int translation_type)
+    {
+        if (!version) return nullptr;
+        return new persistent_tree<int>(version->translate(
+            static_cast<e_type_of_tree_translation>(translation_type)));
+    }
+
+    TREE_BUILDER_API int64_t get_persistent_tree_size(
+        const persistent_tree<int>* version)
+    {
+        return version ? static_cast<int64_t>(version->size()) : 0;
+    }
+
+    TREE_BUILDER_API int export_persistent_tree(
+        const persistent_tree<int>* version, int path_type, int* values,
+        int capacity)
+    {
+        if (!version) return 0;
+        const auto path = version->path(
+            static_cast<e_type_of_path_on_tree>(path_type));
+        const size_t count = capacity > 0 && values ? (std::min)(
+            static_cast<size_t>(capacity), path.size()) : 0;
+        for (size_t i = 0; i < count; ++i)
+            values[i] = path[i]->get_data();
+        return static_cast<int>(path.size());
+    }
+
+    TREE_BUILDER_API void delete_persistent_tree(
+        persistent_tree<int>* version)
+    {
+        delete version;
+    }
+
+    TREE_BUILDER_API void delete_int_tree(tree<int>* tree) { delete tree; }
+
+    TREE_BUILDER_API int encode_board_cells(const char* cells, int side_to_move,
+        board_record* board)
+    {
+        if (!cells || !board || side_to_move < 0 || side_to_move > 1)
+            return 0;
+        *board = tree_builder::encode_board(cells,
+            static_cast<uint32_t>(side_to_move));
+        return 1;
+    }
+
+    TREE_BUILDER_API int decode_board_cells(const board_record* board, char* cells)
+    {
+        if (!board || !cells) return 0;
+        tree_builder::decode_board(*board, cells);
+        return 1;
+    }
+
+    TREE_BUILDER_API tree<board_record>* start_board_tree(
+        const board_record* root, int translation_type)
+    {
+        if (!root) return nullptr;
+        auto* new_tree = new tree<board_record>(e_node_allocation::arena);
+        new_tree->add_root(*root);
+        new_tree->translate(static_cast<e_type_of_tree_translation>(
+            translation_type));
+        return new_tree;
+    }
+
+    TREE_BUILDER_API void translate_board_tree(tree<board_record>* tree,
+        int translation_type)
+    {
+        if (tree)
+        {
+            tree->translate(static_cast<e_type_of_tree_translation>(
+                translation_type));
+        }
+    }
+
+    TREE_BUILDER_API tree_node<board_record>* get_first_board_node(
+        const tree<board_record>* tree)
+    {
+        if (!tree) return nullptr;
+        const auto roots = tree->get_roots();
+        return roots.empty() ? nullptr : roots[0];
+    }
+
+    TREE_BUILDER_API const board_record* get_node_board(
+        const tree_node<board_record>* node)
+    {
+        return node ? &node->get_data() : nullptr;
+    }
+
+    TREE_BUILDER_API tree_node<board_record>* add_board_child(
+        tree_node<board_record>* parent, const board_record* board)
+    {
+        if (!parent || !board) return nullptr;
+        return parent->add_child(*board);
+    }
+
+    TREE_BUILDER_API int add_board_children(tree_node<board_record>* parent,
+        const board_record* boards, int count)
+    {
+        if (!parent || !boards || count <= 0) return 0;
+        for (int i = 0; i < count; ++i)
+            parent->add_child(boards[i]);
+        return count;
+    }
+
+    TREE_BUILDER_API int get_board_children_count(
+        const tree_node<board_record>* node)
+    {
+        if (!node) return 0;
+        return static_cast<int>(node->get_children().size());
+    }
+
+    TREE_BUILDER_API tree_node<board_record>* get_board_tree_child_at(
+        tree<board_record>* tree, tree_node<board_record>* node, int index)
+    {
+        if (!tree || !node || index < 0) return nullptr;
+        return tree->get_child(node, static_cast<size_t>(index));
+    }
+
+    TREE_BUILDER_API void delete_board_tree(tree<board_record>* tree)
+    {
+        delete tree;
+    }
+
+    TREE_BUILDER_API int generate_board_moves(const board_record* board,
+        board_record* moves, int capacity)
+    {
+        if (!board) return 0;
+        int count = 0;
+        move_generator::for_each_move(*board, [&](const board_record& child) {
+            if (moves && count < capacity) moves[count] = child;
+            ++count;
+        });
+        return count;
+    }
+
+    TREE_BUILDER_API int add_board_moves(tree_node<board_record>* node)
+    {
+        if (!node) return 0;
+        return static_cast<int>(move_generator::add_moves(node));
+    }
+
+    TREE_BUILDER_API int64_t expand_board_tree(tree<board_record>* tree)
+    {
+        if (!tree) return 0;
+        return static_cast<int64_t>(move_generator::expand_leaves(*tree));
+    }
+
+    TREE_BUILDER_API int64_t board_perft(const board_record* board, int depth)
+    {
+        if (!board || depth < 0) return 0;
+        return static_cast<int64_t>(move_generator::perft(*board,
+            static_cast<uint32_t>(depth)));
+    }
+
+    TREE_BUILDER_API uint64_t get_board_hash(const board_record* board)
+    {
+        return board ? zobrist_hash(*board) : 0;
+    }
+
+    TREE_BUILDER_API search_engine* create_search_engine(
+        int64_t table_megabytes, int threads)
+    {
+        if (table_megabytes <= 0 || threads < 0) return nullptr;
+        return new search_engine(static_cast<size_t>(table_megabytes) << 20,
+            static_cast<size_t>(threads));
+    }
+
+    TREE_BUILDER_API tree<board_record>* search_board(search_engine* engine,
+        const board_record* board, int milliseconds, int max_depth,
+        int64_t* score, int64_t* depth, int64_t* nodes)
+    {
+        if (!engine || !board || milliseconds < 0 || max_depth <= 0)
+            return nullptr;
+        const search_result result = engine->search(*board,
+            std::chrono::milliseconds(milliseconds),
+            static_cast<uint32_t>(max_depth));
+        if (score) *score = result.score;
+        if (depth) *depth = result.depth;
+        if (nodes) *nodes = static_cast<int64_t>(result.nodes);
+        auto* search_tree = new tree<board_record>(e_node_allocation::arena);
+        search_engine::build_search_tree(*board, result, *search_tree);
+        return search_tree;
+    }
+
+    TREE_BUILDER_API void clear_search_engine(search_engine* engine)
+    {
+        if (engine) engine->clear();
+    }
+
+    TREE_BUILDER_API void delete_search_engine(search_engine* engine)
+    {
+        delete engine;
+    }
+
+    TREE_BUILDER_API mcts_engine* create_mcts_engine(int threads)
+    {
+        if (threads < 0) return nullptr;
+        return new mcts_engine(static_cast<size_t>(threads));
+    }
+
+    TREE_BUILDER_API int set_mcts_position(mcts_engine* engine,
+        const board_record* board)
+    {
+        if (!engine || !board) return 0;
+        return engine->set_position(*board) ? 1 : 0;
+    }
+
+    TREE_BUILDER_API int mcts_search(mcts_engine* engine, int milliseconds,
+        int64_t playouts, board_record* boards, int64_t* visits,
+        int capacity)
+    {
+        if (!engine || milliseconds < 0 || playouts < 0) return 0;
+        const auto children = engine->search(
+            std::chrono::milliseconds(milliseconds),
+            static_cast<uint64_t>(playouts));
+        const size_t count = capacity > 0 ? (std::min)(
+            static_cast<size_t>(capacity), children.size()) : 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (boards) boards[i] = children[i].board;
+            if (visits) visits[i] = children[i].visits;
+        }
+        return static_cast<int>(children.size());
+    }
+
+    TREE_BUILDER_API void delete_mcts_engine(mcts_engine* engine)
+    {
+        delete engine;
+    }
+
+    TREE_BUILDER_API int generate_tablebase(int pieces, int threads,
+        const char* path)
+    {
+        if (!path || pieces < 2 ||
+            pieces > static_cast<int>(k_max_tablebase_pieces) || threads < 0)
+            return 0;
+        tablebase_generator generator(static_cast<uint32_t>(pieces),
+            static_cast<size_t>(threads));
+        return generator.solve_all() && generator.save(path) ? 1 : 0;
+    }
+
+    TREE_BUILDER_API endgame_tablebase* open_tablebase(const char* path)
+    {
+        if (!path) return nullptr;
+        auto* tablebase = new endgame_tablebase();
+        if (!tablebase->open(path))
+        {
+            delete tablebase;
+            return nullptr;
+        }
+        return tablebase;
+    }
+
+    TREE_BUILDER_API int probe_tablebase(const endgame_tablebase* tablebase,
+        const board_record* board, int* plies)
+    {
+        if (!tablebase || !board)
+            return static_cast<int>(e_game_result::unknown);
+        const tablebase_value value = tablebase->probe(*board);
+        if (plies) *plies = static_cast<int>(value.plies);
+        return static_cast<int>(value.result);
+    }
+
+    TREE_BUILDER_API int64_t cut_tablebase_tree(
+        const endgame_tablebase* tablebase, tree<board_record>* tree)
+    {
+        if (!tablebase || !tree) return 0;
+        return static_cast<int64_t>(tablebase->cut_tree(*tree));
+    }
+
+    TREE_BUILDER_API void set_search_tablebase(search_engine* engine,
+        const endgame_tablebase* tablebase)
+    {
+        if (engine) engine->set_tablebase(tablebase);
+    }
+
+    TREE_BUILDER_API void close_tablebase(endgame_tablebase* tablebase)
+    {
+        delete tablebase;
+    }
+
+    TREE_BUILDER_API game_record_writer* open_game_writer(const char* path)
+    {
+        if (!path) return nullptr;
+        auto* writer = new game_record_writer();
+        if (!writer->open(path))
+        {
+            delete writer;
+            return nullptr;
+        }
+        return writer;
+    }
+
+    TREE_BUILDER_API int64_t append_game(game_record_writer* writer,
+        const board_record* boards, int count, int result, int64_t saved_at)
+    {
+        if (!writer || !boards || count <= 0 || result < 0 ||
+            result > static_cast<int>(e_game_result::draw))
+            return -1;
+        if (!writer->append({ boards, static_cast<size_t>(count) },
+            static_cast<e_game_result>(result), saved_at))
+            return -1;
+        return static_cast<int64_t>(writer->size()) - 1;
+    }
+
+    TREE_BUILDER_API int64_t convert_saved_games(game_record_writer* writer,
+        const char* directory)
+    {
+        if (!writer || !directory) return 0;
+        return static_cast<int64_t>(tree_builder::convert_saved_games(
+            directory, *writer));
+    }
+
+    TREE_BUILDER_API void close_game_writer(game_record_writer* writer)
+    {
+        delete writer;
+    }
+
+    TREE_BUILDER_API game_archive* open_game_archive(const char* path)
+    {
+        if (!path) return nullptr;
+        auto* archive = new game_archive();
+        if (!archive->open(path))
+        {
+            delete archive;
+            return nullptr;
+        }
+        return archive;
+    }
+
+    TREE_BUILDER_API int64_t get_game_count(const game_archive* archive)
+    {
+        return archive ? static_cast<int64_t>(archive->size()) : 0;
+    }
+
+    TREE_BUILDER_API int load_game(const game_archive* archive, int64_t game,
+        board_record* positions, int capacity, int* result,
+        int64_t* saved_at)
+    {
+        if (!archive || game < 0 ||
+            static_cast<uint64_t>(game) >= archive->size())
+            return 0;
+        std::vector<board_record> boards;
+        if (!archive->load(static_cast<size_t>(game), boards)) return 0;
+        const game_header header = archive->get_header(
+            static_cast<size_t>(game));
+        if (result) *result = static_cast<int>(header.result);
+        if (saved_at) *saved_at = header.saved_at;
+        const size_t count = capacity > 0 && positions ? (std::min)(
+            static_cast<size_t>(capacity), boards.size()) : 0;
+        std::copy(boards.begin(), boards.begin() + count, positions);
+        return static_cast<int>(boards.size());
+    }
+
+    TREE_BUILDER_API game_batch* load_game_batch(const game_archive* archive,
+        int thread_count)
+    {
+        if (!archive) return nullptr;
+        if (thread_count == 1)
+            return new game_batch(archive->load_all());
+        task_pool pool(thread_count > 0 ? thread_count : 0);
+        return new game_batch(archive->load_all(pool));
+    }
+
+    TREE_BUILDER_API int get_game_batch_size(const game_batch* batch,
+        int64_t* games, int64_t* positions, int64_t* skipped)
+    {
+        if (!batch) return 0;
+        if (games) *games = static_cast<int64_t>(batch->headers.size());
+        if (positions)
+            *positions = static_cast<int64_t>(batch->positions.size());
+        if (skipped) *skipped = static_cast<int64_t>(batch->skipped);
+        return 1;
+    }
+
+    TREE_BUILDER_API int64_t export_game_batch(const game_batch* batch,
+        board_record* positions, int64_t capacity, int64_t* offsets,
+        int64_t offsets_capacity)
+    {
+        if (!batch) return 0;
+        const size_t count = capacity > 0 && positions ? (std::min)(
+            static_cast<size_t>(capacity), batch->positions.size()) : 0;
+        std::copy(batch->positions.begin(), batch->positions.begin() + count,
+            positions);
+        const size_t offset_count = offsets_capacity > 0 && offsets ?
+            (std::min)(static_cast<size_t>(offsets_capacity),
+                batch->offsets.size()) : 0;
+        for (size_t i = 0; i < offset_count; ++i)
+            offsets[i] = static_cast<int64_t>(batch->offsets[i]);
+        return static_cast<int64_t>(batch->positions.size());
+    }
+
+    TREE_BUILDER_API void delete_game_batch(game_batch* batch)
+    {
+        delete batch;
+    }
+
+    TREE_BUILDER_API void close_game_archive(game_archive* archive)
+    {
+        delete archive;
+    }
 }
\ No newline at end of file
@@ -1,139 +1,245 @@
 #include "Union.h"
+#include <cstring>
+#include <functional>
 #include <sstream>
 #include <iostream>
+#include <utility>
+
+std::string_view StringArena::Store(std::string_view text) {
+    if (text.size() > kBlockSize / 4) {
+        // Textos grandes ganham um bloco próprio, fora do bloco atual.
+        auto own = std::make_unique<char[]>(text.size());
+        std::memcpy(own.get(), text.data(), text.size());
+        std::string_view stored(own.get(), text.size());
+        blocks.push_back(std::move(own));
+        return stored;
+    }
 
-Element* UnionManager::Find(Element* e) {
-    if (e->parent != e)
-        e->parent = Find(e->parent);
-    return e->parent;
+    if (!current || used + text.size() > kBlockSize) {
+        blocks.push_back(std::make_unique<char[]>(kBlockSize));
+        current = blocks.back().get();
+        used = 0;
+    }
+    char* start = current + used;
+    std::memcpy(start, text.data(), text.size());
+    used += text.size();
+    return { start, text.size() };
+}
+
+ElementId StringInterner::Intern(std::string_view text) {
+    if ((texts.size() + 1) * 2 > slots.size())
+        Grow();
+
+    std::size_t slot = SlotOf(text);
+    if (slots[slot] != kNoElement)
+        return slots[slot];
+
+    ElementId id = static_cast<ElementId>(texts.size());
+    texts.push_back(arena.Store(text));
+    slots[slot] = id;
+    return id;
+}
+
+ElementId StringInterner::Lookup(std::string_view text) const {
+    if (slots.empty())
+        return kNoElement;
+    return slots[SlotOf(text)];
+}
+
+std::size_t StringInterner::SlotOf(std::string_view text) const {
+    std::size_t mask = slots.size() - 1;
+    std::size_t slot = std::hash<std::string_view>{}(text) & mask;
+    while (slots[slot] != kNoElement && texts[slots[slot]] != text)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+void StringInterner::Grow() {
+    std::size_t capacity = slots.empty() ? 16 : slots.size() * 2;
+    slots.assign(capacity, kNoElement);
+    for (ElementId id = 0; id < texts.size(); ++id)
+        slots[SlotOf(texts[id])] = id;
+}
+
+ElementId DenseUnionFind::Add() {
+    ElementId id = static_cast<ElementId>(parent.size());
+    parent.push_back(id);
+    size.push_back(1);
+    next.push_back(id);
+    return id;
+}
+
+void DenseUnionFind::Reset(ElementId x) {
+    parent[x] = x;
+    size[x] = 1;
+    next[x] = x;
+}
+
+ElementId DenseUnionFind::Find(ElementId x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+ElementId DenseUnionFind::Unite(ElementId x, ElementId y) {
+    ElementId rx = Find(x);
+    ElementId ry = Find(y);
+    if (rx == ry)
+        return rx;
+
+    if (size[rx] < size[ry]) std::swap(rx, ry);
+    parent[ry] = rx;
+    size[rx] += size[ry];
+    // Trocar os sucessores das duas raízes emenda as duas listas circulares.
+    std::swap(next[rx], next[ry]);
+    return rx;
+}
+
+ElementId UnionManager::FindElement(const std::string& x) const {
+    ElementId e = names.Lookup(x);
+    return e != kNoElement && sets.IsActive(e) ? e : kNoElement;
+}
+
+ElementId UnionManager::RootOfSet(int id) const {
+    if (id <= 0 || id >= static_cast<int>(rootOfSetId.size()))
+        return kNoElement;
+    return rootOfSetId[id];
+}
+
+void UnionManager::CollectMembers(ElementId root, std::vector<ElementId>& members) {
+    members.clear();
+    ElementId e = root;
+    do {
+        members.push_back(e);
+        e = sets.Next(e);
+    } while (e != root);
 }
 
 bool UnionManager::MakeSet(const std::string& x) {
-    if (valueToElement.count(x)) {
+    if (FindElement(x) != kNoElement) {
         lastAction = "Não foi possível criar conjunto: valor " + x + " já pertence a um conjunto.";
         return false;
     }
 
-    Element* newElem = new Element(x);
-    auto newSet = std::make_unique<DisjointSet>(newElem);
+    ElementId e = names.Intern(x);
+    if (e == sets.Count()) {
+        sets.Add();
+        setIdOfRoot.push_back(0);
+    } else {
+        sets.Reset(e);
+    }
 
     int id = nextSetId++;
-    idToSet[id] = std::move(newSet);
-    setIdMap[newElem] = id;
-    valueToElement[x] = newElem;
+    setIdOfRoot[e] = id;
+    rootOfSetId.push_back(e);
 
     lastAction = "Conjunto S" + std::to_string(id) + " criado.";
     return true;
 }
 
 void UnionManager::ShowSet(const std::string& x) {
-    if (!valueToElement.count(x)) {
+    ElementId e = FindElement(x);
+    if (e == kNoElement) {
         lastAction = "Elemento " + x + " não encontrado.";
         return;
     }
-    Element* rep = Find(valueToElement[x]);
-    int id = setIdMap[rep];
-    ShowSet(id);
+    ShowSet(setIdOfRoot[sets.Find(e)]);
 }
 
 void UnionManager::ShowSet(int id) {
-    if (!idToSet.count(id)) {
+    ElementId root = RootOfSet(id);
+    if (root == kNoElement) {
         lastAction = "Conjunto S" + std::to_string(id) + " não existe.";
         return;
     }
 
+    std::vector<ElementId> members;
+    CollectMembers(root, members);
     std::ostringstream oss;
-    for (Element* e : idToSet[id]->elements)
-        oss << e->value << " ";
+    for (ElementId e : members)
+        oss << names.Text(e) << " ";
 
     lastAction = oss.str();
 }
 
 void UnionManager::DestroySet(const std::string& x) {
-    if (!valueToElement.count(x)) {
+    ElementId e = FindElement(x);
+    if (e == kNoElement) {
         lastAction = "Conjunto com " + x + " não existe. Nada a fazer.";
         return;
     }
-
-    Element* rep = Find(valueToElement[x]);
-    int id = setIdMap[rep];
-    DestroySet(id);
+    DestroySet(setIdOfRoot[sets.Find(e)]);
 }
 
 void UnionManager::DestroySet(int id) {
-    if (!idToSet.count(id)) {
+    ElementId root = RootOfSet(id);
+    if (root == kNoElement) {
         lastAction = "Conjunto S" + std::to_string(id) + " não existe. Nada a fazer.";
         return;
     }
 
-    for (Element* e : idToSet[id]->elements) {
-        valueToElement.erase(e->value);
-        setIdMap.erase(e);
-        delete e;
-    }
+    std::vector<ElementId> members;
+    CollectMembers(root, members);
+    for (ElementId e : members)
+        sets.Remove(e);
 
-    idToSet.erase(id);
+    rootOfSetId[id] = kNoElement;
     lastAction = "Conjunto S" + std::to_string(id) + " destruído.";
 }
 
 void UnionManager::Union(const std::string& x, const std::string& y) {
-    if (!valueToElement.count(x) || !valueToElement.count(y)) {
+    ElementId a = FindElement(x);
+    ElementId b = FindElement(y);
+    if (a == kNoElement || b == kNoElement) {
         lastAction = "Erro: um ou ambos os elementos não existem.";
         return;
     }
 
-    Element* a = valueToElement[x];
-    Element* b = valueToElement[y];
-
-    Element* ra = Find(a);
-    Element* rb = Find(b);
+    ElementId ra = sets.Find(a);
+    ElementId rb = sets.Find(b);
 
     if (ra == rb) {
         lastAction = "Os elementos já estão no mesmo conjunto.";
         return;
     }
 
-    if (ra->rank < rb->rank) std::swap(ra, rb);
-    rb->parent = ra;
-    if (ra->rank == rb->rank) ra->rank++;
+    ElementId root = sets.Unite(ra, rb);
+    if (root != ra) std::swap(ra, rb);
 
-    int idA = setIdMap[ra];
-    int idB = setIdMap[rb];
-    auto* setA = idToSet[idA].get();
-    auto* setB = idToSet[idB].get();
-
-    for (Element* e : setB->elements) {
-        setA->elements.insert(e);
-        setIdMap[e] = idA;
-    }
+    int idA = setIdOfRoot[ra];
+    int idB = setIdOfRoot[rb];
+    rootOfSetId[idB] = kNoElement;
 
-    idToSet.erase(idB);
     lastAction = "Conjuntos S" + std::to_string(idA) + " e S" + std::to_string(idB) + " unidos em S" + std::to_string(idA);
 }
 
 void UnionManager::FindSet(const std::string& x) {
-    if (!valueToElement.count(x)) {
+    ElementId e = FindElement(x);
+    if (e == kNoElement) {
         lastAction = "Elemento " + x + " não encontrado.";
         return;
     }
-    Element* rep = Find(valueToElement[x]);
-    lastAction = "Representante de " + x + ": " + rep->value;
+    ElementId rep = sets.Find(e);
+    lastAction = "Representante de " + x + ": " + std::string(names.Text(rep));
 }
 
 void UnionManager::SizeSet(const std::string& x) {
-    if (!valueToElement.count(x)) {
+    ElementId e = FindElement(x);
+    if (e == kNoElement) {
         lastAction = "Elemento " + x + " não encontrado.";
         return;
     }
-    Element* rep = Find(valueToElement[x]);
-    int id = setIdMap[rep];
-    lastAction = "Tamanho do conjunto contendo " + x + ": " + std::to_string(idToSet[id]->elements.size());
+    ElementId rep = sets.Find(e);
+    lastAction = "Tamanho do conjunto contendo " + x + ": " + std::to_string(sets.Size(rep));
 }
 
 void UnionManager::SizeSetById(int id) {
-    if (!idToSet.count(id)) {
+    ElementId root = RootOfSet(id);
+    if (root == kNoElement) {
         lastAction = "Conjunto S" + std::to_string(id) + " não existe.";
         return;
     }
-    lastAction = "Tamanho do conjunto S" + std::to_string(id) + ": " + std::to_string(idToSet[id]->elements.size());
+    lastAction = "Tamanho do conjunto S" + std::to_string(id) + ": " + std::to_string(sets.Size(root));
 }
@@ -1,37 +1,89 @@
 #ifndef UNION_H
 #define UNION_H
 
-#include <unordered_map>
-#include <unordered_set>
-#include <string>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using ElementId = std::uint32_t;
+
+constexpr ElementId kNoElement = UINT32_MAX;
 
-struct Element {
-    std::string value;
-    Element* parent;
-    int rank;
+// Guarda os textos em blocos contíguos que nunca se movem, então as
+// string_views devolvidas continuam válidas enquanto a arena existir.
+class StringArena {
+public:
+    std::string_view Store(std::string_view text);
+
+private:
+    static constexpr std::size_t kBlockSize = 64 * 1024;
 
-    Element(const std::string& val) : value(val), parent(this), rank(0) {}
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* current = nullptr;   // bloco de kBlockSize bytes em uso
+    std::size_t used = 0;
 };
 
-class DisjointSet {
+// Associa cada texto distinto a um id denso (0, 1, 2, ...), guardando o
+// texto uma única vez. A busca usa endereçamento aberto sobre um vetor de
+// ids, sem um nó alocado por elemento.
+class StringInterner {
 public:
-    std::unordered_set<Element*> elements;
-    Element* representative;
+    ElementId Intern(std::string_view text);
+    ElementId Lookup(std::string_view text) const;
+    std::string_view Text(ElementId id) const { return texts[id]; }
+    std::size_t Size() const { return texts.size(); }
 
-    DisjointSet(Element* e) : representative(e) {
-        elements.insert(e);
-    }
+private:
+    std::size_t SlotOf(std::string_view text) const;
+    void Grow();
+
+    StringArena arena;
+    std::vector<std::string_view> texts;
+    std::vector<ElementId> slots;
+};
+
+// Union-find sobre ids densos, com os dados em vetores contíguos: pai,
+// tamanho (válido nas raízes) e o próximo membro do conjunto. Os membros
+// de cada conjunto formam uma lista circular em next, então a união junta
+// as listas em O(1) e percorrer um conjunto custa O(tamanho). Find é
+// iterativo, com path halving, e não usa a pilha mesmo em cadeias longas.
+class DenseUnionFind {
+public:
+    ElementId Add();
+    void Reset(ElementId x);
+    void Remove(ElementId x) { parent[x] = kNoElement; }
+    bool IsActive(ElementId x) const { return parent[x] != kNoElement; }
+
+    ElementId Find(ElementId x);
+    ElementId Unite(ElementId x, ElementId y);
+    std::uint32_t Size(ElementId root) const { return size[root]; }
+    ElementId Next(ElementId x) const { return next[x]; }
+    std::size_t Count() const { return parent.size(); }
+
+private:
+    std::vector<ElementId> parent;
+    std::vector<std::uint32_t> size;
+    std::vector<ElementId> next;
 };
 
+// Fachada com a interface por texto do menu: os textos viram ids pelo
+// StringInterner e os conjuntos vivem no DenseUnionFind. O id de um
+// conjunto (S1, S2, ...) só é guardado para o seu representante. Um
+// elemento destruído mantém seu id e o reutiliza se for criado de novo.
 class UnionManager {
 private:
-    std::unordered_map<std::string, Element*> valueToElement;
-    std::unordered_map<int, std::unique_ptr<DisjointSet>> idToSet;
-    std::unordered_map<Element*, int> setIdMap;
+    StringInterner names;
+    DenseUnionFind sets;
+    std::vector<int> setIdOfRoot;
+    std::vector<ElementId> rootOfSetId{ kNoElement };
     int nextSetId = 1;
 
-    Element* Find(Element* e);
+    ElementId FindElement(const std::string& x) const;
+    ElementId RootOfSet(int id) const;
+    void CollectMembers(ElementId root, std::vector<ElementId>& members);
     std::string lastAction = "Nenhuma";
 
 public:
@@ -0,0 +1,67 @@
+#include "Union.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Testes de regressão do StringInterner. Retorna 0 se todos passarem.
+
+static int falhas = 0;
+
+static void Verifica(bool condicao, const std::string& descricao) {
+    if (!condicao) {
+        std::cerr << "FALHOU: " << descricao << "\n";
+        falhas++;
+    }
+}
+
+// Um texto grande guardado com a arena vazia não pode virar o bloco em que
+// os textos curtos seguintes são copiados.
+static void TextoGrandePrimeiro() {
+    StringInterner names;
+    std::string grande(20000, 'x');
+    ElementId idGrande = names.Intern(grande);
+
+    std::vector<std::string> curtos;
+    for (int i = 0; i < 5000; ++i)
+        curtos.push_back("elemento" + std::to_string(i));
+    for (const auto& texto : curtos)
+        names.Intern(texto);
+
+    Verifica(names.Text(idGrande) == grande, "texto grande preservado");
+    bool todos = true;
+    for (const auto& texto : curtos) {
+        ElementId id = names.Lookup(texto);
+        todos = todos && id != kNoElement && names.Text(id) == texto;
+    }
+    Verifica(todos, "textos curtos preservados depois de um texto grande");
+}
+
+// Textos grandes entre textos curtos não podem interromper o bloco atual.
+static void TextosGrandesIntercalados() {
+    StringInterner names;
+    std::vector<std::string> textos;
+    for (int i = 0; i < 2000; ++i) {
+        if (i % 100 == 0)
+            textos.push_back(std::string(17000 + i, static_cast<char>('a' + i % 26)));
+        else
+            textos.push_back("v" + std::to_string(i));
+    }
+    for (const auto& texto : textos)
+        names.Intern(texto);
+
+    bool todos = names.Size() == textos.size();
+    for (const auto& texto : textos) {
+        ElementId id = names.Lookup(texto);
+        todos = todos && id != kNoElement && names.Text(id) == texto;
+    }
+    Verifica(todos, "textos grandes intercalados com curtos");
+}
+
+int main() {
+    TextoGrandePrimeiro();
+    TextosGrandesIntercalados();
+
+    if (falhas == 0)
+        std::cout << "Todos os testes passaram.\n";
+    return falhas == 0 ? 0 : 1;
+}